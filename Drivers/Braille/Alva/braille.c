@@ -1758,8 +1758,8 @@ brl_destruct (BrailleDisplay *brl) {
 
 static int
 brl_writeWindow (BrailleDisplay *brl, const wchar_t *text) {
-  unsigned int from;
-  unsigned int to;
+  ChangedRange ranges[4];
+  unsigned int count;
 
   if (textRewriteInterval) {
     TimeValue now;
@@ -1768,12 +1768,24 @@ brl_writeWindow (BrailleDisplay *brl, const wchar_t *text) {
     if (textRewriteRequired) textRewriteTime = now;
   }
 
-  if (cellsHaveChanged(previousText, brl->buffer, brl->textColumns, &from, &to, &textRewriteRequired)) {
-    size_t count = to - from;
-    unsigned char cells[count];
+  /* Each write costs a few bytes of header, so only split the update where
+   * more unchanged cells than that lie between two changes.
+   */
+  count = cellRangesHaveChanged(previousText, brl->buffer, brl->textColumns,
+                                ranges, ARRAY_COUNT(ranges), 4,
+                                &textRewriteRequired);
 
-    translateOutputCells(cells, &brl->buffer[from], count);
-    if (!protocol->writeBraille(brl, cells, textOffset+from, count)) return 0;
+  {
+    const ChangedRange *range = ranges;
+
+    while (count--) {
+      size_t length = range->to - range->from;
+      unsigned char cells[length];
+
+      translateOutputCells(cells, &brl->buffer[range->from], length);
+      if (!protocol->writeBraille(brl, cells, textOffset+range->from, length)) return 0;
+      range += 1;
+    }
   }
 
   return 1;
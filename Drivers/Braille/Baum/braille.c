@@ -400,11 +400,14 @@ clearCellRange (BrailleDisplay *brl, unsigned int start, unsigned int count) {
 
 static int
 putCells (BrailleDisplay *brl, const unsigned char *cells, unsigned int start, unsigned int count) {
-  unsigned int from;
-  unsigned int to;
-
-  if (cellsHaveChanged(&internalCells[start], cells, count, &from, &to, NULL)) {
-    if (!updateCellRange(brl, start+from, to-from)) return 0;
+  ChangedRange ranges[4];
+  const ChangedRange *range = ranges;
+  unsigned int rangeCount = cellRangesHaveChanged(&internalCells[start], cells, count,
+                                                  ranges, ARRAY_COUNT(ranges), 4, NULL);
+
+  while (rangeCount--) {
+    if (!updateCellRange(brl, start+range->from, range->to-range->from)) return 0;
+    range += 1;
   }
 
   return 1;
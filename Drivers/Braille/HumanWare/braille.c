@@ -71,29 +71,20 @@ struct BrailleDataStruct {
   unsigned char textCells[0XFF];
 };
 
-static int
-verifyPacket (
-  BrailleDisplay *brl,
-  const unsigned char *bytes, size_t size,
-  size_t *length, void *data
-) {
-  unsigned char byte = bytes[size-1];
-
-  switch (size) {
-    case 1:
-      if (byte != ESC) return 0;
-      *length = 3;
-      break;
-
-    case 3:
-      *length += byte;
-      break;
-
-    default:
-      break;
-  }
+static size_t
+readPacket (BrailleDisplay *brl, void *packet, size_t size) {
+  static const GioPacketGrammar grammar = {
+    .framing = GIO_PACKET_PREFIXED,
+    .leadByte = ESC,
+
+    .format.prefixed = {
+      .headerLength = 3,
+      .lengthOffset = 2,
+      .lengthSize = 1
+    }
+  };
 
-  return 1;
+  return gioReadPacket(brl->data->gioEndpoint, &grammar, packet, size);
 }
 
 static int
@@ -152,11 +143,6 @@ writeIdentifyRequest (BrailleDisplay *brl) {
   return writePacket(brl, HW_MSG_INIT, 0, NULL);
 }
 
-static size_t
-readResponse (BrailleDisplay *brl, void *packet, size_t size) {
-  return readBraillePacket(brl, brl->data->gioEndpoint, packet, size, verifyPacket, NULL);
-}
-
 static BrailleResponseResult
 isIdentityResponse (BrailleDisplay *brl, const void *packet, size_t size) {
   const HW_Packet *response = packet;
@@ -175,7 +161,7 @@ brl_construct (BrailleDisplay *brl, char **parameters, const char *device) {
 
       if (probeBrailleDisplay(brl, 0, brl->data->gioEndpoint, 1000,
                               writeIdentifyRequest,
-                              readResponse, &response, sizeof(response.bytes),
+                              readPacket, &response, sizeof(response.bytes),
                               isIdentityResponse)) {
         logMessage(LOG_INFO, "detected Humanware device: model=%u cells=%u",
                    response.fields.data.init.modelIdentifier,
@@ -256,7 +242,7 @@ brl_readCommand (BrailleDisplay *brl, KeyTableCommandContext context) {
   HW_Packet packet;
   size_t length;
 
-  while ((length = readBraillePacket(brl, brl->data->gioEndpoint, &packet, sizeof(packet), verifyPacket, NULL))) {
+  while ((length = readPacket(brl, &packet, sizeof(packet)))) {
     switch (packet.fields.type) {
       case HW_MSG_KEY_DOWN:
         handleKeyEvent(packet.fields.data.key.id, 1);
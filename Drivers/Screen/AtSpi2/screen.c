@@ -61,6 +61,7 @@
 #include "parse.h"
 #include "brldefs.h"
 #include "charset.h"
+#include "async_io.h"
 
 typedef enum {
   PARM_TYPE
@@ -83,6 +84,82 @@ pthread_t SPI2_main_thread;
 
 static DBusConnection *bus = NULL;
 
+#ifndef __MINGW32__
+static int updatePipe[2] = {-1, -1};
+#endif /* __MINGW32__ */
+static AsyncHandle updateMonitor = NULL;
+
+/* called from the D-Bus thread */
+static void
+notifyScreenUpdated (void) {
+#ifndef __MINGW32__
+  if (updatePipe[1] != -1) {
+    static const unsigned char byte = 0;
+
+    /* the pipe is non-blocking - a full pipe already has a pending update */
+    if (write(updatePipe[1], &byte, 1) == -1) {
+      if (errno != EAGAIN) logSystemError("screen update pipe write");
+    }
+  }
+#endif /* __MINGW32__ */
+}
+
+#ifndef __MINGW32__
+static int
+handleScreenUpdated (const AsyncMonitorResult *result) {
+  unsigned char buffer[0X40];
+
+  while (read(updatePipe[0], buffer, sizeof(buffer)) > 0);
+  mainScreenUpdated();
+  return 1;
+}
+#endif /* __MINGW32__ */
+
+static void
+stopUpdateMonitor (void) {
+  if (updateMonitor) {
+    asyncCancelRequest(updateMonitor);
+    updateMonitor = NULL;
+  }
+
+#ifndef __MINGW32__
+  {
+    int *descriptor = updatePipe;
+    const int *end = descriptor + ARRAY_COUNT(updatePipe);
+
+    while (descriptor < end) {
+      if (*descriptor != -1) {
+        close(*descriptor);
+        *descriptor = -1;
+      }
+
+      descriptor += 1;
+    }
+  }
+#endif /* __MINGW32__ */
+}
+
+static void
+startUpdateMonitor (void) {
+#ifndef __MINGW32__
+  if (pipe(updatePipe) != -1) {
+    if ((fcntl(updatePipe[0], F_SETFL, O_NONBLOCK) != -1) &&
+        (fcntl(updatePipe[1], F_SETFL, O_NONBLOCK) != -1)) {
+      if (asyncMonitorFileInput(&updateMonitor, updatePipe[0], handleScreenUpdated, NULL)) {
+        return;
+      }
+    } else {
+      logSystemError("fcntl[F_SETFL,O_NONBLOCK]");
+    }
+
+    updateMonitor = NULL;
+    stopUpdateMonitor();
+  } else {
+    logSystemError("pipe");
+  }
+#endif /* __MINGW32__ */
+}
+
 /* having our own implementation is much more independant on locales */
 
 typedef struct {
@@ -725,9 +802,10 @@ static DBusHandlerResult AtSpi2Filter(DBusConnection *connection, DBusMessage *m
   const char *interface = dbus_message_get_interface(message);
   const char *member = dbus_message_get_member(message);
   if (type == DBUS_MESSAGE_TYPE_SIGNAL) {
-    if (!strncmp(interface, SPI2_DBUS_INTERFACE_EVENT".", strlen(SPI2_DBUS_INTERFACE_EVENT".")))
+    if (!strncmp(interface, SPI2_DBUS_INTERFACE_EVENT".", strlen(SPI2_DBUS_INTERFACE_EVENT"."))) {
       AtSpi2HandleEvent(interface + strlen(SPI2_DBUS_INTERFACE_EVENT"."), message);
-    else
+      notifyScreenUpdated();
+    } else
       logMessage(LOG_DEBUG, "unknown signal %s %s", interface, member);
   } else
     logMessage(LOG_DEBUG, "unknown message %d %s %s", type, interface, member);
@@ -855,6 +933,7 @@ construct_AtSpi2Screen (void) {
     return 0;
   }
   logMessage(LOG_DEBUG,"SPI2 initialized");
+  startUpdateMonitor();
   return 1;
 }
 
@@ -862,9 +941,15 @@ static void
 destruct_AtSpi2Screen (void) {
   finished = 1;
   pthread_join(SPI2_main_thread,NULL);
+  stopUpdateMonitor();
   logMessage(LOG_DEBUG,"SPI2 stopped");
 }
 
+static int
+poll_AtSpi2Screen (void) {
+  return !updateMonitor;
+}
+
 static int
 selectVirtualTerminal_AtSpi2Screen (int vt) {
   return 0;
@@ -1101,6 +1186,7 @@ executeCommand_AtSpi2Screen (int *command) {
 static void
 scr_initialize (MainScreen *main) {
   initializeRealScreen(main);
+  main->base.poll = poll_AtSpi2Screen;
   main->base.describe = describe_AtSpi2Screen;
   main->base.readCharacters = readCharacters_AtSpi2Screen;
   main->base.insertKey = insertKey_AtSpi2Screen;
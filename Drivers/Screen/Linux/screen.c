@@ -25,6 +25,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/utsname.h>
 #include <linux/tty.h>
 #include <linux/vt.h>
 #include <linux/kd.h>
@@ -33,8 +34,10 @@
 #include "log.h"
 #include "device.h"
 #include "parse.h"
+#include "async_io.h"
 #include "system_linux.h"
 #include "charset.h"
+#include "bitmask.h"
 #include "brldefs.h"
 
 typedef enum {
@@ -366,6 +369,7 @@ openConsole (unsigned char vt) {
 static const char *screenName = NULL;
 static int screenDescriptor;
 static unsigned char virtualTerminal;
+static AsyncHandle screenMonitor = NULL;
 
 static int
 setScreenName (void) {
@@ -373,8 +377,78 @@ setScreenName (void) {
   return setDeviceName(&screenName, names, "screen");
 }
 
+static int
+canMonitorScreen (void) {
+  /* The vcs devices signal updates via POLLPRI as of Linux 2.6.38. */
+  static int canMonitor = -1;
+
+  if (canMonitor == -1) {
+    struct utsname name;
+    unsigned int major, minor, patch;
+
+    canMonitor = 0;
+
+    if (uname(&name) == -1) {
+      logSystemError("uname");
+    } else if (sscanf(name.release, "%u.%u.%u", &major, &minor, &patch) == 3) {
+      if (major > 2) {
+        canMonitor = 1;
+      } else if ((major == 2) && ((minor > 6) || ((minor == 6) && (patch >= 38)))) {
+        canMonitor = 1;
+      }
+    }
+
+    logMessage(LOG_DEBUG, "screen update notification %s", (canMonitor? "supported": "not supported"));
+  }
+
+  return canMonitor;
+}
+
+static int
+lxScreenUpdated (const AsyncMonitorResult *result) {
+  unsigned char header[4];
+
+  /* Reading from the device acknowledges the update event. */
+  if (pread(screenDescriptor, header, sizeof(header), 0) == -1) {
+    logSystemError("screen read");
+    logMessage(LOG_DEBUG, "screen monitor stopped");
+    asyncDiscardHandle(screenMonitor);
+    screenMonitor = NULL;
+    return 0;
+  }
+
+  mainScreenUpdated();
+  return 1;
+}
+
+static void
+stopScreenMonitor (void) {
+  if (screenMonitor) {
+    asyncCancelRequest(screenMonitor);
+    screenMonitor = NULL;
+  }
+}
+
+static void
+startScreenMonitor (void) {
+  stopScreenMonitor();
+
+  if (canMonitorScreen()) {
+    if (!asyncMonitorFileAlert(&screenMonitor, screenDescriptor, lxScreenUpdated, NULL)) {
+      screenMonitor = NULL;
+    }
+  }
+}
+
+static void discardScreenSnapshot (void);
+static void discardChangedRowsReference (void);
+
 static void
 closeScreen (void) {
+  stopScreenMonitor();
+  discardScreenSnapshot();
+  discardChangedRowsReference();
+
   if (screenDescriptor != -1) {
     if (close(screenDescriptor) == -1) {
       logSystemError("screen close");
@@ -396,6 +470,7 @@ openScreen (unsigned char vt) {
         closeScreen();
         screenDescriptor = screen;
         virtualTerminal = vt;
+        startScreenMonitor();
         opened = 1;
       } else {
         close(screen);
@@ -407,8 +482,66 @@ openScreen (unsigned char vt) {
   return opened;
 }
 
+typedef struct {
+  unsigned char *buffer;
+  size_t size;
+  size_t length;
+} ScreenSnapshot;
+
+static ScreenSnapshot screenSnapshot = {
+  .buffer = NULL,
+  .size = 0,
+  .length = 0
+};
+
+/* the snapshot against which changed rows were last marked */
+static ScreenSnapshot changedRowsReference = {
+  .buffer = NULL,
+  .size = 0,
+  .length = 0
+};
+static unsigned int changedRowsCharset;
+
+static void
+discardScreenSnapshot (void) {
+  screenSnapshot.length = 0;
+}
+
+static void
+discardChangedRowsReference (void) {
+  changedRowsReference.length = 0;
+}
+
+static void
+deallocateScreenSnapshot (void) {
+  discardScreenSnapshot();
+
+  if (screenSnapshot.buffer) {
+    free(screenSnapshot.buffer);
+    screenSnapshot.buffer = NULL;
+  }
+
+  screenSnapshot.size = 0;
+
+  discardChangedRowsReference();
+
+  if (changedRowsReference.buffer) {
+    free(changedRowsReference.buffer);
+    changedRowsReference.buffer = NULL;
+  }
+
+  changedRowsReference.size = 0;
+}
+
 static int
 readScreenData (off_t offset, void *buffer, size_t size) {
+  if (screenSnapshot.length) {
+    if ((offset + size) <= screenSnapshot.length) {
+      memcpy(buffer, &screenSnapshot.buffer[offset], size);
+      return 1;
+    }
+  }
+
   if (lseek(screenDescriptor, offset, SEEK_SET) == -1) {
     logSystemError("screen seek");
   } else {
@@ -454,6 +587,120 @@ readScreenContent (off_t offset, uint16_t *buffer, size_t count) {
   return readScreenData(offset, buffer, count);
 }
 
+static size_t
+getScreenDataSize (const ScreenSize *size) {
+  return 4 + (size->rows * size->columns * sizeof(uint16_t));
+}
+
+static int
+allocateScreenSnapshot (size_t size) {
+  if (size > screenSnapshot.size) {
+    unsigned char *buffer = realloc(screenSnapshot.buffer, size);
+
+    if (!buffer) {
+      logMallocError();
+      return 0;
+    }
+
+    screenSnapshot.buffer = buffer;
+    screenSnapshot.size = size;
+  }
+
+  return 1;
+}
+
+static int
+takeScreenSnapshot (void) {
+  int grown = 0;
+
+  discardScreenSnapshot();
+
+  if (!screenSnapshot.size) {
+    ScreenSize size;
+
+    if (!readScreenSize(&size)) return 0;
+    if (!allocateScreenSnapshot(getScreenDataSize(&size))) return 0;
+  }
+
+  while (1) {
+    ssize_t count = pread(screenDescriptor, screenSnapshot.buffer, screenSnapshot.size, 0);
+
+    if (count == -1) {
+      logSystemError("screen read");
+      return 0;
+    }
+
+    if (count >= sizeof(ScreenSize)) {
+      size_t length = getScreenDataSize((const ScreenSize *)screenSnapshot.buffer);
+
+      if (length <= count) {
+        screenSnapshot.length = length;
+        return 1;
+      }
+
+      if ((length > screenSnapshot.size) && !grown) {
+        if (!allocateScreenSnapshot(length)) return 0;
+        grown = 1;
+        continue;
+      }
+    }
+
+    logMessage(LOG_ERR, "truncated screen snapshot: read %d bytes", (int)count);
+    return 0;
+  }
+}
+
+static int
+markChangedRows (unsigned char *rows, int count) {
+  const ScreenSnapshot *snapshot = &screenSnapshot;
+  ScreenSnapshot *reference = &changedRowsReference;
+
+  if (snapshot->length && (snapshot->length == reference->length) &&
+      !memcmp(snapshot->buffer, reference->buffer, sizeof(ScreenSize)) &&
+      (charsetIndex == changedRowsCharset)) {
+    const ScreenSize *size = (const ScreenSize *)snapshot->buffer;
+
+    if (size->rows == count) {
+      size_t length = size->columns * sizeof(uint16_t);
+      size_t offset = 4;
+      int row;
+
+      for (row=0; row<count; row+=1) {
+        if (memcmp(&snapshot->buffer[offset], &reference->buffer[offset], length) != 0) {
+          memcpy(&reference->buffer[offset], &snapshot->buffer[offset], length);
+          BITMASK_SET(rows, row);
+        }
+
+        offset += length;
+      }
+
+      return 1;
+    }
+  }
+
+  discardChangedRowsReference();
+
+  if (snapshot->length) {
+    if (snapshot->length > reference->size) {
+      unsigned char *buffer = realloc(reference->buffer, snapshot->length);
+
+      if (!buffer) {
+        logMallocError();
+        return 0;
+      }
+
+      reference->buffer = buffer;
+      reference->size = snapshot->length;
+    }
+
+    memcpy(reference->buffer, snapshot->buffer, snapshot->length);
+    reference->length = snapshot->length;
+    changedRowsCharset = charsetIndex;
+  }
+
+  return 0;
+}
+
 static int
 rebindConsole (void) {
   return virtualTerminal? 1: openConsole(0);
@@ -704,6 +951,7 @@ setTranslationTable (int force) {
   int vccChanged = (sfmChanged || force)? setVgaCharacterCount(force): 0;
 
   if (vccChanged || force) determineAttributesMasks();
+  if (sfmChanged || vccChanged || force) discardChangedRowsReference();
 
   if (sfmChanged || vccChanged) {
     unsigned int count = ARRAY_COUNT(translationTable);
@@ -941,6 +1189,7 @@ destruct_LinuxScreen (void) {
 
   closeScreen();
   screenName = NULL;
+  deallocateScreenSnapshot();
 
   if (screenFontMapTable) {
     free(screenFontMapTable);
@@ -1106,6 +1355,27 @@ getConsoleDescription (ScreenDescription *description) {
   }
 }
 
+static int
+poll_LinuxScreen (void) {
+  return !screenMonitor;
+}
+
+static int
+beginSnapshot_LinuxScreen (void) {
+  return takeScreenSnapshot();
+}
+
+static void
+endSnapshot_LinuxScreen (void) {
+  discardScreenSnapshot();
+}
+
+static int
+markChangedRows_LinuxScreen (unsigned char *rows, int count) {
+  if (problemText) return 0;
+  return markChangedRows(rows, count);
+}
+
 static void
 describe_LinuxScreen (ScreenDescription *description) {
   getConsoleDescription(description);
@@ -1908,6 +2178,10 @@ static void
 scr_initialize (MainScreen *main) {
   initializeRealScreen(main);
 
+  main->base.poll = poll_LinuxScreen;
+  main->base.beginSnapshot = beginSnapshot_LinuxScreen;
+  main->base.endSnapshot = endSnapshot_LinuxScreen;
+  main->base.markChangedRows = markChangedRows_LinuxScreen;
   main->base.describe = describe_LinuxScreen;
   main->base.readCharacters = readCharacters_LinuxScreen;
   main->base.insertKey = insertKey_LinuxScreen;
@@ -43,7 +43,7 @@
 #endif /* __MINGW32__ */
 
 #include "log.h"
-#include "timing.h"
+#include "async_io.h"
 
 typedef enum {
   PARM_PROGRAM=0,
@@ -60,6 +60,18 @@ static int helper_fd_in = -1, helper_fd_out = -1;
 static unsigned short lastIndex, finalIndex;
 static char speaking = 0;
 
+static AsyncHandle helperInputMonitor = NULL;
+static unsigned char helperInputBuffer[0X40];
+static size_t helperInputLength = 0;
+
+static AsyncHandle helperOutputMonitor = NULL;
+static unsigned char *helperOutputBuffer = NULL;
+static size_t helperOutputSize = 0;
+static size_t helperOutputLength = 0;
+static size_t helperOutputWritten = 0;
+
+static int handleHelperInput(const AsyncMonitorResult *result);
+
 #define ERRBUFLEN 200
 static void myerror(SpeechSynthesizer *spk, char *fmt, ...)
 {
@@ -225,6 +237,11 @@ static int spk_construct (SpeechSynthesizer *spk, char **parameters)
       myperror(spk, "fcntl F_SETFL O_NONBLOCK");
       return 0;
     }
+    if(!asyncMonitorFileInput(&helperInputMonitor, helper_fd_in,
+			      handleHelperInput, spk)) {
+      myerror(spk, "unable to monitor pipe from helper program");
+      return 0;
+    }
   };
 #endif /* __MINGW32__ */
 
@@ -234,93 +251,203 @@ static int spk_construct (SpeechSynthesizer *spk, char **parameters)
   return 1;
 }
 
-static void mywrite(SpeechSynthesizer *spk, int fd, const void *buf, int len)
+#define HELPER_MUTE 1 /* mute code */
+#define HELPER_RATE 3 /* time scale code */
+#define HELPER_SAY 4 /* say code */
+
+/* Beyond this much unsent output the helper isn't keeping up,
+ * so text that hasn't been spoken yet is dropped.
+ */
+#define HELPER_OUTPUT_LIMIT 0X10000
+
+static size_t getHelperMessageLength(const unsigned char *message)
+{
+  switch(message[0]) {
+  case HELPER_SAY:
+    return 5 + (message[1]<<8 | message[2]) + (message[3]<<8 | message[4]);
+  case HELPER_RATE:
+    return 5;
+  default:
+    return 1;
+  }
+}
+
+/* Drop the messages which have been completely written. If requested,
+ * also drop the text which hasn't begun to be written yet. A message
+ * which has been partially written is always kept so that the helper
+ * never sees a truncated one, and setting changes are never dropped.
+ */
+static void compactHelperOutput(int discardSpeech)
 {
-  char *pos = (char *)buf;
-  int w;
-  TimePeriod period;
-  if(fd<0) return;
-  startTimePeriod(&period, 2000);
-  do {
-    if((w = write(fd, pos, len)) < 0) {
-      if(errno == EINTR || errno == EAGAIN) continue;
-      else if(errno == EPIPE)
-	myerror(spk, "ExternalSpeech: pipe to helper program was broken");
-         /* try to reinit may be ??? */
-      else myperror(spk, "ExternalSpeech: pipe to helper program: write");
-      return;
+  size_t from = 0, to = 0, written = 0;
+  while(from < helperOutputLength) {
+    unsigned char *message = &helperOutputBuffer[from];
+    size_t length = getHelperMessageLength(message);
+    if(from+length > helperOutputWritten) {
+      if(from < helperOutputWritten) {
+	written = to + (helperOutputWritten - from);
+      }else if(discardSpeech && (message[0] == HELPER_SAY)) {
+	from += length;
+	continue;
+      }
+      if(to != from) memmove(&helperOutputBuffer[to], message, length);
+      to += length;
     }
-    pos += w; len -= w;
-  } while(len && !afterTimePeriod(&period, NULL));
-  if(len)
-    myerror(spk, "ExternalSpeech: pipe to helper program: write timed out");
+    from += length;
+  }
+  helperOutputLength = to;
+  helperOutputWritten = written;
 }
 
-static int myread(SpeechSynthesizer *spk, int fd, void *buf, int len)
+static int reserveHelperOutput(size_t size)
 {
-  char *pos = (char *)buf;
-  int r;
-  int firstTime = 1;
-  TimePeriod period;
-  if(fd<0) return 0;
-  startTimePeriod(&period, 400);
-  do {
-    if((r = read(fd, pos, len)) < 0) {
+  size_t length;
+  if(helperOutputWritten) compactHelperOutput(0);
+  if((helperOutputLength - helperOutputWritten + size) > HELPER_OUTPUT_LIMIT) {
+    logMessage(LOG_WARNING, "ExternalSpeech: helper program isn't keeping up: discarding unspoken text");
+    compactHelperOutput(1);
+  }
+  length = helperOutputLength + size;
+  if(length > helperOutputSize) {
+    size_t newSize = helperOutputSize? helperOutputSize: 0X400;
+    unsigned char *newBuffer;
+    while(newSize < length) newSize <<= 1;
+    if(!(newBuffer = realloc(helperOutputBuffer, newSize))) {
+      logMallocError();
+      return 0;
+    }
+    helperOutputBuffer = newBuffer;
+    helperOutputSize = newSize;
+  }
+  return 1;
+}
+
+static void putHelperOutput(const void *data, size_t size)
+{
+  memcpy(&helperOutputBuffer[helperOutputLength], data, size);
+  helperOutputLength += size;
+}
+
+static int writeHelperOutput(SpeechSynthesizer *spk)
+{
+  while(helperOutputWritten < helperOutputLength) {
+    ssize_t w = write(helper_fd_out, &helperOutputBuffer[helperOutputWritten],
+		      helperOutputLength - helperOutputWritten);
+    if(w < 0) {
       if(errno == EINTR) continue;
-      else if(errno == EAGAIN) {
-	if(firstTime) return 0;
-	else continue;
-      }else myperror(spk, "ExternalSpeech: pipe to helper program: read");
-    }else if(r==0)
-      myerror(spk, "ExternalSpeech: pipe to helper program: read: EOF!");
-    if(r<=0) return 0;
-    firstTime = 0;
-    pos += r; len -= r;
-  } while(len && !afterTimePeriod(&period, NULL));
-  if(len) {
-    myerror(spk, "ExternalSpeech: pipe to helper program: read timed out");
+      if(errno == EAGAIN) return 1;
+      if(errno == EPIPE)
+	myerror(spk, "pipe to helper program was broken");
+	 /* try to reinit may be ??? */
+      else myperror(spk, "pipe to helper program: write");
+      /* drop what couldn't be sent so that the next flush tries again */
+      helperOutputLength = helperOutputWritten = 0;
+      return 0;
+    }
+    helperOutputWritten += w;
+  }
+  helperOutputLength = helperOutputWritten = 0;
+  return 1;
+}
+
+static int handleHelperOutput(const AsyncMonitorResult *result)
+{
+  SpeechSynthesizer *spk = result->data;
+  if(writeHelperOutput(spk) && helperOutputLength) return 1;
+  asyncDiscardHandle(helperOutputMonitor);
+  helperOutputMonitor = NULL;
+  return 0;
+}
+
+static void flushHelperOutput(SpeechSynthesizer *spk)
+{
+  /* while the pipe is full the monitor writes the rest when it drains */
+  if(helperOutputMonitor) return;
+  if(!writeHelperOutput(spk)) return;
+  if(!helperOutputLength) return;
+#ifndef __MINGW32__
+  if(asyncMonitorFileOutput(&helperOutputMonitor, helper_fd_out,
+			    handleHelperOutput, spk)) return;
+#endif /* __MINGW32__ */
+  myerror(spk, "unable to monitor pipe to helper program");
+}
+
+static void handleHelperIndex(unsigned inx)
+{
+  logMessage(LOG_DEBUG, "spktrk: Received index %u", inx);
+  if(inx >= finalIndex) {
+    speaking = 0;
+    logMessage(LOG_DEBUG, "spktrk: Done speaking %d", lastIndex);
+      /* do not change last_inx: remain on position of last spoken words,
+	 not after them. */
+  }else lastIndex = inx;
+}
+
+static int readHelperInput(SpeechSynthesizer *spk)
+{
+  unsigned char *b = helperInputBuffer;
+  ssize_t r;
+  do {
+    r = read(helper_fd_in, &b[helperInputLength],
+	     sizeof(helperInputBuffer) - helperInputLength);
+  } while((r < 0) && (errno == EINTR));
+  if(r < 0) {
+    if(errno == EAGAIN) return 1;
+    myperror(spk, "pipe to helper program: read");
+    return 0;
+  }
+  if(r == 0) {
+    myerror(spk, "pipe to helper program: read: EOF!");
     return 0;
   }
+  helperInputLength += r;
+  {
+    size_t offset = 0;
+    while(helperInputLength - offset >= 2) {
+      handleHelperIndex(b[offset]<<8 | b[offset+1]);
+      offset += 2;
+    }
+    if((helperInputLength -= offset)) b[0] = b[offset];
+  }
   return 1;
 }
 
+static int handleHelperInput(const AsyncMonitorResult *result)
+{
+  SpeechSynthesizer *spk = result->data;
+  return readHelperInput(spk);
+}
+
 static void spk_say(SpeechSynthesizer *spk, const unsigned char *text, size_t length, size_t count, const unsigned char *attributes)
 {
   unsigned char l[5];
+  size_t attributesCount = attributes? count: 0;
   if(helper_fd_out < 0) return;
-  l[0] = 4; /* say code */
+  if(!reserveHelperOutput(5 + length + attributesCount)) return;
+  l[0] = HELPER_SAY;
   l[1] = length >> 8;
   l[2] = length & 0xFF;
-  if (attributes) {
-    l[3] = count >> 8;
-    l[4] = count & 0xFF;
-  } else {
-    l[3] = 0;
-    l[4] = 0;
-  }
+  l[3] = attributesCount >> 8;
+  l[4] = attributesCount & 0xFF;
   speaking = 1;
-  mywrite(spk, helper_fd_out, l, 5);
-  mywrite(spk, helper_fd_out, text, length);
-  if (attributes) mywrite(spk, helper_fd_out, attributes, count);
   lastIndex = 0;
   finalIndex = count;
+  putHelperOutput(l, 5);
+  putHelperOutput(text, length);
+  if (attributes) putHelperOutput(attributes, count);
+  flushHelperOutput(spk);
 }
 
 static void spk_doTrack(SpeechSynthesizer *spk)
 {
-  unsigned char b[2];
+  /* indexes are handled by the input monitor as they arrive */
+#ifdef __MINGW32__
+  DWORD available;
   if(helper_fd_in < 0) return;
-  while(myread(spk, helper_fd_in, b, 2)) {
-    unsigned inx;
-    inx = (b[0]<<8 | b[1]);
-    logMessage(LOG_DEBUG, "spktrk: Received index %u", inx);
-    if(inx >= finalIndex) {
-      speaking = 0;
-      logMessage(LOG_DEBUG, "spktrk: Done speaking %d", lastIndex);
-	/* do not change last_inx: remain on position of last spoken words,
-	   not after them. */
-    }else lastIndex = inx;
-  }
+  if(PeekNamedPipe((HANDLE)_get_osfhandle(helper_fd_in), NULL, 0, NULL, &available, NULL)
+     && available)
+    readHelperInput(spk);
+#endif /* __MINGW32__ */
 }
 
 static int spk_getTrack(SpeechSynthesizer *spk)
@@ -335,11 +462,15 @@ static int spk_isSpeaking(SpeechSynthesizer *spk)
 
 static void spk_mute (SpeechSynthesizer *spk)
 {
-  unsigned char c = 1;
+  unsigned char c = HELPER_MUTE;
   if(helper_fd_out < 0) return;
   logMessage(LOG_DEBUG,"mute");
   speaking = 0;
-  mywrite(spk, helper_fd_out, &c,1);
+  /* text still waiting for the pipe would otherwise be spoken after the mute */
+  compactHelperOutput(1);
+  if(!reserveHelperOutput(1)) return;
+  putHelperOutput(&c, 1);
+  flushHelperOutput(spk);
 }
 
 static void spk_setRate (SpeechSynthesizer *spk, unsigned char setting)
@@ -349,17 +480,33 @@ static void spk_setRate (SpeechSynthesizer *spk, unsigned char setting)
   unsigned char l[5];
   if(helper_fd_out < 0) return;
   logMessage(LOG_DEBUG,"set rate to %u (time scale %f)", setting, expand);
-  l[0] = 3; /* time scale code */
+  if(!reserveHelperOutput(5)) return;
+  l[0] = HELPER_RATE;
 #ifdef WORDS_BIGENDIAN
   l[1] = p[0]; l[2] = p[1]; l[3] = p[2]; l[4] = p[3];
 #else /* WORDS_BIGENDIAN */
   l[1] = p[3]; l[2] = p[2]; l[3] = p[1]; l[4] = p[0];
 #endif /* WORDS_BIGENDIAN */
-  mywrite(spk, helper_fd_out, &l, 5);
+  putHelperOutput(l, 5);
+  flushHelperOutput(spk);
 }
 
 static void spk_destruct (SpeechSynthesizer *spk)
 {
+  if(helperInputMonitor) {
+    asyncCancelRequest(helperInputMonitor);
+    helperInputMonitor = NULL;
+  }
+  if(helperOutputMonitor) {
+    asyncCancelRequest(helperOutputMonitor);
+    helperOutputMonitor = NULL;
+  }
+  if(helperOutputBuffer) {
+    free(helperOutputBuffer);
+    helperOutputBuffer = NULL;
+  }
+  helperOutputSize = helperOutputLength = helperOutputWritten = 0;
+  helperInputLength = 0;
   if(helper_fd_in >= 0)
     close(helper_fd_in);
   if(helper_fd_out >= 0)
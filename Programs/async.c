@@ -43,6 +43,33 @@ typedef HANDLE MonitorEntry;
 #include <sys/poll.h>
 typedef struct pollfd MonitorEntry;
 
+#ifdef HAVE_SYS_EPOLL_H
+#define ASYNC_CAN_USE_EPOLL
+
+#include <sys/epoll.h>
+
+typedef struct EpollDescriptorStruct EpollDescriptor;
+
+struct EpollDescriptorStruct {
+  EpollDescriptor *next;
+  FileDescriptor fileDescriptor;
+  unsigned int references;
+
+  unsigned int inputMonitors;
+  unsigned int outputMonitors;
+  unsigned int alertMonitors;
+
+  uint32_t registeredEvents;
+  uint32_t readyEvents;
+  unsigned unpollable:1;
+};
+
+static int epollInstance = -1;
+static pid_t epollProcess;
+static int epollStale = 0;
+static EpollDescriptor *epollDescriptors = NULL;
+#endif /* HAVE_SYS_EPOLL_H */
+
 #elif defined(HAVE_SELECT)
 #define ASYNC_CAN_MONITOR_IO
 
@@ -71,6 +98,7 @@ typedef struct {
 #include "log.h"
 #include "queue.h"
 #include "timing.h"
+#include "program.h"
 
 #include "async.h"
 #include "async_io.h"
@@ -80,8 +108,14 @@ typedef struct {
 struct AsyncHandleStruct {
   Element *element;
   int identifier;
+  unsigned int generation;
 };
 
+/* Handles made before the requests were abandoned no longer refer to
+ * anything, so they may only be freed.
+ */
+static unsigned int handleGeneration = 0;
+
 typedef struct {
   void (*cancelRequest) (Element *element);
 } QueueMethods;
@@ -145,6 +179,13 @@ struct FunctionEntryStruct {
   OVERLAPPED ol;
 #elif defined(HAVE_SYS_POLL_H)
   short pollEvents;
+
+#ifdef ASYNC_CAN_USE_EPOLL
+  EpollDescriptor *epollDescriptor;
+  uint32_t epollEvents;
+  unsigned epollMonitored:1;
+  unsigned epollReady:1;
+#endif /* ASYNC_CAN_USE_EPOLL */
 #elif defined(HAVE_SELECT)
   SelectDescriptor *selectDescriptor;
 #endif /* monitor definitions */
@@ -343,22 +384,38 @@ initializeMonitor (MonitorEntry *monitor, const FunctionEntry *function, const O
 
 static int
 testMonitor (const MonitorEntry *monitor, const FunctionEntry *function) {
-  return (monitor->revents & function->pollEvents) != 0;
+  return (monitor->revents & (function->pollEvents | POLLERR | POLLHUP | POLLNVAL)) != 0;
+}
+
+static void
+beginUnixFunction (FunctionEntry *function, short pollEvents) {
+  function->pollEvents = pollEvents;
+
+#ifdef ASYNC_CAN_USE_EPOLL
+  function->epollDescriptor = NULL;
+  function->epollEvents = 0;
+  function->epollMonitored = 0;
+  function->epollReady = 0;
+
+  if (pollEvents & POLLIN) function->epollEvents |= EPOLLIN;
+  if (pollEvents & POLLOUT) function->epollEvents |= EPOLLOUT;
+  if (pollEvents & POLLPRI) function->epollEvents |= EPOLLPRI;
+#endif /* ASYNC_CAN_USE_EPOLL */
 }
 
 static void
 beginUnixInputFunction (FunctionEntry *function) {
-  function->pollEvents = POLLIN;
+  beginUnixFunction(function, POLLIN);
 }
 
 static void
 beginUnixOutputFunction (FunctionEntry *function) {
-  function->pollEvents = POLLOUT;
+  beginUnixFunction(function, POLLOUT);
 }
 
 static void
 beginUnixAlertFunction (FunctionEntry *function) {
-  function->pollEvents = POLLPRI;
+  beginUnixFunction(function, POLLPRI);
 }
 
 #elif defined(HAVE_SELECT)
@@ -512,9 +569,12 @@ finishUnixWrite (OperationEntry *operation) {
 #endif /* __MINGW32__ */
 
 #ifdef ASYNC_CAN_MONITOR_IO
+static void detachFunctionMonitor (FunctionEntry *function);
+
 static void
 deallocateFunctionEntry (void *item, void *data) {
   FunctionEntry *function = item;
+  detachFunctionMonitor(function);
   if (function->operations) deallocateQueue(function->operations);
   if (function->methods->endFunction) function->methods->endFunction(function);
   free(function);
@@ -525,11 +585,11 @@ createFunctionQueue (void *data) {
   return newQueue(deallocateFunctionEntry, NULL);
 }
 
+static Queue *functionQueue = NULL;
+
 static Queue *
 getFunctionQueue (int create) {
-  static Queue *functions = NULL;
-
-  return getProgramQueue(&functions, "async-function-queue", create,
+  return getProgramQueue(&functionQueue, "async-function-queue", create,
                          createFunctionQueue, NULL);
 }
 
@@ -555,6 +615,369 @@ finishOperation (OperationEntry *operation) {
   }
 }
 
+#ifdef ASYNC_CAN_USE_EPOLL
+static int
+wantsFunctionMonitor (const FunctionEntry *function) {
+  const OperationEntry *operation = getFirstOperation(function);
+
+  if (!operation) return 0;
+  if (operation->active) return 0;
+  if (operation->finished) return 0;
+  return 1;
+}
+
+static EpollDescriptor *
+findEpollDescriptor (FileDescriptor fileDescriptor) {
+  EpollDescriptor *descriptor = epollDescriptors;
+
+  while (descriptor) {
+    if (descriptor->fileDescriptor == fileDescriptor) return descriptor;
+    descriptor = descriptor->next;
+  }
+
+  return NULL;
+}
+
+static EpollDescriptor *
+getEpollDescriptor (FileDescriptor fileDescriptor) {
+  EpollDescriptor *descriptor = findEpollDescriptor(fileDescriptor);
+
+  if (descriptor) return descriptor;
+
+  if ((descriptor = malloc(sizeof(*descriptor)))) {
+    memset(descriptor, 0, sizeof(*descriptor));
+    descriptor->fileDescriptor = fileDescriptor;
+
+    descriptor->next = epollDescriptors;
+    epollDescriptors = descriptor;
+    return descriptor;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static void
+adjustEpollMonitors (EpollDescriptor *descriptor, uint32_t events, int delta) {
+  if (events & EPOLLIN) descriptor->inputMonitors += delta;
+  if (events & EPOLLOUT) descriptor->outputMonitors += delta;
+  if (events & EPOLLPRI) descriptor->alertMonitors += delta;
+}
+
+static void
+registerEpollDescriptor (EpollDescriptor *descriptor) {
+  uint32_t events = 0;
+
+  if (descriptor->inputMonitors) events |= EPOLLIN;
+  if (descriptor->outputMonitors) events |= EPOLLOUT;
+  if (descriptor->alertMonitors) events |= EPOLLPRI;
+
+  if (descriptor->unpollable) return;
+  if (events == descriptor->registeredEvents) return;
+
+  {
+    struct epoll_event event = {
+      .events = events,
+      .data.fd = descriptor->fileDescriptor
+    };
+
+    int operation = !descriptor->registeredEvents? EPOLL_CTL_ADD:
+                    !events? EPOLL_CTL_DEL:
+                    EPOLL_CTL_MOD;
+
+    if (epoll_ctl(epollInstance, operation, descriptor->fileDescriptor, &event) == -1) {
+      if ((operation == EPOLL_CTL_MOD) && (errno == ENOENT)) {
+        /* the file was closed (and maybe reopened) since it was registered */
+        epollStale = 1;
+        operation = EPOLL_CTL_ADD;
+      } else if ((operation == EPOLL_CTL_ADD) && (errno == EEXIST)) {
+        operation = EPOLL_CTL_MOD;
+      } else {
+        operation = -1;
+      }
+
+      if ((operation == -1) || (epoll_ctl(epollInstance, operation, descriptor->fileDescriptor, &event) == -1)) {
+        if (errno == EPERM) {
+          /* regular files can't be monitored - they're always ready */
+          descriptor->unpollable = 1;
+        } else if (events || ((errno != ENOENT) && (errno != EBADF))) {
+          logSystemError("epoll_ctl");
+          return;
+        } else {
+          /* The file was closed before its monitors were cancelled. If
+           * it's still open elsewhere (a dup or a child process) then the
+           * kernel still has it registered.
+           */
+          epollStale = 1;
+        }
+
+        events = 0;
+      }
+    }
+  }
+
+  descriptor->registeredEvents = events;
+}
+
+static int
+getEpollInstance (void) {
+  static int failed = 0;
+
+  if (epollInstance != -1) {
+    /* A forked child shares its parent's instance, and a stale
+     * registration can't be removed, so, in either case, start afresh.
+     */
+    if (epollStale || (epollProcess != getpid())) {
+      close(epollInstance);
+      epollInstance = -1;
+    }
+  }
+
+  if ((epollInstance == -1) && !failed) {
+    if ((epollInstance = epoll_create1(EPOLL_CLOEXEC)) != -1) {
+      EpollDescriptor *descriptor = epollDescriptors;
+
+      if (!descriptor) logMessage(LOG_DEBUG, "monitoring I/O via epoll");
+      epollProcess = getpid();
+      epollStale = 0;
+
+      while (descriptor) {
+        descriptor->registeredEvents = 0;
+        registerEpollDescriptor(descriptor);
+        descriptor = descriptor->next;
+      }
+    } else {
+      logSystemError("epoll_create1");
+      failed = 1;
+    }
+  }
+
+  return epollInstance;
+}
+
+static void
+releaseEpollDescriptor (EpollDescriptor *descriptor) {
+  if (!--descriptor->references) {
+    EpollDescriptor **link = &epollDescriptors;
+
+    registerEpollDescriptor(descriptor);
+
+    while (*link) {
+      if (*link == descriptor) {
+        *link = descriptor->next;
+        break;
+      }
+
+      link = &(*link)->next;
+    }
+
+    free(descriptor);
+  }
+}
+
+static void
+updateFunctionMonitor (FunctionEntry *function) {
+  if (getEpollInstance() != -1) {
+    int monitor = wantsFunctionMonitor(function);
+
+    if (!function->epollDescriptor) {
+      if (!monitor) return;
+      if (!(function->epollDescriptor = getEpollDescriptor(function->fileDescriptor))) return;
+      function->epollDescriptor->references += 1;
+    }
+
+    if (monitor != function->epollMonitored) {
+      adjustEpollMonitors(function->epollDescriptor, function->epollEvents, (monitor? 1: -1));
+      function->epollMonitored = monitor;
+      registerEpollDescriptor(function->epollDescriptor);
+    }
+  }
+}
+
+static void
+detachFunctionMonitor (FunctionEntry *function) {
+  EpollDescriptor *descriptor = function->epollDescriptor;
+
+  if (descriptor) {
+    getEpollInstance();
+
+    if (function->epollMonitored) {
+      adjustEpollMonitors(descriptor, function->epollEvents, -1);
+      function->epollMonitored = 0;
+    }
+
+    function->epollDescriptor = NULL;
+    releaseEpollDescriptor(descriptor);
+  }
+}
+
+static void
+resetFunctionMonitor (FunctionEntry *function) {
+  function->epollReady = 0;
+}
+#else /* ASYNC_CAN_USE_EPOLL */
+static void
+updateFunctionMonitor (FunctionEntry *function) {
+}
+
+static void
+detachFunctionMonitor (FunctionEntry *function) {
+}
+
+static void
+resetFunctionMonitor (FunctionEntry *function) {
+}
+#endif /* ASYNC_CAN_USE_EPOLL */
+
+static void
+invokeFunction (Element *functionElement) {
+  FunctionEntry *function = getElementItem(functionElement);
+  Element *operationElement = getQueueHead(function->operations);
+  OperationEntry *operation = getElementItem(operationElement);
+
+  if (!operation->finished) finishOperation(operation);
+
+  operation->active = 1;
+  if (!function->methods->invokeCallback(operation)) operation->cancel = 1;
+  operation->active = 0;
+
+  if (operation->cancel) {
+    deleteElement(operationElement);
+  } else {
+    operation->error = 0;
+  }
+
+  if ((operationElement = getQueueHead(function->operations))) {
+    operation = getElementItem(operationElement);
+    if (!operation->finished) startOperation(operation);
+    requeueElement(functionElement);
+    updateFunctionMonitor(function);
+  } else {
+    deleteElement(functionElement);
+  }
+}
+
+#ifdef ASYNC_CAN_USE_EPOLL
+static int
+testImmediateFunction (void *item, void *data) {
+  const FunctionEntry *function = item;
+  const OperationEntry *operation = getFirstOperation(function);
+
+  if (operation && !operation->active) {
+    if (operation->finished) return 1;
+    if (function->epollDescriptor && function->epollDescriptor->unpollable) return 1;
+  }
+
+  return 0;
+}
+
+static int
+markReadyFunction (void *item, void *data) {
+  FunctionEntry *function = item;
+  const EpollDescriptor *descriptor = function->epollDescriptor;
+
+  if (descriptor && function->epollMonitored) {
+    if (descriptor->readyEvents & (function->epollEvents | EPOLLERR | EPOLLHUP)) {
+      if (wantsFunctionMonitor(function)) {
+        function->epollReady = 1;
+      } else {
+        /* Its callback is running (we're nested within it) - stop
+         * monitoring until it returns so that we don't spin. */
+        updateFunctionMonitor(function);
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int
+testReadyFunction (void *item, void *data) {
+  const FunctionEntry *function = item;
+
+  if (function->epollReady) {
+    const OperationEntry *operation = getFirstOperation(function);
+
+    if (operation && !operation->active) return 1;
+  }
+
+  return 0;
+}
+
+static int
+isFunctionStillReady (const FunctionEntry *function) {
+  MonitorEntry monitor;
+  int result;
+
+  initializeMonitor(&monitor, function, NULL);
+
+  while ((result = poll(&monitor, 1, 0)) == -1) {
+    if (errno != EINTR) {
+      logSystemError("poll");
+      return 1;
+    }
+  }
+
+  return result && testMonitor(&monitor, function);
+}
+
+static void
+awaitEpollOperations (Queue *functions, long int timeout) {
+  Element *functionElement = processQueue(functions, testImmediateFunction, NULL);
+
+  if (functionElement) {
+    invokeFunction(functionElement);
+  } else {
+    struct epoll_event events[0X10];
+    int count = epoll_wait(epollInstance, events, ARRAY_COUNT(events), timeout);
+
+    if (count > 0) {
+      int index;
+
+      for (index=0; index<count; index+=1) {
+        EpollDescriptor *descriptor = findEpollDescriptor(events[index].data.fd);
+
+        if (descriptor) {
+          descriptor->readyEvents = events[index].events;
+        } else {
+          /* a registration which outlived its descriptor's monitors */
+          epollStale = 1;
+        }
+      }
+
+      processQueue(functions, markReadyFunction, NULL);
+
+      for (index=0; index<count; index+=1) {
+        EpollDescriptor *descriptor = findEpollDescriptor(events[index].data.fd);
+        if (descriptor) descriptor->readyEvents = 0;
+      }
+
+      {
+        int dispatched = 0;
+
+        /* Each dispatch looks the next function up again since a callback
+         * may have cancelled any of the others. A callback may also have
+         * consumed what the snapshot said was ready (e.g. by reading the
+         * same descriptor), so later functions are checked again first.
+         */
+        while ((functionElement = processQueue(functions, testReadyFunction, NULL))) {
+          FunctionEntry *function = getElementItem(functionElement);
+
+          function->epollReady = 0;
+          if (dispatched && !isFunctionStillReady(function)) continue;
+
+          dispatched = 1;
+          invokeFunction(functionElement);
+        }
+      }
+    } else if (count == -1) {
+      if (errno != EINTR) logSystemError("epoll_wait");
+    }
+  }
+}
+#endif /* ASYNC_CAN_USE_EPOLL */
+
 static int
 addFunctionMonitor (void *item, void *data) {
   const FunctionEntry *function = item;
@@ -598,6 +1021,13 @@ awaitNextOperation (long int timeout) {
   Queue *functions = getFunctionQueue(0);
   unsigned int functionCount = functions? getQueueSize(functions): 0;
 
+#ifdef ASYNC_CAN_USE_EPOLL
+  if (functionCount && (getEpollInstance() != -1)) {
+    awaitEpollOperations(functions, timeout);
+    return;
+  }
+#endif /* ASYNC_CAN_USE_EPOLL */
+
   prepareMonitors();
 
   if (functionCount) {
@@ -616,31 +1046,7 @@ awaitNextOperation (long int timeout) {
       }
     }
 
-    if (functionElement) {
-      FunctionEntry *function = getElementItem(functionElement);
-      Element *operationElement = getQueueHead(function->operations);
-      OperationEntry *operation = getElementItem(operationElement);
-
-      if (!operation->finished) finishOperation(operation);
-
-      operation->active = 1;
-      if (!function->methods->invokeCallback(operation)) operation->cancel = 1;
-      operation->active = 0;
-
-      if (operation->cancel) {
-        deleteElement(operationElement);
-      } else {
-        operation->error = 0;
-      }
-
-      if ((operationElement = getQueueHead(function->operations))) {
-        operation = getElementItem(operationElement);
-        if (!operation->finished) startOperation(operation);
-        requeueElement(functionElement);
-      } else {
-        deleteElement(functionElement);
-      }
-    }
+    if (functionElement) invokeFunction(functionElement);
   } else {
     approximateDelay(timeout);
   }
@@ -756,6 +1162,8 @@ cancelOperation (Element *operationElement) {
         operation = getElementItem(operationElement);
 
         if (!operation->finished) startOperation(operation);
+        resetFunctionMonitor(function);
+        updateFunctionMonitor(function);
       }
     }
   }
@@ -849,7 +1257,12 @@ newOperation (
         operation->cancel = 0;
         operation->finished = 0;
 
-        if (isFirstOperation) startOperation(operation);
+        if (isFirstOperation) {
+          startOperation(operation);
+          resetFunctionMonitor(function);
+          updateFunctionMonitor(function);
+        }
+
         return operationElement;
       }
 
@@ -1021,6 +1434,7 @@ makeHandle (
         memset(*handle, 0, sizeof(**handle));
         (*handle)->element = element;
         (*handle)->identifier = getElementIdentifier(element);
+        (*handle)->generation = handleGeneration;
       }
 
       return 1;
@@ -1035,7 +1449,9 @@ static int
 checkHandleValidity (AsyncHandle handle) {
   if (handle) {
     if (handle->element) {
-      return 1;
+      if (handle->generation == handleGeneration) {
+        return 1;
+      }
     }
   }
 
@@ -1065,9 +1481,9 @@ deallocateHandle (AsyncHandle handle) {
 
   if (checkHandleValidity(handle)) {
     if (checkHandleIdentifier(handle)) element = handle->element;
-    free(handle);
   }
 
+  if (handle) free(handle);
   return element;
 }
 
@@ -1344,35 +1760,229 @@ asyncWriteSocket (
 }
 #endif /* __MINGW32__ */
 
-typedef struct {
+typedef struct AlarmEntryStruct AlarmEntry;
+
+struct AlarmEntryStruct {
+  AlarmEntry *nextUnused;
+  Element *element;
+  unsigned int heapIndex;
+  unsigned long int sequence;
+  unsigned fired:1;
+
   TimeValue time;
   AsyncAlarmCallback *callback;
   void *data;
-} AlarmEntry;
+};
+
+typedef struct {
+  unsigned long int sets;
+  unsigned long int resets;
+  unsigned long int cancels;
+  unsigned long int fires;
+} AlarmCounters;
+
+static struct {
+  AlarmEntry **heap;
+  unsigned int heapSize;
+  unsigned int heapCount;
+
+  AlarmEntry *unusedEntries;
+  unsigned long int sequence;
+
+  AlarmCounters counters;
+  TimeValue reportTime;
+} alarmData = {
+  .heap = NULL,
+  .heapSize = 0,
+  .heapCount = 0,
+
+  .unusedEntries = NULL,
+  .sequence = 0,
+
+  .reportTime = {
+    .seconds = 0
+  }
+};
+
+static int
+isEarlierAlarm (const AlarmEntry *alarm1, const AlarmEntry *alarm2) {
+  int relation = compareTimeValues(&alarm1->time, &alarm2->time);
+
+  if (relation) return relation < 0;
+  return alarm1->sequence < alarm2->sequence;
+}
+
+static void
+setAlarmHeapEntry (unsigned int index, AlarmEntry *alarm) {
+  alarmData.heap[index] = alarm;
+  alarm->heapIndex = index;
+}
+
+static void
+raiseAlarmHeapEntry (AlarmEntry *alarm) {
+  unsigned int index = alarm->heapIndex;
+
+  while (index > 0) {
+    unsigned int parentIndex = (index - 1) / 2;
+    AlarmEntry *parent = alarmData.heap[parentIndex];
+
+    if (!isEarlierAlarm(alarm, parent)) break;
+    setAlarmHeapEntry(index, parent);
+    index = parentIndex;
+  }
+
+  setAlarmHeapEntry(index, alarm);
+}
+
+static void
+lowerAlarmHeapEntry (AlarmEntry *alarm) {
+  unsigned int index = alarm->heapIndex;
+
+  while (1) {
+    unsigned int childIndex = (index * 2) + 1;
+    AlarmEntry *child;
+
+    if (childIndex >= alarmData.heapCount) break;
+    child = alarmData.heap[childIndex];
+
+    if (++childIndex < alarmData.heapCount) {
+      AlarmEntry *sibling = alarmData.heap[childIndex];
+
+      if (isEarlierAlarm(sibling, child)) {
+        child = sibling;
+      } else {
+        childIndex -= 1;
+      }
+    } else {
+      childIndex -= 1;
+    }
+
+    if (!isEarlierAlarm(child, alarm)) break;
+    setAlarmHeapEntry(index, child);
+    index = childIndex;
+  }
+
+  setAlarmHeapEntry(index, alarm);
+}
+
+static void
+adjustAlarmHeapEntry (AlarmEntry *alarm) {
+  raiseAlarmHeapEntry(alarm);
+  lowerAlarmHeapEntry(alarm);
+}
+
+static int
+addAlarmHeapEntry (AlarmEntry *alarm) {
+  if (alarmData.heapCount == alarmData.heapSize) {
+    unsigned int newSize = alarmData.heapSize? (alarmData.heapSize << 1): 0X10;
+    AlarmEntry **newHeap = realloc(alarmData.heap, newSize * sizeof(*newHeap));
+
+    if (!newHeap) {
+      logMallocError();
+      return 0;
+    }
+
+    alarmData.heap = newHeap;
+    alarmData.heapSize = newSize;
+  }
+
+  alarm->heapIndex = alarmData.heapCount++;
+  raiseAlarmHeapEntry(alarm);
+  return 1;
+}
+
+static void
+removeAlarmHeapEntry (AlarmEntry *alarm) {
+  AlarmEntry *last = alarmData.heap[--alarmData.heapCount];
+
+  if (last != alarm) {
+    last->heapIndex = alarm->heapIndex;
+    adjustAlarmHeapEntry(last);
+  }
+}
+
+static AlarmEntry *
+getEarliestAlarm (void) {
+  return alarmData.heapCount? alarmData.heap[0]: NULL;
+}
+
+static void
+setAlarmSequence (AlarmEntry *alarm) {
+  alarm->sequence = ++alarmData.sequence;
+}
+
+static void
+logAlarmCounters (void) {
+  if (LOG_CATEGORY_FLAG(ASYNC_EVENTS)) {
+    AlarmCounters *counters = &alarmData.counters;
+    TimeValue now;
+
+    getCurrentTime(&now);
+
+    if (alarmData.reportTime.seconds) {
+      long int elapsed = millisecondsBetween(&alarmData.reportTime, &now);
+
+      if ((elapsed >= 0) && (elapsed < MSECS_PER_SEC)) return;
+
+      if (counters->sets || counters->resets || counters->cancels || counters->fires) {
+        logMessage(LOG_CATEGORY(ASYNC_EVENTS),
+                   "alarms in %ldms: %lu set, %lu reset, %lu cancelled, %lu fired, %u pending",
+                   elapsed, counters->sets, counters->resets,
+                   counters->cancels, counters->fires,
+                   alarmData.heapCount);
+      }
+    }
+
+    memset(counters, 0, sizeof(*counters));
+    alarmData.reportTime = now;
+  }
+}
 
 static void
 deallocateAlarmEntry (void *item, void *data) {
   AlarmEntry *alarm = item;
-  free(alarm);
+
+  removeAlarmHeapEntry(alarm);
+  if (!alarm->fired) alarmData.counters.cancels += 1;
+
+  alarm->nextUnused = alarmData.unusedEntries;
+  alarmData.unusedEntries = alarm;
 }
 
-static int
-compareAlarmEntries (const void *item1, const void *item2, void *data) {
-  const AlarmEntry *alarm1 = item1;
-  const AlarmEntry *alarm2 = item2;
-  return compareTimeValues(&alarm1->time, &alarm2->time) < 0;
+static void
+exitAlarmData (void *data) {
+  while (alarmData.unusedEntries) {
+    AlarmEntry *alarm = alarmData.unusedEntries;
+    alarmData.unusedEntries = alarm->nextUnused;
+    free(alarm);
+  }
+
+  if (alarmData.heap) {
+    free(alarmData.heap);
+    alarmData.heap = NULL;
+  }
+
+  alarmData.heapSize = 0;
+  alarmData.heapCount = 0;
 }
 
 static Queue *
 createAlarmQueue (void *data) {
-  return newQueue(deallocateAlarmEntry, compareAlarmEntries);
+  static int initialized = 0;
+
+  if (!initialized) {
+    initialized = 1;
+    onProgramExit("async-alarm-data", exitAlarmData, NULL);
+  }
+
+  return newQueue(deallocateAlarmEntry, NULL);
 }
 
+static Queue *alarmQueue = NULL;
+
 static Queue *
 getAlarmQueue (int create) {
-  static Queue *alarms = NULL;
-
-  return getProgramQueue(&alarms, "async-alarm-queue", create,
+  return getProgramQueue(&alarmQueue, "async-alarm-queue", create,
                          createAlarmQueue, NULL);
 }
 
@@ -1382,6 +1992,19 @@ typedef struct {
   void *data;
 } AlarmElementParameters;
 
+static AlarmEntry *
+allocateAlarmEntry (void) {
+  AlarmEntry *alarm = alarmData.unusedEntries;
+
+  if (alarm) {
+    alarmData.unusedEntries = alarm->nextUnused;
+  } else if (!(alarm = malloc(sizeof(*alarm)))) {
+    logMallocError();
+  }
+
+  return alarm;
+}
+
 static Element *
 newAlarmElement (const void *parameters) {
   const AlarmElementParameters *aep = parameters;
@@ -1390,20 +2013,28 @@ newAlarmElement (const void *parameters) {
   if (alarms) {
     AlarmEntry *alarm;
 
-    if ((alarm = malloc(sizeof(*alarm)))) {
+    if ((alarm = allocateAlarmEntry())) {
+      alarm->nextUnused = NULL;
+      alarm->fired = 0;
       alarm->time = *aep->time;
       alarm->callback = aep->callback;
       alarm->data = aep->data;
+      setAlarmSequence(alarm);
 
-      {
+      if (addAlarmHeapEntry(alarm)) {
         Element *element = enqueueItem(alarms, alarm);
 
-        if (element) return element;
+        if (element) {
+          alarm->element = element;
+          alarmData.counters.sets += 1;
+          return element;
+        }
+
+        removeAlarmHeapEntry(alarm);
       }
 
-      free(alarm);
-    } else {
-      logMallocError();
+      alarm->nextUnused = alarmData.unusedEntries;
+      alarmData.unusedEntries = alarm;
     }
   }
 
@@ -1453,7 +2084,9 @@ asyncResetAlarmTo (AsyncHandle handle, const TimeValue *time) {
     AlarmEntry *alarm = getElementItem(element);
 
     alarm->time = *time;
-    requeueElement(element);
+    setAlarmSequence(alarm);
+    adjustAlarmHeapEntry(alarm);
+    alarmData.counters.resets += 1;
     return 1;
   }
 
@@ -1469,33 +2102,32 @@ asyncResetAlarmIn (AsyncHandle handle, int interval) {
 
 static void
 awaitNextResponse (long int timeout) {
-  {
-    Queue *alarms = getAlarmQueue(0);
+  logAlarmCounters();
 
-    if (alarms) {
-      Element *element = getQueueHead(alarms);
-
-      if (element) {
-        AlarmEntry *alarm = getElementItem(element);
-        TimeValue now;
-        long int milliseconds;
+  {
+    AlarmEntry *alarm = getEarliestAlarm();
 
-        getCurrentTime(&now);
-        milliseconds = millisecondsBetween(&now, &alarm->time);
+    if (alarm) {
+      TimeValue now;
+      long int milliseconds;
 
-        if (milliseconds <= 0) {
-          AsyncAlarmCallback *callback = alarm->callback;
-          const AsyncAlarmResult result = {
-            .data = alarm->data
-          };
+      getCurrentTime(&now);
+      milliseconds = millisecondsBetween(&now, &alarm->time);
 
-          deleteElement(element);
-          if (callback) callback(&result);
-          return;
-        }
+      if (milliseconds <= 0) {
+        AsyncAlarmCallback *callback = alarm->callback;
+        const AsyncAlarmResult result = {
+          .data = alarm->data
+        };
 
-        if (milliseconds < timeout) timeout = milliseconds;
+        alarm->fired = 1;
+        alarmData.counters.fires += 1;
+        deleteElement(alarm->element);
+        if (callback) callback(&result);
+        return;
       }
+
+      if (milliseconds < timeout) timeout = milliseconds;
     }
   }
 
@@ -1529,3 +2161,24 @@ void
 asyncWait (int duration) {
   asyncAwaitCondition(duration, NULL, NULL);
 }
+
+void
+asyncAbandonRequests (void) {
+#ifdef ASYNC_CAN_MONITOR_IO
+  functionQueue = NULL;
+
+#ifdef ASYNC_CAN_USE_EPOLL
+  if (epollInstance != -1) {
+    close(epollInstance);
+    epollInstance = -1;
+  }
+
+  epollDescriptors = NULL;
+#endif /* ASYNC_CAN_USE_EPOLL */
+#endif /* ASYNC_CAN_MONITOR_IO */
+
+  alarmQueue = NULL;
+  alarmData.heapCount = 0;
+
+  handleGeneration += 1;
+}
@@ -28,6 +28,8 @@ typedef struct AsyncHandleStruct *AsyncHandle;
 extern void asyncDiscardHandle (AsyncHandle handle);
 extern void asyncCancelRequest (AsyncHandle handle);
 
+extern void asyncAbandonRequests (void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
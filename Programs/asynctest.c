@@ -0,0 +1,134 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+/* asynctest.c - Test program for asynchronous I/O dispatch
+ *
+ * An input monitor and a read are both waiting on the same pipe. Whichever
+ * is dispatched first consumes the byte which made the pipe readable, so
+ * the other one mustn't be called until there's more input. The pipe is
+ * non-blocking so that a wrong dispatch shows up as EAGAIN rather than as
+ * a hang.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "program.h"
+#include "options.h"
+#include "log.h"
+#include "async_io.h"
+#include "async_wait.h"
+
+BEGIN_OPTION_TABLE(programOptions)
+END_OPTION_TABLE
+
+#define TEST_ROUNDS 10
+
+static int testPipe[2];
+static unsigned int bytesConsumed = 0;
+static unsigned int emptyDispatches = 0;
+
+static int
+handleMonitoredInput (const AsyncMonitorResult *result) {
+  unsigned char byte;
+  ssize_t count = read(testPipe[0], &byte, 1);
+
+  if (count == 1) {
+    bytesConsumed += 1;
+  } else if ((count == -1) && (errno == EAGAIN)) {
+    logMessage(LOG_ERR, "input monitor called without input");
+    emptyDispatches += 1;
+  } else {
+    logSystemError("read");
+    return 0;
+  }
+
+  return 1;
+}
+
+static size_t
+handleReadInput (const AsyncInputResult *result) {
+  if (result->error) {
+    if (result->error == EAGAIN) {
+      logMessage(LOG_ERR, "read attempted without input");
+      emptyDispatches += 1;
+    } else {
+      logMessage(LOG_ERR, "read error: %s", strerror(result->error));
+    }
+
+    return 0;
+  }
+
+  bytesConsumed += result->length;
+  return result->length;
+}
+
+int
+main (int argc, char *argv[]) {
+  AsyncHandle monitorHandle;
+  AsyncHandle readHandle;
+  unsigned int round;
+  int ok;
+
+  {
+    static const OptionsDescriptor descriptor = {
+      OPTION_TABLE(programOptions),
+      .applicationName = "asynctest"
+    };
+    PROCESS_OPTIONS(descriptor, argc, argv);
+  }
+
+  if (pipe(testPipe) == -1) {
+    logSystemError("pipe");
+    return PROG_EXIT_FATAL;
+  }
+
+  fcntl(testPipe[0], F_SETFL, O_NONBLOCK);
+
+  if (!asyncMonitorFileInput(&monitorHandle, testPipe[0], handleMonitoredInput, NULL)) {
+    return PROG_EXIT_FATAL;
+  }
+
+  if (!asyncReadFile(&readHandle, testPipe[0], 1, handleReadInput, NULL)) {
+    return PROG_EXIT_FATAL;
+  }
+
+  for (round=0; round<TEST_ROUNDS; round+=1) {
+    if (write(testPipe[1], "", 1) != 1) {
+      logSystemError("write");
+      return PROG_EXIT_FATAL;
+    }
+
+    asyncWait(20);
+  }
+
+  ok = (bytesConsumed == TEST_ROUNDS) && !emptyDispatches;
+  logMessage((ok? LOG_NOTICE: LOG_ERR),
+             "two monitors on one pipe: %s (%u of %u bytes consumed, %u empty dispatches)",
+             (ok? "passed": "failed"), bytesConsumed, TEST_ROUNDS, emptyDispatches);
+
+  asyncCancelRequest(monitorHandle);
+  asyncCancelRequest(readHandle);
+  close(testPipe[0]);
+  close(testPipe[1]);
+  return ok? PROG_EXIT_SUCCESS: PROG_EXIT_FATAL;
+}
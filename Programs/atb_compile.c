@@ -20,6 +20,7 @@
 
 #include <string.h>
 
+#include "log.h"
 #include "file.h"
 #include "datafile.h"
 #include "dataarea.h"
@@ -168,6 +169,24 @@ AttributesTable *
 compileAttributesTable (const char *name) {
   AttributesTable *table = NULL;
 
+  {
+    TableCache *cache = openTableCache(name, ATTRIBUTES_TABLE_EXTENSION, ATTRIBUTES_TABLE_CACHE_FORMAT);
+
+    if (cache) {
+      if ((table = malloc(sizeof(*table)))) {
+        table->header.bytes = getTableCacheImage(cache, &table->size);
+        table->cache = cache;
+        return table;
+      } else {
+        logMallocError();
+      }
+
+      closeTableCache(cache);
+    }
+  }
+
+  startTableCacheDependencies();
+
   if (setGlobalTableVariables(ATTRIBUTES_TABLE_EXTENSION, ATTRIBUTES_SUBTABLE_EXTENSION)) {
     AttributesTableData atd;
     memset(&atd, 0, sizeof(atd));
@@ -179,7 +198,11 @@ compileAttributesTable (const char *name) {
             if ((table = malloc(sizeof(*table)))) {
               table->header.fields = getAttributesTableHeader(&atd);
               table->size = getDataSize(atd.area);
+              table->cache = NULL;
               resetDataArea(atd.area);
+
+              saveTableCache(name, ATTRIBUTES_TABLE_EXTENSION, ATTRIBUTES_TABLE_CACHE_FORMAT,
+                             table->header.bytes, table->size);
             }
           }
         }
@@ -189,13 +212,19 @@ compileAttributesTable (const char *name) {
     }
   }
 
+  stopTableCacheDependencies();
   return table;
 }
 
 void
 destroyAttributesTable (AttributesTable *table) {
   if (table->size) {
-    free(table->header.fields);
+    if (table->cache) {
+      closeTableCache(table->cache);
+    } else {
+      free(table->header.fields);
+    }
+
     free(table);
   }
 }
@@ -23,8 +23,13 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#include "tblcache.h"
+
 typedef uint32_t AttributesTableOffset;
 
+/* change this whenever the layout of the compiled table changes */
+#define ATTRIBUTES_TABLE_CACHE_FORMAT 1
+
 typedef struct {
   unsigned char attributesToDots[0X100];
 } AttributesTableHeader;
@@ -36,6 +41,7 @@ struct AttributesTableStruct {
   } header;
 
   size_t size;
+  TableCache *cache;
 };
 
 #ifdef __cplusplus
@@ -29,7 +29,8 @@ static const unsigned char internalAttributesTableBytes[] = {
 
 static AttributesTable internalAttributesTable = {
   .header.bytes = internalAttributesTableBytes,
-  .size = 0
+  .size = 0,
+  .cache = NULL
 };
 
 AttributesTable *attributesTable = &internalAttributesTable;
@@ -19,12 +19,14 @@
 #include "prologue.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 
 #include "log.h"
 #include "timing.h"
+#include "async_alarm.h"
 #include "async_wait.h"
 #include "message.h"
 #include "charset.h"
@@ -51,6 +53,8 @@ initializeBrailleDisplay (BrailleDisplay *brl) {
 
   brl->buffer = NULL;
   brl->writeDelay = 0;
+  brl->outputScheduler = NULL;
+  brl->outputFailed = NULL;
   brl->bufferResized = NULL;
   brl->touchEnabled = 0;
   brl->highlightWindow = 0;
@@ -60,9 +64,272 @@ initializeBrailleDisplay (BrailleDisplay *brl) {
   brl->rotateKey = NULL;
 }
 
+struct BrailleOutputSchedulerStruct {
+  TimeValue readyTime;
+  unsigned int writeDelay;
+
+  AsyncHandle alarm;
+  unsigned framePending:1;
+  unsigned frameHasText:1;
+  unsigned writeFailed:1;
+  int frameCursor;
+  unsigned int frameSize;
+  unsigned char *frameCells;
+  wchar_t *frameText;
+
+  BrailleOutputCounters counters;
+};
+
+static BrailleOutputScheduler *
+getBrailleOutputScheduler (BrailleDisplay *brl) {
+  if (!brl->outputScheduler) {
+    BrailleOutputScheduler *scheduler;
+
+    if (!(scheduler = malloc(sizeof(*scheduler)))) {
+      logMallocError();
+      return NULL;
+    }
+
+    memset(scheduler, 0, sizeof(*scheduler));
+    getCurrentTime(&scheduler->readyTime);
+    scheduler->writeDelay = 0;
+    scheduler->alarm = NULL;
+    scheduler->frameCells = NULL;
+    scheduler->frameText = NULL;
+
+    brl->outputScheduler = scheduler;
+  }
+
+  return brl->outputScheduler;
+}
+
+static long int
+getBrailleOutputDelay (BrailleDisplay *brl, BrailleOutputScheduler *scheduler) {
+  TimeValue now;
+
+  getCurrentTime(&now);
+  if (compareTimeValues(&scheduler->readyTime, &now) < 0) scheduler->readyTime = now;
+
+  /* The drivers account for what they write by adding its transfer time to
+   * writeDelay. Fold whatever has been added since the last look into the
+   * time at which the link is expected to become free.
+   */
+  if (brl->writeDelay < scheduler->writeDelay) scheduler->writeDelay = 0;
+
+  if (brl->writeDelay > scheduler->writeDelay) {
+    adjustTimeValue(&scheduler->readyTime, brl->writeDelay - scheduler->writeDelay);
+    scheduler->writeDelay = brl->writeDelay;
+  }
+
+  return millisecondsBetween(&now, &scheduler->readyTime);
+}
+
+static int
+writeBrailleFrame (BrailleDisplay *brl, BrailleOutputScheduler *scheduler, const wchar_t *text) {
+  int ok = braille->writeWindow(brl, text);
+
+  scheduler->counters.framesWritten += 1;
+  getBrailleOutputDelay(brl, scheduler);
+  return ok;
+}
+
+static int
+saveBrailleFrame (BrailleDisplay *brl, BrailleOutputScheduler *scheduler, const wchar_t *text) {
+  unsigned int size = brl->textColumns * brl->textRows;
+
+  if (size != scheduler->frameSize) {
+    unsigned char *cells;
+    wchar_t *characters;
+
+    if (!(cells = malloc(ARRAY_SIZE(cells, size)))) {
+      logMallocError();
+      return 0;
+    }
+
+    if (!(characters = malloc(ARRAY_SIZE(characters, size)))) {
+      logMallocError();
+      free(cells);
+      return 0;
+    }
+
+    if (scheduler->frameCells) free(scheduler->frameCells);
+    scheduler->frameCells = cells;
+
+    if (scheduler->frameText) free(scheduler->frameText);
+    scheduler->frameText = characters;
+
+    scheduler->frameSize = size;
+  }
+
+  memcpy(scheduler->frameCells, brl->buffer, size);
+  if ((scheduler->frameHasText = text != NULL)) wmemcpy(scheduler->frameText, text, size);
+  scheduler->frameCursor = brl->cursor;
+  return 1;
+}
+
+static void
+cancelBrailleFrame (BrailleOutputScheduler *scheduler) {
+  if (scheduler->alarm) {
+    asyncCancelRequest(scheduler->alarm);
+    scheduler->alarm = NULL;
+  }
+
+  if (scheduler->framePending) {
+    scheduler->framePending = 0;
+    scheduler->counters.framesDropped += 1;
+  }
+}
+
+static int
+writePendingFrame (BrailleDisplay *brl, BrailleOutputScheduler *scheduler) {
+  int ok = 1;
+
+  if (scheduler->alarm) {
+    asyncCancelRequest(scheduler->alarm);
+    scheduler->alarm = NULL;
+  }
+
+  if (scheduler->framePending) {
+    scheduler->framePending = 0;
+
+    if (scheduler->frameSize == (brl->textColumns * brl->textRows)) {
+      unsigned char *buffer = brl->buffer;
+      int cursor = brl->cursor;
+
+      brl->buffer = scheduler->frameCells;
+      brl->cursor = scheduler->frameCursor;
+      ok = writeBrailleFrame(brl, scheduler, (scheduler->frameHasText? scheduler->frameText: NULL));
+      brl->buffer = buffer;
+      brl->cursor = cursor;
+    } else {
+      scheduler->counters.framesDropped += 1;
+    }
+  }
+
+  return ok;
+}
+
+static void
+writeDeferredFrame (BrailleDisplay *brl, BrailleOutputScheduler *scheduler) {
+  if (!writePendingFrame(brl, scheduler)) {
+    /* the caller of writeBrailleWindow has already been told it worked */
+    scheduler->writeFailed = 1;
+    if (brl->outputFailed) brl->outputFailed();
+  }
+}
+
+static void
+handleBrailleOutputAlarm (const AsyncAlarmResult *result) {
+  BrailleDisplay *brl = result->data;
+  BrailleOutputScheduler *scheduler = brl->outputScheduler;
+
+  asyncDiscardHandle(scheduler->alarm);
+  scheduler->alarm = NULL;
+
+  if (getBrailleOutputDelay(brl, scheduler) > 0) {
+    if (asyncSetAlarmTo(&scheduler->alarm, &scheduler->readyTime,
+                        handleBrailleOutputAlarm, brl)) {
+      return;
+    }
+  }
+
+  writeDeferredFrame(brl, scheduler);
+}
+
+int
+writeBrailleWindow (BrailleDisplay *brl, const wchar_t *text) {
+  BrailleOutputScheduler *scheduler = getBrailleOutputScheduler(brl);
+
+  if (!scheduler) return braille->writeWindow(brl, text);
+
+  if (scheduler->writeFailed) {
+    scheduler->writeFailed = 0;
+    return 0;
+  }
+
+  if (!scheduler->framePending) {
+    if (getBrailleOutputDelay(brl, scheduler) <= 0) {
+      return writeBrailleFrame(brl, scheduler, text);
+    }
+  }
+
+  if (saveBrailleFrame(brl, scheduler, text)) {
+    if (scheduler->framePending) {
+      scheduler->counters.framesCoalesced += 1;
+      return 1;
+    }
+
+    if (asyncSetAlarmTo(&scheduler->alarm, &scheduler->readyTime,
+                        handleBrailleOutputAlarm, brl)) {
+      scheduler->framePending = 1;
+      scheduler->counters.framesDeferred += 1;
+      return 1;
+    }
+  }
+
+  cancelBrailleFrame(scheduler);
+  return writeBrailleFrame(brl, scheduler, text);
+}
+
+int
+isBrailleOutputBusy (BrailleDisplay *brl) {
+  BrailleOutputScheduler *scheduler = getBrailleOutputScheduler(brl);
+
+  if (!scheduler) return 0;
+  if (scheduler->framePending) return 1;
+  return getBrailleOutputDelay(brl, scheduler) > 0;
+}
+
+void
+getBrailleOutputCounters (BrailleDisplay *brl, BrailleOutputCounters *counters) {
+  BrailleOutputScheduler *scheduler = brl->outputScheduler;
+
+  if (scheduler) {
+    *counters = scheduler->counters;
+  } else {
+    memset(counters, 0, sizeof(*counters));
+  }
+}
+
+void
+stopBrailleOutput (BrailleDisplay *brl) {
+  BrailleOutputScheduler *scheduler = brl->outputScheduler;
+
+  if (scheduler) {
+    const BrailleOutputCounters *counters = &scheduler->counters;
+
+    cancelBrailleFrame(scheduler);
+    logMessage(LOG_DEBUG,
+               "braille output frames: %lu written, %lu deferred, %lu coalesced, %lu dropped",
+               counters->framesWritten, counters->framesDeferred,
+               counters->framesCoalesced, counters->framesDropped);
+
+    if (scheduler->frameCells) free(scheduler->frameCells);
+    if (scheduler->frameText) free(scheduler->frameText);
+    free(scheduler);
+    brl->outputScheduler = NULL;
+  }
+}
+
 unsigned int
 drainBrailleOutput (BrailleDisplay *brl, int minimumDelay) {
-  int duration = brl->writeDelay + 1;
+  BrailleOutputScheduler *scheduler = brl->outputScheduler;
+  int duration;
+
+  if (scheduler) {
+    if (scheduler->framePending) {
+      long int delay = getBrailleOutputDelay(brl, scheduler);
+
+      if (delay > 0) asyncWait(delay);
+      writeDeferredFrame(brl, scheduler);
+    }
+
+    duration = getBrailleOutputDelay(brl, scheduler) + 1;
+    scheduler->writeDelay = 0;
+  } else {
+    duration = brl->writeDelay + 1;
+  }
+
   if (duration < minimumDelay) duration = minimumDelay;
   brl->writeDelay = 0;
   asyncWait(duration);
@@ -236,88 +503,6 @@ readBrailleCommand (BrailleDisplay *brl, KeyTableCommandContext context) {
   }
 }
 
-int
-cellsHaveChanged (
-  unsigned char *cells, const unsigned char *new, unsigned int count,
-  unsigned int *from, unsigned int *to, int *force
-) {
-  unsigned int first = 0;
-
-  if (force && *force) {
-    *force = 0;
-  } else if (memcmp(cells, new, count) != 0) {
-    if (to) {
-      while (count) {
-        unsigned int last = count - 1;
-        if (cells[last] != new[last]) break;
-        count = last;
-      }
-    }
-
-    if (from) {
-      while (first < count) {
-        if (cells[first] != new[first]) break;
-        first += 1;
-      }
-    }
-  } else {
-    return 0;
-  }
-
-  if (from) *from = first;
-  if (to) *to = count;
-
-  memcpy(cells+first, new+first, count-first);
-  return 1;
-}
-
-int
-textHasChanged (
-  wchar_t *text, const wchar_t *new, unsigned int count,
-  unsigned int *from, unsigned int *to, int *force
-) {
-  unsigned int first = 0;
-
-  if (force && *force) {
-    *force = 0;
-  } else if (wmemcmp(text, new, count) != 0) {
-    if (to) {
-      while (count) {
-        unsigned int last = count - 1;
-        if (text[last] != new[last]) break;
-        count = last;
-      }
-    }
-
-    if (from) {
-      while (first < count) {
-        if (text[first] != new[first]) break;
-        first += 1;
-      }
-    }
-  } else {
-    return 0;
-  }
-
-  if (from) *from = first;
-  if (to) *to = count;
-
-  wmemcpy(text+first, new+first, count-first);
-  return 1;
-}
-
-int
-cursorHasChanged (int *cursor, int new, int *force) {
-  if (force && *force) {
-    *force = 0;
-  } else if (new == *cursor) {
-    return 0;
-  }
-
-  *cursor = new;
-  return 1;
-}
-
 void
 makeTranslationTable (const DotsTable dots, TranslationTable table) {
   int byte;
@@ -31,6 +31,7 @@ extern "C" {
 #endif /* __cplusplus */
 
 typedef struct BrailleDataStruct BrailleData;
+typedef struct BrailleOutputSchedulerStruct BrailleOutputScheduler;
 
 typedef struct BrailleDisplayStruct BrailleDisplay;
 typedef int BrailleFirmnessSetter (BrailleDisplay *brl, BrailleFirmness setting);
@@ -51,6 +52,8 @@ struct BrailleDisplayStruct {
   unsigned resizeRequired:1;
   unsigned noDisplay:1;
   unsigned int writeDelay;
+  BrailleOutputScheduler *outputScheduler;
+  void (*outputFailed) (void);
   void (*bufferResized) (unsigned int rows, unsigned int columns);
   unsigned touchEnabled:1;
   unsigned highlightWindow:1;
@@ -63,6 +66,18 @@ struct BrailleDisplayStruct {
 
 extern void initializeBrailleDisplay (BrailleDisplay *brl);
 extern unsigned int drainBrailleOutput (BrailleDisplay *brl, int minimumDelay);
+
+typedef struct {
+  unsigned long int framesWritten;
+  unsigned long int framesDeferred;
+  unsigned long int framesCoalesced;
+  unsigned long int framesDropped;
+} BrailleOutputCounters;
+
+extern int writeBrailleWindow (BrailleDisplay *brl, const wchar_t *text);
+extern int isBrailleOutputBusy (BrailleDisplay *brl);
+extern void getBrailleOutputCounters (BrailleDisplay *brl, BrailleOutputCounters *counters);
+extern void stopBrailleOutput (BrailleDisplay *brl);
 extern int ensureBrailleBuffer (BrailleDisplay *brl, int infoLevel);
 
 extern void fillTextRegion (
@@ -176,6 +191,16 @@ extern int textHasChanged (
   unsigned int *from, unsigned int *to, int *force
 );
 
+typedef struct {
+  unsigned int from;
+  unsigned int to;
+} ChangedRange;
+
+extern unsigned int cellRangesHaveChanged (
+  unsigned char *cells, const unsigned char *new, unsigned int count,
+  ChangedRange *ranges, unsigned int limit, unsigned int gap, int *force
+);
+
 extern int cursorHasChanged (int *cursor, int new, int *force);
 
 #define TRANSLATION_TABLE_SIZE 0X100
@@ -0,0 +1,192 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+
+#include "brl.h"
+
+typedef unsigned long int ChangeWord;
+
+static size_t
+findFirstChange (
+  const unsigned char *old, const unsigned char *new,
+  size_t from, size_t to
+) {
+  while ((to - from) >= sizeof(ChangeWord)) {
+    ChangeWord oldWord, newWord;
+
+    memcpy(&oldWord, &old[from], sizeof(oldWord));
+    memcpy(&newWord, &new[from], sizeof(newWord));
+    if (oldWord != newWord) break;
+    from += sizeof(ChangeWord);
+  }
+
+  while (from < to) {
+    if (old[from] != new[from]) break;
+    from += 1;
+  }
+
+  return from;
+}
+
+static size_t
+findLastChange (
+  const unsigned char *old, const unsigned char *new,
+  size_t from, size_t to
+) {
+  while ((to - from) >= sizeof(ChangeWord)) {
+    ChangeWord oldWord, newWord;
+    size_t offset = to - sizeof(ChangeWord);
+
+    memcpy(&oldWord, &old[offset], sizeof(oldWord));
+    memcpy(&newWord, &new[offset], sizeof(newWord));
+    if (oldWord != newWord) break;
+    to = offset;
+  }
+
+  while (to > from) {
+    size_t offset = to - 1;
+    if (old[offset] != new[offset]) break;
+    to = offset;
+  }
+
+  return to;
+}
+
+int
+cellsHaveChanged (
+  unsigned char *cells, const unsigned char *new, unsigned int count,
+  unsigned int *from, unsigned int *to, int *force
+) {
+  unsigned int first = 0;
+
+  if (force && *force) {
+    *force = 0;
+  } else {
+    if ((first = findFirstChange(cells, new, 0, count)) == count) return 0;
+    if (to) count = findLastChange(cells, new, first, count);
+  }
+
+  if (from) *from = first;
+  if (to) *to = count;
+
+  memcpy(cells+first, new+first, count-first);
+  return 1;
+}
+
+int
+textHasChanged (
+  wchar_t *text, const wchar_t *new, unsigned int count,
+  unsigned int *from, unsigned int *to, int *force
+) {
+  unsigned int first = 0;
+
+  if (force && *force) {
+    *force = 0;
+  } else {
+    const unsigned char *oldBytes = (const unsigned char *)text;
+    const unsigned char *newBytes = (const unsigned char *)new;
+    size_t size = count * sizeof(*text);
+    size_t offset;
+
+    if ((offset = findFirstChange(oldBytes, newBytes, 0, size)) == size) return 0;
+    first = offset / sizeof(*text);
+
+    if (to) {
+      offset = findLastChange(oldBytes, newBytes, first*sizeof(*text), size);
+      count = (offset + sizeof(*text) - 1) / sizeof(*text);
+    }
+  }
+
+  if (from) *from = first;
+  if (to) *to = count;
+
+  wmemcpy(text+first, new+first, count-first);
+  return 1;
+}
+
+unsigned int
+cellRangesHaveChanged (
+  unsigned char *cells, const unsigned char *new, unsigned int count,
+  ChangedRange *ranges, unsigned int limit, unsigned int gap, int *force
+) {
+  unsigned int rangeCount = 0;
+  unsigned int from;
+  unsigned int end;
+
+  if (!limit) return 0;
+
+  if (force && *force) {
+    /* a forced rewrite always covers the whole buffer */
+    *force = 0;
+    if (!count) return 0;
+
+    ranges->from = 0;
+    ranges->to = count;
+    memcpy(cells, new, count);
+    return 1;
+  }
+
+  if ((from = findFirstChange(cells, new, 0, count)) == count) return 0;
+  end = findLastChange(cells, new, from, count);
+
+  while (1) {
+    ChangedRange *range = &ranges[rangeCount++];
+    unsigned int to = from;
+    unsigned int next = end;
+
+    if (rangeCount == limit) {
+      to = end;
+    } else {
+      /* Changes separated by no more than gap unchanged cells are cheaper to
+       * send together than as separate updates.
+       */
+      while (1) {
+        while ((to < end) && (cells[to] != new[to])) to += 1;
+        if (to == end) break;
+
+        next = findFirstChange(cells, new, to, end);
+        if ((next - to) > gap) break;
+        to = next;
+      }
+    }
+
+    range->from = from;
+    range->to = to;
+    memcpy(&cells[from], &new[from], to-from);
+
+    if (to == end) break;
+    from = next;
+  }
+
+  return rangeCount;
+}
+
+int
+cursorHasChanged (int *cursor, int new, int *force) {
+  if (force && *force) {
+    *force = 0;
+  } else if (new == *cursor) {
+    return 0;
+  }
+
+  *cursor = new;
+  return 1;
+}
@@ -22,73 +22,329 @@
 /* For a description of what each function does, see rangelist.h */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "brlapi_keyranges.h"
 #include "log.h"
 
-static int inKeyrange(KeyrangeList *l, KeyrangeElem e)
+/* Function : inFlagSet */
+static int inFlagSet(const KeyrangeFlagSet *f, uint32_t flags)
 {
-  uint32_t flags = KeyrangeFlags(e);
-  uint32_t val = KeyrangeVal(e);
-  return (l->minVal <= val && val <= l->maxVal && (flags | l->minFlags) == flags && ((flags & ~l->maxFlags) == 0));
+  return ((flags | f->minFlags) == flags) && ((flags & ~f->maxFlags) == 0);
 }
 
-/* Function : createKeyrange */
-static KeyrangeList **createKeyrange(KeyrangeList **p, uint32_t minFlags, uint32_t minVal, uint32_t maxFlags, uint32_t maxVal, KeyrangeList *n)
+/* Function : containsFlagSet */
+/* Determines if every flags value of b is also in a */
+static int containsFlagSet(const KeyrangeFlagSet *a, const KeyrangeFlagSet *b)
 {
-  KeyrangeList *c = malloc(sizeof(KeyrangeList));
-  if (c==NULL) return NULL;
-  c->minFlags = minFlags; c->minVal = minVal;
-  c->maxFlags = maxFlags; c->maxVal = maxVal;
-  c->next = n;
-  *p = c;
-  return &c->next;
+  return ((a->minFlags & ~b->minFlags) == 0) && ((b->maxFlags & ~a->maxFlags) == 0);
 }
 
-/* Function : freeKeyrange */
-static void freeKeyrange(KeyrangeList **p, KeyrangeList *c)
+/* Function : intersectsFlagSet */
+static int intersectsFlagSet(const KeyrangeFlagSet *a, const KeyrangeFlagSet *b)
 {
-  if (c==NULL) return;
-  *p = c->next;
-  free(c);
+  return ((a->minFlags & ~b->maxFlags) == 0) && ((b->minFlags & ~a->maxFlags) == 0);
+}
+
+/* Function : compareFlagSets */
+/* Flag sets are kept sorted within a segment so that segments compare easily */
+static int compareFlagSets(const KeyrangeFlagSet *a, const KeyrangeFlagSet *b)
+{
+  if (a->minFlags != b->minFlags) return (a->minFlags < b->minFlags)? -1: 1;
+  if (a->maxFlags != b->maxFlags) return (a->maxFlags < b->maxFlags)? -1: 1;
+  return 0;
+}
+
+/* Function : insertFlagSet */
+/* Adds f to s, unless it's already covered */
+/* Sets which f covers are dropped */
+static int insertFlagSet(KeyrangeSegment *s, const KeyrangeFlagSet *f)
+{
+  KeyrangeFlagSet *flags;
+  unsigned int from, to;
+
+  for (from=0; from<s->flagsCount; from++)
+    if (containsFlagSet(&s->flags[from], f)) return 0;
+
+  for (from=to=0; from<s->flagsCount; from++)
+    if (!containsFlagSet(f, &s->flags[from])) s->flags[to++] = s->flags[from];
+  s->flagsCount = to;
+
+  if (!(flags = realloc(s->flags, (to+1) * sizeof(*flags)))) {
+    logMallocError();
+    return -1;
+  }
+  s->flags = flags;
+
+  while (to > 0 && compareFlagSets(&flags[to-1], f) > 0) {
+    flags[to] = flags[to-1];
+    to--;
+  }
+  flags[to] = *f;
+  s->flagsCount++;
+  return 0;
+}
+
+/* Function : subtractFlagSet */
+/* Removes the flags values of d from s */
+static int subtractFlagSet(KeyrangeSegment *s, const KeyrangeFlagSet *d)
+{
+  KeyrangeFlagSet *flags = NULL;
+  unsigned int count = 0;
+  unsigned int index;
+
+  for (index=0; index<s->flagsCount; index++) {
+    KeyrangeFlagSet c = s->flags[index];
+    KeyrangeFlagSet kept[32];
+    unsigned int keptCount = 0;
+    int i;
+
+    if (!intersectsFlagSet(&c, d)) {
+      kept[keptCount++] = c;
+    } else {
+      for (i=0; i<32; i++) {
+        uint32_t mask = UINT32_C(1) << i;
+
+        if (!(c.minFlags & mask) && (d->minFlags & mask)) {
+          /* && (c.maxFlags & mask) */
+          /* part without flag i should be kept intact, save it */
+          kept[keptCount].minFlags = c.minFlags;
+          kept[keptCount].maxFlags = c.maxFlags & ~mask;
+          keptCount++;
+          /* now handling part with flag i */
+          c.minFlags |= mask;
+        }
+
+        if ((c.maxFlags & mask) && !(d->maxFlags & mask)) {
+          /* && !(c.minFlags & mask) */
+          /* part with flag i should be kept intact, save it */
+          kept[keptCount].minFlags = c.minFlags | mask;
+          kept[keptCount].maxFlags = c.maxFlags;
+          keptCount++;
+          /* now handling part without flag i */
+          c.maxFlags &= ~mask;
+        }
+      }
+      /* the remaining part is within d, drop it */
+    }
+
+    if (keptCount) {
+      KeyrangeFlagSet *newFlags = realloc(flags, (count+keptCount) * sizeof(*newFlags));
+
+      if (!newFlags) {
+        logMallocError();
+        free(flags);
+        return -1;
+      }
+
+      flags = newFlags;
+      memcpy(&flags[count], kept, keptCount * sizeof(*flags));
+      count += keptCount;
+    }
+  }
+
+  free(s->flags);
+  s->flags = NULL;
+  s->flagsCount = 0;
+
+  for (index=0; index<count; index++) {
+    if (insertFlagSet(s, &flags[index]) == -1) {
+      free(flags);
+      return -1;
+    }
+  }
+
+  free(flags);
+  return 0;
+}
+
+/* Function : sameFlagSets */
+static int sameFlagSets(const KeyrangeSegment *a, const KeyrangeSegment *b)
+{
+  unsigned int index;
+
+  if (a->flagsCount != b->flagsCount) return 0;
+
+  for (index=0; index<a->flagsCount; index++)
+    if (compareFlagSets(&a->flags[index], &b->flags[index])) return 0;
+
+  return 1;
+}
+
+/* Function : findSegment */
+/* Returns the index of the first segment which doesn't end before val */
+static unsigned int findSegment(const KeyrangeList *l, uint32_t val)
+{
+  unsigned int first = 0;
+  unsigned int last = l->count;
+
+  while (first < last) {
+    unsigned int current = (first + last) / 2;
+
+    if (l->segments[current].maxVal < val) {
+      first = current + 1;
+    } else {
+      last = current;
+    }
+  }
+
+  return first;
+}
+
+/* Function : insertSegment */
+/* Inserts the segment [minVal..maxVal] at position index */
+/* It gets a copy of the flag sets of model, or no flag sets if model is NULL */
+static KeyrangeSegment *insertSegment(KeyrangeList *l, unsigned int index, uint32_t minVal, uint32_t maxVal, const KeyrangeSegment *model)
+{
+  KeyrangeSegment *s;
+  KeyrangeFlagSet *flags = NULL;
+  unsigned int flagsCount = model? model->flagsCount: 0;
+
+  if (flagsCount) {
+    if (!(flags = malloc(flagsCount * sizeof(*flags)))) {
+      logMallocError();
+      return NULL;
+    }
+
+    memcpy(flags, model->flags, flagsCount * sizeof(*flags));
+  }
+
+  if (l->count == l->size) {
+    unsigned int newSize = l->size? l->size<<1: 4;
+    KeyrangeSegment *newSegments = realloc(l->segments, newSize * sizeof(*newSegments));
+
+    if (!newSegments) {
+      logMallocError();
+      if (flags) free(flags);
+      return NULL;
+    }
+
+    l->segments = newSegments;
+    l->size = newSize;
+  }
+
+  memmove(&l->segments[index+1], &l->segments[index], (l->count - index) * sizeof(*l->segments));
+  l->count++;
+
+  s = &l->segments[index];
+  s->minVal = minVal;
+  s->maxVal = maxVal;
+  s->flags = flags;
+  s->flagsCount = flagsCount;
+  return s;
+}
+
+/* Function : deleteSegment */
+static void deleteSegment(KeyrangeList *l, unsigned int index)
+{
+  if (l->segments[index].flags) free(l->segments[index].flags);
+  l->count--;
+  memmove(&l->segments[index], &l->segments[index+1], (l->count - index) * sizeof(*l->segments));
+}
+
+/* Function : splitSegments */
+/* Makes sure that no segment crosses the boundary between val-1 and val */
+static int splitSegments(KeyrangeList *l, uint32_t val)
+{
+  unsigned int index = findSegment(l, val);
+
+  if (index < l->count) {
+    KeyrangeSegment *s = &l->segments[index];
+
+    if (s->minVal < val) {
+      uint32_t minVal = s->minVal;
+
+      if (!insertSegment(l, index, minVal, val-1, s)) return -1;
+      l->segments[index+1].minVal = val;
+    }
+  }
+
+  return 0;
+}
+
+/* Function : mergeSegments */
+/* Joins the adjacent segments within [first..last] which accept the same flag sets */
+static void mergeSegments(KeyrangeList *l, unsigned int first, unsigned int last)
+{
+  unsigned int index;
+
+  if (first > 0) first--;
+  if (last >= l->count) last = l->count - 1;
+  index = first;
+
+  while (index < last) {
+    KeyrangeSegment *s = &l->segments[index];
+    KeyrangeSegment *n = s + 1;
+
+    if ((s->maxVal + 1 == n->minVal) && sameFlagSets(s, n)) {
+      s->maxVal = n->maxVal;
+      deleteSegment(l, index+1);
+      last--;
+    } else {
+      index++;
+    }
+  }
+}
+
+/* Function : getRange */
+static void getRange(KeyrangeElem x0, KeyrangeElem y0, KeyrangeFlagSet *f, uint32_t *minVal, uint32_t *maxVal)
+{
+  f->minFlags = KeyrangeFlags(x0) & KeyrangeFlags(y0);
+  f->maxFlags = KeyrangeFlags(x0) | KeyrangeFlags(y0);
+  *minVal = MIN(KeyrangeVal(x0), KeyrangeVal(y0));
+  *maxVal = MAX(KeyrangeVal(x0), KeyrangeVal(y0));
 }
 
 /* Function : freeKeyrangeList */
 void freeKeyrangeList(KeyrangeList **l)
 {
-  KeyrangeList *p1, *p2;
-  if (l==NULL) return;
-  p2 = *l;
-  while (p2!=NULL) {
-    p1 = p2;
-    p2 = p1->next;
-    free(p1);
-  }
+  if (l==NULL || *l==NULL) return;
+
+  while ((*l)->count) deleteSegment(*l, (*l)->count-1);
+  if ((*l)->segments) free((*l)->segments);
+  free(*l);
   *l = NULL;
 }
 
 /* Function : inKeyrangeList */
-KeyrangeList *inKeyrangeList(KeyrangeList *l, KeyrangeElem n)
+int inKeyrangeList(const KeyrangeList *l, KeyrangeElem n)
 {
-  KeyrangeList *c = l;
-  while (c!=NULL) {
-    if (inKeyrange(c, n)) return c;
-    c = c->next;
+  uint32_t flags = KeyrangeFlags(n);
+  uint32_t val = KeyrangeVal(n);
+
+  if (l) {
+    unsigned int index = findSegment(l, val);
+
+    if (index < l->count) {
+      const KeyrangeSegment *s = &l->segments[index];
+
+      if (s->minVal <= val) {
+        unsigned int i;
+
+        for (i=0; i<s->flagsCount; i++)
+          if (inFlagSet(&s->flags[i], flags)) return 1;
+      }
+    }
   }
-  return NULL;
+
+  return 0;
 }
 
-/* Function : DisplayKeyrangeList */
-void DisplayKeyrangeList(KeyrangeList *l)
+/* Function : displayKeyrangeList */
+void displayKeyrangeList(const KeyrangeList *l)
 {
-  if (l==NULL) printf("emptyset");
+  if (l==NULL || !l->count) printf("emptyset");
   else {
-    KeyrangeList *c = l;
-    while (1) {
-      printf("[%lx(%lx)..%lx(%lx)]",(unsigned long)c->minVal,(unsigned long)c->minFlags,(unsigned long)c->maxVal,(unsigned long)c->maxFlags);
-      if (c->next==NULL) break;
-      printf(",");
-      c = c->next;
+    unsigned int index;
+
+    for (index=0; index<l->count; index++) {
+      const KeyrangeSegment *s = &l->segments[index];
+      unsigned int i;
+
+      for (i=0; i<s->flagsCount; i++) {
+        if (index || i) printf(",");
+        printf("[%lx(%lx)..%lx(%lx)]",(unsigned long)s->minVal,(unsigned long)s->flags[i].minFlags,(unsigned long)s->maxVal,(unsigned long)s->flags[i].maxFlags);
+      }
     }
   }
   printf("\n");
@@ -97,133 +353,88 @@ void DisplayKeyrangeList(KeyrangeList *l)
 /* Function : addKeyrange */
 int addKeyrange(KeyrangeElem x0, KeyrangeElem y0, KeyrangeList **l)
 {
-  KeyrangeList *c;
-  uint32_t minFlags = KeyrangeFlags(x0) & KeyrangeFlags(y0);
-  uint32_t maxFlags = KeyrangeFlags(x0) | KeyrangeFlags(y0);
-  uint32_t minVal   = MIN(KeyrangeVal(x0), KeyrangeVal(y0));
-  uint32_t maxVal   = MAX(KeyrangeVal(x0), KeyrangeVal(y0));
-  KeyrangeElem min = KeyrangeElem(minFlags, minVal);
-  KeyrangeElem max = KeyrangeElem(maxFlags, maxVal);
-
-  logMessage(LOG_DEBUG, "adding range [%"PRIx32"(%"PRIx32")..%"PRIx32"(%"PRIx32")]", minVal, minFlags, maxVal, maxFlags);
-
-  c = *l;
-  while (c) {
-    if (inKeyrange(c, min) && inKeyrange(c, max))
-      /* Falls completely within an existing range */
-      return 0;
-
-    if (c->minVal <= maxVal && maxVal <= c->maxVal && minFlags == c->minFlags && maxFlags == c->maxFlags) {
-      /* May just change lower bound */
-      /* Note that minVal can't be >= c->minVal */
-      c->minVal = minVal;
-      return 0;
+  KeyrangeFlagSet f;
+  uint32_t minVal, maxVal, val;
+  unsigned int first, index;
+
+  getRange(x0, y0, &f, &minVal, &maxVal);
+  logMessage(LOG_DEBUG, "adding range [%"PRIx32"(%"PRIx32")..%"PRIx32"(%"PRIx32")]", minVal, f.minFlags, maxVal, f.maxFlags);
+
+  if (*l == NULL) {
+    if (!(*l = malloc(sizeof(**l)))) {
+      logMallocError();
+      return -1;
     }
 
-    if (c->minVal <= minVal && minVal <= c->maxVal && minFlags == c->minFlags && maxFlags == c->maxFlags) {
-      /* May just change upper bound */
-      /* Note that maxVal can't be <= c->maxVal */
-      c->maxVal = maxVal;
-      return 0;
+    (*l)->segments = NULL;
+    (*l)->count = (*l)->size = 0;
+  }
+
+  if (splitSegments(*l, minVal) == -1) return -1;
+  if (maxVal < UINT32_MAX)
+    if (splitSegments(*l, maxVal+1) == -1) return -1;
+
+  /* Add the flag set to the segments within the range, filling the gaps */
+  first = index = findSegment(*l, minVal);
+  val = minVal;
+
+  while (1) {
+    KeyrangeSegment *s;
+
+    if ((index < (*l)->count) && ((*l)->segments[index].minVal <= maxVal)) {
+      if ((*l)->segments[index].minVal > val) {
+        if (!insertSegment(*l, index, val, (*l)->segments[index].minVal-1, NULL)) return -1;
+        if (insertFlagSet(&(*l)->segments[index], &f) == -1) return -1;
+        index++;
+      }
+
+      s = &(*l)->segments[index];
+      if (insertFlagSet(s, &f) == -1) return -1;
+    } else {
+      if (!(s = insertSegment(*l, index, val, maxVal, NULL))) return -1;
+      if (insertFlagSet(s, &f) == -1) return -1;
     }
 
-    c = c->next;
+    if (s->maxVal == maxVal) break;
+    val = s->maxVal + 1;
+    index++;
   }
 
-  /* Else things are not easy, just add */
-  if ((createKeyrange(l,minFlags,minVal,maxFlags,maxVal,*l)) == NULL) return -1;
+  mergeSegments(*l, first, index+1);
   return 0;
 }
 
+/* Function : removeKeyrange */
 int removeKeyrange(KeyrangeElem x0, KeyrangeElem y0, KeyrangeList **l)
 {
-  uint32_t minFlags = KeyrangeFlags(x0) & KeyrangeFlags(y0);
-  uint32_t maxFlags = KeyrangeFlags(x0) | KeyrangeFlags(y0);
-  uint32_t minVal   = MIN(KeyrangeVal(x0), KeyrangeVal(y0));
-  uint32_t maxVal   = MAX(KeyrangeVal(x0), KeyrangeVal(y0));
-  KeyrangeList *c, **p, *tmp;
-  int i;
+  KeyrangeFlagSet f;
+  uint32_t minVal, maxVal;
+  unsigned int first, index;
 
   if ((l==NULL) || (*l==NULL)) return 0;
 
-  logMessage(LOG_DEBUG, "removing range [%"PRIx32"(%"PRIx32")..%"PRIx32"(%"PRIx32")]", minVal, minFlags, maxVal, maxFlags);
-
-  /* Need to intersect with every range */
-  p = l; c = *p;
-  while (c) {
-    if (c->minVal > maxVal || c->maxVal < minVal ||
-        !(c->maxFlags | ~minFlags) || !(~c->minFlags | maxFlags)) {
-      /* don't intersect */
-      p = &c->next;
-      c = *p;
-      continue;
-    }
+  getRange(x0, y0, &f, &minVal, &maxVal);
+  logMessage(LOG_DEBUG, "removing range [%"PRIx32"(%"PRIx32")..%"PRIx32"(%"PRIx32")]", minVal, f.minFlags, maxVal, f.maxFlags);
 
-    if (minVal <= c->minVal && maxVal >= c->maxVal &&
-        (c->minFlags | minFlags) == c->minFlags &&
-        (c->maxFlags & ~maxFlags) == 0) {
-      /* range falls completely in deletion range, just drop it */
-      tmp = c; c = c->next;
-      freeKeyrange(p,tmp);
-      continue;
-    }
+  if (splitSegments(*l, minVal) == -1) return -1;
+  if (maxVal < UINT32_MAX)
+    if (splitSegments(*l, maxVal+1) == -1) return -1;
 
-    /* Partly intersect */
+  /* Take the flag set out of every segment within the range */
+  first = index = findSegment(*l, minVal);
 
-    if (c->minVal < minVal) {
-      /* lower part should be kept intact, save it. */
-      p = createKeyrange(p, c->minFlags, c->minVal, c->maxFlags, minVal - 1, c);
-      if (p == NULL) return -1;
-      c->minVal = minVal;
-    }
-
-    if (c->maxVal > maxVal) {
-      /* upper part should be kept intact, save it. */
-      p = createKeyrange(p, c->minFlags, maxVal + 1, c->maxFlags, c->maxVal, c);
-      if (p == NULL) return -1;
-      c->maxVal = maxVal;
-    }
+  while ((index < (*l)->count) && ((*l)->segments[index].minVal <= maxVal)) {
+    KeyrangeSegment *s = &(*l)->segments[index];
 
-    /* Now values are the same, tinker with flags */
-    for (i=0; i<32; i++) {
-      uint32_t mask = 1<<i;
-
-      if ((!(c->maxFlags & mask) &&  (minFlags & mask)) ||
-          ( (c->minFlags & mask) && !(maxFlags & mask)))
-	/* don't intersect on this flag */
-	continue;
-
-      if (!(c->minFlags & mask) &&  (minFlags & mask)) {
-        /* && (c->maxFlags & mask) */
-	/* part without flag i should be kept intact, save it */
-        p = createKeyrange(p, c->minFlags, c->minVal, c->maxFlags & ~mask, c->maxVal, c);
-        if (p == NULL) return -1;
-	/* now handling part with flag i */
-        c->minFlags |= mask;
-      }
+    if (subtractFlagSet(s, &f) == -1) return -1;
 
-      if ( (c->maxFlags & mask) && !(maxFlags & mask)) {
-        /* && !(c->minFlags & mask) */
-	/* part with flag i should be kept intact, save it */
-        p = createKeyrange(p, c->minFlags | mask, c->minVal, c->maxFlags, c->maxVal, c);
-        if (p == NULL) return -1;
-	/* now handling part without flag i */
-        c->maxFlags &= ~mask;
-      }
-
-      if (!(c->maxFlags | ~minFlags) || !(~c->minFlags | maxFlags))
-        /* don't intersect any more*/
-	break;
-    }
-    if (i<32) {
-      /* don't intersect any more, keep it */
-      break;
+    if (s->flagsCount) {
+      index++;
     } else {
-      /* remaining intersection, drop it */
-      tmp = c; c = c->next;
-      freeKeyrange(p,tmp);
+      deleteSegment(*l, index);
     }
   }
 
+  if ((*l)->count) mergeSegments(*l, first, index);
   return 0;
 }
@@ -35,37 +35,49 @@ typedef uint64_t KeyrangeElem;
 #define KeyrangeElem(flags,val) (((KeyrangeElem)(flags) << 32) | (val))
 	
 
-typedef struct KeyrangeList {
+/* The accepted keys are kept as a sorted array of disjoint value segments. */
+/* Each segment holds the flag sets which are accepted for all of its values; */
+/* a flag set [minFlags..maxFlags] holds every flags value which has at least */
+/* the bits of minFlags and at most the bits of maxFlags. */
+
+typedef struct {
   uint32_t minFlags, maxFlags;
+} KeyrangeFlagSet;
+
+typedef struct {
   uint32_t minVal, maxVal;
-  struct KeyrangeList *next;
+  KeyrangeFlagSet *flags;
+  unsigned int flagsCount;
+} KeyrangeSegment;
+
+typedef struct KeyrangeList {
+  KeyrangeSegment *segments;
+  unsigned int count, size;
 } KeyrangeList;
 
 /* Function : freeKeyrangeList */
-/* Frees a whole list */
-/* If you want to destroy a whole list, call this function, rather than */
-/* calling freeKeyrange on each element, since th latter cares about links */
-/* and hence is slower */
+/* Frees a whole list, and sets *l to NULL */
 extern void freeKeyrangeList(KeyrangeList **l);
 
 /* Function : inKeyrangeList */
 /* Determines if the range list l contains x */
-/* If yes, returns the adress of the cell [a..b] such that a<=x<=b */
-/* If no, returns NULL */
-extern KeyrangeList *inKeyrangeList(KeyrangeList *l, KeyrangeElem n);
+/* Returns 1 if it does, 0 if it doesn't */
+/* The segment holding x is found by binary search */
+extern int inKeyrangeList(const KeyrangeList *l, KeyrangeElem n);
 
 /* Function : displayKeyrangeList */
 /* Prints a range list on stdout */
 /* This is for debugging only */
-extern void displayKeyrangeList(KeyrangeList *l);
+extern void displayKeyrangeList(const KeyrangeList *l);
 
 /* Function : addKeyrange */
-/* Adds a range to a range list */
+/* Adds a range to a range list, merging it with the ranges already there */
+/* The list is allocated if *l is NULL */
 /* Return 0 if success, -1 if an error occurs */
 extern int addKeyrange(KeyrangeElem x0, KeyrangeElem y0, KeyrangeList **l);
 
 /* Function : removeKeyrange */
-/* Removes a range from a range list */
+/* Removes a range from a range list, splitting the ranges which overlap it */
 /* Returns 0 if success, -1 if failure */
 extern int removeKeyrange(KeyrangeElem x0, KeyrangeElem y0, KeyrangeList **l);
 
@@ -597,10 +597,9 @@ void copyBrailleWindow(BrailleWindow *dest, const BrailleWindow *src)
 void getDots(const BrailleWindow *brailleWindow, unsigned char *buf)
 {
   int i;
-  unsigned char c;
+  convertCharactersToDots(textTable, brailleWindow->text, displaySize, buf);
   for (i=0; i<displaySize; i++) {
-    c = convertCharacterToDots(textTable, brailleWindow->text[i]);
-    buf[i] = (c & brailleWindow->andAttr[i]) | brailleWindow->orAttr[i];
+    buf[i] = (buf[i] & brailleWindow->andAttr[i]) | brailleWindow->orAttr[i];
   }
   if (brailleWindow->cursor) buf[brailleWindow->cursor-1] |= cursorShape;
 }
@@ -2497,7 +2496,7 @@ static Connection *whoGetsKey(Tty *tty, brlapi_keyCode_t code, unsigned int how)
   int passKey;
   for (c=tty->connections->next; c!=tty->connections; c = c->next) {
     pthread_mutex_lock(&c->acceptedKeysMutex);
-    passKey = (c->how==how) && (inKeyrangeList(c->acceptedKeys,code) != NULL);
+    passKey = (c->how==how) && inKeyrangeList(c->acceptedKeys,code);
     pthread_mutex_unlock(&c->acceptedKeysMutex);
     if (passKey) goto found;
   }
@@ -2518,7 +2517,7 @@ static void broadcastKey(Tty *tty, brlapi_keyCode_t code, unsigned int how) {
   Tty *t;
   for (c=tty->connections->next; c!=tty->connections; c = c->next) {
     pthread_mutex_lock(&c->acceptedKeysMutex);
-    if ((c->how==how) && (inKeyrangeList(c->acceptedKeys,code) != NULL))
+    if ((c->how==how) && inKeyrangeList(c->acceptedKeys,code))
       writeKey(c->fd,code);
     pthread_mutex_unlock(&c->acceptedKeysMutex);
   }
@@ -2639,7 +2638,6 @@ out:
 int api_flush(BrailleDisplay *brl) {
   Connection *c;
   int ok = 1;
-  int drain = 0;
   unsigned char newCursorShape;
 
   pthread_mutex_lock(&connectionsMutex);
@@ -2665,13 +2663,14 @@ int api_flush(BrailleDisplay *brl) {
     if (newCursorShape!=cursorShape) {
       cursorShape = newCursorShape;
     }
-    if (c->brlbufstate==TODISPLAY) {
+    /* While the link is still busy, leave the client's window where it is:
+     * later writes replace it, and only the latest one gets sent. */
+    if ((c->brlbufstate==TODISPLAY) && !isBrailleOutputBusy(brl)) {
       unsigned char *oldbuf = disp->buffer, buf[displaySize];
       disp->buffer = buf;
       getDots(&c->brailleWindow, buf);
       brl->cursor = c->brailleWindow.cursor-1;
       ok = trueBraille->writeWindow(brl, c->brailleWindow.text);
-      drain = 1;
       disp->buffer = oldbuf;
     }
     pthread_mutex_unlock(&driverMutex);
@@ -2701,8 +2700,6 @@ int api_flush(BrailleDisplay *brl) {
     pthread_mutex_unlock(&rawMutex);
     goto out;
   }
-  if (drain)
-    drainBrailleOutput(brl, 0);
   pthread_mutex_unlock(&rawMutex);
 out:
   pthread_mutex_unlock(&connectionsMutex);
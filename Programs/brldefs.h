@@ -205,6 +205,8 @@ typedef enum {
   BRL_CMD_CLIP_SAVE /* save clipboard to disk */,
   BRL_CMD_CLIP_RESTORE /* restore clipboard from disk */,
 
+  BRL_CMD_UPDATE_TIMES /* show update cycle timing statistics */,
+
   BRL_driverCommandCount /* must be last */
 } BRL_DriverCommand;
 
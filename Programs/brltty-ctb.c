@@ -47,6 +47,8 @@ static char *opt_verificationTable;
 static int opt_reformatText;
 static char *opt_outputWidth;
 static int opt_forceOutput;
+static int opt_ruleChains;
+static int opt_compareLookups;
 
 BEGIN_OPTION_TABLE(programOptions)
   { .letter = 'T',
@@ -99,6 +101,20 @@ BEGIN_OPTION_TABLE(programOptions)
     .setting.flag = &opt_forceOutput,
     .description = "Force immediate output."
   },
+
+  { .letter = 'R',
+    .word = "rule-chains",
+    .flags = OPT_Hidden,
+    .setting.flag = &opt_ruleChains,
+    .description = "Look up multi-character rules via their hash chains rather than the trie."
+  },
+
+  { .letter = 'L',
+    .word = "compare-lookups",
+    .flags = OPT_Hidden,
+    .setting.flag = &opt_compareLookups,
+    .description = "Check that both rule lookups contract the input identically."
+  },
 END_OPTION_TABLE
 
 static wchar_t *inputBuffer;
@@ -359,6 +375,57 @@ outputError:
   return 0;
 }
 
+static int
+compareRuleLookups (const wchar_t *characters, size_t length, void *data) {
+  LineProcessingData *lpd = data;
+
+  /* an external table has no rules of its own */
+  if (isContractionTableExternal(contractionTable)) return 1;
+
+  if (length) {
+    int outputSize = length << 3;
+    unsigned char outputBuffers[2][outputSize];
+    int offsets[2][length];
+    int inputCounts[2];
+    int outputCounts[2];
+    int ruleChains;
+
+    for (ruleChains=0; ruleChains<2; ruleChains+=1) {
+      inputCounts[ruleChains] = length;
+      outputCounts[ruleChains] = outputSize;
+
+      setContractionRuleChains(contractionTable, ruleChains);
+      contractText(contractionTable,
+                   characters, &inputCounts[ruleChains],
+                   outputBuffers[ruleChains], &outputCounts[ruleChains],
+                   offsets[ruleChains], CTB_NO_CURSOR);
+    }
+
+    if ((inputCounts[0] != inputCounts[1]) ||
+        (outputCounts[0] != outputCounts[1]) ||
+        (memcmp(outputBuffers[0], outputBuffers[1], outputCounts[0]) != 0) ||
+        (memcmp(offsets[0], offsets[1], ARRAY_SIZE(offsets[0], inputCounts[0])) != 0)) {
+      char *trie;
+
+      if ((trie = makeUtf8FromCells(outputBuffers[0], outputCounts[0]))) {
+        char *chains;
+
+        if ((chains = makeUtf8FromCells(outputBuffers[1], outputCounts[1]))) {
+          logMessage(LOG_ERR, "rule lookups differ: %.*" PRIws ": trie %s, chains %s",
+                     (int)length, characters, trie, chains);
+          free(chains);
+        }
+
+        free(trie);
+      }
+
+      lpd->exitStatus = PROG_EXIT_SEMANTIC;
+    }
+  }
+
+  return 1;
+}
+
 static int
 processContractsOperands (DataFile *file, void *data) {
   DataString text;
@@ -521,6 +588,9 @@ main (int argc, char *argv[]) {
           exitStatus = PROG_EXIT_SUCCESS;
         }
 
+        if (opt_ruleChains) setContractionRuleChains(contractionTable, 1);
+        if (opt_compareLookups) processInputCharacters = compareRuleLookups;
+
         if (exitStatus == PROG_EXIT_SUCCESS) {
           if (opt_verificationTable && *opt_verificationTable) {
             if ((verificationTablePath = makeFilePath(opt_tablesDirectory, opt_verificationTable, VERIFICATION_TABLE_EXTENSION))) {
@@ -26,6 +26,7 @@
 #include "options.h"
 #include "log.h"
 #include "file.h"
+#include "timing.h"
 #include "unicode.h"
 #include "charset.h"
 #include "brldots.h"
@@ -35,6 +36,7 @@ static char *opt_tablesDirectory;
 static char *opt_inputTable;
 static char *opt_outputTable;
 static int opt_sixDots;
+static int opt_timeTranslation;
 
 static const char tableName_autoselect[] = "auto";
 static const char tableName_unicode[] = "unicode";
@@ -73,6 +75,13 @@ BEGIN_OPTION_TABLE(programOptions)
     .setting.flag = &opt_sixDots,
     .description = strtext("Remove dots seven and eight.")
   },
+
+  { .letter = 't',
+    .word = "time",
+    .flags = OPT_Config | OPT_Environ,
+    .setting.flag = &opt_timeTranslation,
+    .description = strtext("Time translating the input to dots a character at a time and a row at a time.")
+  },
 END_OPTION_TABLE
 
 static TextTable *inputTable;
@@ -106,6 +115,106 @@ toCharacter_unicode (unsigned char dots) {
   return UNICODE_BRAILLE_ROW | dots;
 }
 
+#define TIMING_ROW_LENGTH 80
+#define TIMING_REPETITIONS 200
+
+static wchar_t *timingCharacters = NULL;
+static size_t timingSize = 0;
+static size_t timingCount = 0;
+
+static int
+addTimingCharacter (wchar_t character) {
+  if (timingCount == timingSize) {
+    size_t newSize = timingSize? timingSize<<1: 0X1000;
+    wchar_t *newCharacters = realloc(timingCharacters, ARRAY_SIZE(newCharacters, newSize));
+
+    if (!newCharacters) {
+      logMallocError();
+      return 0;
+    }
+
+    timingCharacters = newCharacters;
+    timingSize = newSize;
+  }
+
+  timingCharacters[timingCount++] = character;
+  return 1;
+}
+
+static unsigned long int
+timeTranslation (int batched, unsigned char *dots) {
+  TimeValue start;
+  TimeValue end;
+  unsigned int repetition;
+
+  getMonotonicTime(&start);
+
+  for (repetition=0; repetition<TIMING_REPETITIONS; repetition+=1) {
+    size_t offset = 0;
+
+    while (offset < timingCount) {
+      size_t count = MIN(TIMING_ROW_LENGTH, (timingCount - offset));
+
+      if (batched) {
+        convertCharactersToDots(inputTable, &timingCharacters[offset], count, &dots[offset]);
+      } else {
+        size_t index;
+
+        for (index=offset; index<(offset+count); index+=1) {
+          dots[index] = convertCharacterToDots(inputTable, timingCharacters[index]);
+        }
+      }
+
+      offset += count;
+    }
+  }
+
+  getMonotonicTime(&end);
+  return (((end.seconds - start.seconds) * NSECS_PER_SEC) + (end.nanoseconds - start.nanoseconds))
+       / ((unsigned long int)timingCount * (TIMING_REPETITIONS / 100));
+}
+
+static int
+reportTranslationTimes (void) {
+  if (!inputTable) {
+    logMessage(LOG_ERR, "an input text table is needed for timing");
+    return 0;
+  }
+
+  if (timingCount) {
+    unsigned char *single;
+    int ok = 0;
+
+    if ((single = malloc(timingCount))) {
+      unsigned char *batched;
+
+      if ((batched = malloc(timingCount))) {
+        unsigned long int singleTime = timeTranslation(0, single);
+        unsigned long int batchedTime = timeTranslation(1, batched);
+        int same = memcmp(single, batched, timingCount) == 0;
+
+        printf("%lu characters in %u-character rows: single %lu.%02luns, batched %lu.%02luns per character%s\n",
+               (unsigned long int)timingCount, TIMING_ROW_LENGTH,
+               singleTime/100, singleTime%100, batchedTime/100, batchedTime%100,
+               (same? "": ", dots differ"));
+
+        ok = same;
+        free(batched);
+      } else {
+        logMallocError();
+      }
+
+      free(single);
+    } else {
+      logMallocError();
+    }
+
+    return ok;
+  }
+
+  return 1;
+}
+
 static int
 writeCharacter (const wchar_t *character, mbstate_t *state) {
   char bytes[0X1000];
@@ -150,6 +259,14 @@ processStream (FILE *inputStream, const char *inputName) {
           inputCount -= result;
         }
 
+        if (opt_timeTranslation) {
+          if (!iswcntrl(character))
+            if (!addTimingCharacter(character))
+              return 0;
+
+          continue;
+        }
+
         if (!iswcntrl(character)) {
           unsigned char dots = toDots(character);
           if (opt_sixDots) dots &= ~(BRL_DOT7 | BRL_DOT8);
@@ -240,6 +357,7 @@ main (int argc, char *argv[]) {
       outputStream = stdout;
       outputName = standardOutputName;
 
+      if (inputTable) cacheTextTable(inputTable);
       toDots = inputTable? toDots_mapped: toDots_unicode;
       toCharacter = outputTable? toCharacter_mapped: toCharacter_unicode;
 
@@ -268,11 +386,16 @@ main (int argc, char *argv[]) {
         exitStatus = PROG_EXIT_SUCCESS;
       }
 
+      if (opt_timeTranslation && (exitStatus == PROG_EXIT_SUCCESS)) {
+        if (!reportTranslationTimes()) exitStatus = PROG_EXIT_SEMANTIC;
+      }
+
       if (outputTable) destroyTextTable(outputTable);
     }
 
     if (inputTable) destroyTextTable(inputTable);
   }
 
+  if (timingCharacters) free(timingCharacters);
   return exitStatus;
 }
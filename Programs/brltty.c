@@ -49,6 +49,7 @@
 #include "atb.h"
 #include "ctb.h"
 #include "routing.h"
+#include "update_timing.h"
 #include "touch.h"
 #include "charset.h"
 #include "unicode.h"
@@ -63,6 +64,7 @@
 
 #ifdef ENABLE_SPEECH_SUPPORT
 #include "spk.h"
+#include "spk_queue.h"
 #endif /* ENABLE_SPEECH_SUPPORT */
 
 int updateInterval = DEFAULT_UPDATE_INTERVAL;
@@ -285,7 +287,7 @@ writeBrailleCharacters (const char *mode, const wchar_t *characters, size_t leng
 
   fillStatusSeparator(textBuffer, brl.buffer);
 
-  return braille->writeWindow(&brl, textBuffer);
+  return writeBrailleWindow(&brl, textBuffer);
 }
 
 int
@@ -898,8 +900,7 @@ sayWideCharacters (const wchar_t *characters, const unsigned char *attributes, s
   void *text = makeUtf8FromWchars(characters, count, &length);
 
   if (text) {
-    if (immediate) speech->mute(&spk);
-    speech->say(&spk, text, length, count, attributes);
+    sayUtf8Characters(&spk, text, attributes, length, count, immediate);
     free(text);
   } else {
     logMallocError();
@@ -935,7 +936,7 @@ speakCharacters (const ScreenCharacter *characters, size_t count, int spell) {
     switch (prefs.whitespaceIndicator) {
       default:
       case wsNone:
-        if (immediate) speech->mute(&spk);
+        if (immediate) muteSpeech(&spk);
         break;
 
       case wsSaySpace: {
@@ -970,7 +971,7 @@ speakCharacters (const ScreenCharacter *characters, size_t count, int spell) {
             if (pitch > SPK_PITCH_MAXIMUM) pitch = SPK_PITCH_MAXIMUM;
 
             if (pitch != prefs.speechPitch) {
-              speech->setPitch(&spk, pitch);
+              changeSpeechPitch(&spk, pitch);
               restorePitch = 1;
             }
           }
@@ -982,7 +983,7 @@ speakCharacters (const ScreenCharacter *characters, size_t count, int spell) {
       unsigned char punctuation = SPK_PUNCTUATION_ALL;
 
       if (punctuation != prefs.speechPunctuation) {
-        speech->setPunctuation(&spk, punctuation);
+        changeSpeechPunctuation(&spk, punctuation);
         restorePunctuation = 1;
       }
     }
@@ -997,8 +998,8 @@ speakCharacters (const ScreenCharacter *characters, size_t count, int spell) {
       sayWideCharacters(&character, NULL, 1, immediate);
     }
 
-    if (restorePunctuation) speech->setPunctuation(&spk, prefs.speechPunctuation);
-    if (restorePitch) speech->setPitch(&spk, prefs.speechPitch);
+    if (restorePunctuation) changeSpeechPunctuation(&spk, prefs.speechPunctuation);
+    if (restorePitch) changeSpeechPitch(&spk, prefs.speechPitch);
   } else if (spell) {
     wchar_t string[count * 2];
     size_t length = 0;
@@ -1033,10 +1034,18 @@ getUncontractedCursorOffset (int x, int y) {
   return ((y == ses->winy) && (x >= ses->winx) && (x < scr.cols))? (x - ses->winx): -1;
 }
 
+static int
+getContractedCursorOffset (int row) {
+  if ((row == scr.posy) && (scr.posx >= ses->winx) && (scr.posx < scr.cols) && !ses->hideCursor) {
+    return scr.posx - ses->winx;
+  }
+
+  return CTB_NO_CURSOR;
+}
+
 static int
 getContractedCursor (void) {
-  int offset = getUncontractedCursorOffset(scr.posx, scr.posy);
-  return ((offset >= 0) && !ses->hideCursor)? offset: CTB_NO_CURSOR;
+  return getContractedCursorOffset(ses->winy);
 }
 
 int
@@ -1054,6 +1063,7 @@ getContractedLength (unsigned int outputLimit) {
                NULL, getContractedCursor());
   return inputLength;
 }
+
 #endif /* ENABLE_CONTRACTED_BRAILLE */
 
 BlinkingState cursorBlinkingState = {
@@ -1180,6 +1190,196 @@ overlayAttributesUnderline (unsigned char *cell, unsigned char attributes) {
   *cell |= dots;
 }
 
+typedef struct {
+  int screen;
+  int left;
+  int top;
+  int width;
+  int height;
+  int length;
+  int cursor;
+  const void *textTable;
+  const void *attributesTable;
+  const void *contractionTable;
+  unsigned char displayMode;
+  unsigned char underline;
+  unsigned char capitalsHidden;
+  unsigned char sixDots;
+  unsigned char capitalizationMode;
+  unsigned char expandCurrentWord;
+} RenderedWindowKey;
+
+static struct {
+  RenderedWindowKey key;
+  unsigned int generation;
+  unsigned char *dots;
+  wchar_t *text;
+  unsigned int size;
+  int inputLength;
+  int outputLength;
+  unsigned valid:1;
+} renderedWindow;
+
+static void
+setRenderedWindowKey (RenderedWindowKey *key, int width, int length) {
+  memset(key, 0, sizeof(*key));
+  key->screen = scr.number;
+  key->left = ses->winx;
+  key->top = ses->winy;
+  key->width = width;
+  key->height = brl.textRows;
+  key->length = length;
+  key->textTable = textTable;
+  key->attributesTable = attributesTable;
+  key->displayMode = ses->displayMode;
+  key->underline = showAttributesUnderline();
+  key->capitalsHidden = !isBlinkedOn(&capitalsBlinkingState);
+  key->sixDots = !!prefs.textStyle;
+}
+
+static int
+canReuseRenderedWindow (const RenderedWindowKey *key) {
+  return renderedWindow.valid && (memcmp(key, &renderedWindow.key, sizeof(*key)) == 0);
+}
+
+static int
+allocateRenderedWindow (unsigned int size) {
+  if (size > renderedWindow.size) {
+    unsigned char *dots;
+    wchar_t *text;
+
+    if (!(dots = realloc(renderedWindow.dots, ARRAY_SIZE(dots, size)))) goto error;
+    renderedWindow.dots = dots;
+
+    if (!(text = realloc(renderedWindow.text, ARRAY_SIZE(text, size)))) goto error;
+    renderedWindow.text = text;
+
+    renderedWindow.size = size;
+  }
+
+  return 1;
+
+error:
+  logMallocError();
+  renderedWindow.valid = 0;
+  return 0;
+}
+
+static void
+renderWindowRow (ScreenCharacter *characters, unsigned char *dots, wchar_t *text) {
+  int column;
+
+  /* blank out capital letters if they're blinking and should be off */
+  if (!isBlinkedOn(&capitalsBlinkingState)) {
+    for (column=0; column<textCount; column+=1) {
+      ScreenCharacter *character = &characters[column];
+      if (iswupper(character->text)) character->text = WC_C(' ');
+    }
+  }
+
+  /* convert to dots using the current translation table */
+  if (ses->displayMode) {
+    for (column=0; column<textCount; column+=1) {
+      text[column] = UNICODE_BRAILLE_ROW | (dots[column] = convertAttributesToDots(attributesTable, characters[column].attributes));
+    }
+  } else {
+    int underline = showAttributesUnderline();
+
+    for (column=0; column<textCount; column+=1) {
+      text[column] = characters[column].text;
+    }
+
+    convertCharactersToDots(textTable, text, textCount, dots);
+
+    for (column=0; column<textCount; column+=1) {
+      unsigned char *cell = &dots[column];
+
+      if (prefs.textStyle) *cell &= ~(BRL_DOT7 | BRL_DOT8);
+      if (underline) overlayAttributesUnderline(cell, characters[column].attributes);
+    }
+  }
+}
+
+#ifdef ENABLE_CONTRACTED_BRAILLE
+static void
+setContractedWindowKey (RenderedWindowKey *key, int cursor) {
+  key->cursor = cursor;
+  key->contractionTable = contractionTable;
+  key->capitalizationMode = prefs.capitalizationMode;
+  key->expandCurrentWord = prefs.expandCurrentWord;
+
+  /* contraction neither blanks capitals nor drops dots 7 and 8 */
+  key->capitalsHidden = key->sixDots = 0;
+}
+
+static struct {
+  RenderedWindowKey key;
+  unsigned int generation;
+  int *cursors;
+  unsigned int size;
+  unsigned valid:1;
+} preparedLines;
+
+static void
+prepareContractedLines (unsigned int outputLength) {
+  if (isContractionTableExternal(contractionTable)) {
+    int inputLength = scr.cols - ses->winx;
+    wchar_t inputBuffer[inputLength];
+    unsigned int count = brl.textRows + 2;
+    RenderedWindowKey key;
+    int reuse;
+    int record = 1;
+    unsigned int index;
+
+    setRenderedWindowKey(&key, inputLength, outputLength);
+    setContractedWindowKey(&key, CTB_NO_CURSOR);
+
+    /* how the window is shown doesn't affect what's sent to the helper */
+    key.displayMode = key.underline = 0;
+
+    reuse = preparedLines.valid && (memcmp(&key, &preparedLines.key, sizeof(key)) == 0);
+
+    if (count > preparedLines.size) {
+      int *cursors = realloc(preparedLines.cursors, ARRAY_SIZE(cursors, count));
+
+      if (cursors) {
+        preparedLines.cursors = cursors;
+        preparedLines.size = count;
+      } else {
+        logMallocError();
+        record = 0;
+      }
+
+      reuse = 0;
+    }
+
+    for (index=0; index<count; index+=1) {
+      int row = ses->winy - 1 + index;
+
+      if ((row >= 0) && (row < scr.rows) && (row != ses->winy)) {
+        /* the cursor as getContractedCursor will see it once the window is on this row */
+        int cursor = getContractedCursorOffset(row);
+
+        /* a row which hasn't changed was already sent on the previous update */
+        if (!reuse || (cursor != preparedLines.cursors[index]) ||
+            isScreenRowDirty(row, preparedLines.generation)) {
+          readScreenText(ses->winx, row, inputLength, 1, inputBuffer);
+          prepareContractedText(contractionTable,
+                                inputBuffer, inputLength,
+                                outputLength, cursor);
+        }
+
+        if (record) preparedLines.cursors[index] = cursor;
+      }
+    }
+
+    preparedLines.key = key;
+    preparedLines.generation = getScreenGeneration();
+    preparedLines.valid = record;
+  }
+}
+#endif /* ENABLE_CONTRACTED_BRAILLE */
+
 static int
 checkPointer (void) {
   int moved = 0;
@@ -1324,6 +1524,11 @@ int isOffline;
 int isSuspended;
 int inputModifiers;
 
+void
+brailleOutputFailed (void) {
+  restartRequired = 1;
+}
+
 static int oldwinx;
 static int oldwiny;
 
@@ -1360,12 +1565,19 @@ doAutospeak (void) {
   static int oldY = -1;
   static int oldWidth = 0;
   static ScreenCharacter *oldCharacters = NULL;
+  static int oldRow = -1;
+  static unsigned int oldGeneration = 0;
 
   int newScreen = scr.number;
   int newX = scr.posx;
   int newY = scr.posy;
   int newWidth = scr.cols;
   ScreenCharacter newCharacters[newWidth];
+  int rowChanged = !oldCharacters ||
+                   (newScreen != oldScreen) ||
+                   (ses->winy != oldRow) ||
+                   (newWidth != oldWidth) ||
+                   isScreenRowDirty(ses->winy, oldGeneration);
 
   readScreen(0, ses->winy, newWidth, 1, newCharacters);
 
@@ -1381,7 +1593,7 @@ doAutospeak (void) {
     } else {
       int onScreen = (newX >= 0) && (newX < newWidth);
 
-      if (!isSameRow(newCharacters, oldCharacters, newWidth, isSameText)) {
+      if (rowChanged && !isSameRow(newCharacters, oldCharacters, newWidth, isSameText)) {
         if ((newY == ses->winy) && (newY == oldY) && onScreen) {
           if ((newX == oldX) &&
               isSameRow(newCharacters, oldCharacters, newX, isSameText)) {
@@ -1528,7 +1740,7 @@ doAutospeak (void) {
     if (count) speakCharacters(characters, count, 0);
   }
 
-  {
+  if (rowChanged) {
     size_t size = newWidth * sizeof(*oldCharacters);
 
     if ((oldCharacters = realloc(oldCharacters, size))) {
@@ -1538,6 +1750,8 @@ doAutospeak (void) {
     }
   }
 
+  oldGeneration = getScreenGeneration();
+  oldRow = ses->winy;
   oldScreen = newScreen;
   oldX = newX;
   oldY = newY;
@@ -1549,6 +1763,14 @@ static AsyncHandle updateAlarm;
 static TimeValue updateTime;
 static int updateSuspendCount;
 
+/* When the screen notifies us of its changes, the update interval only
+ * matters for the things which still need to be done periodically.
+ * Otherwise, updates are done on demand, and the long interval is just
+ * a safety net for changes which go unnoticed.
+ */
+#define UPDATE_IDLE_INTERVAL 1000
+#define UPDATE_SCHEDULE_DELAY 10
+
 static void
 setUpdateTime (int delay) {
   getRelativeTime(&updateTime, delay);
@@ -1560,19 +1782,68 @@ resetUpdateAlarm (int delay) {
   if (updateAlarm) asyncResetAlarmTo(updateAlarm, &updateTime);
 }
 
+static void
+scheduleUpdate (void) {
+  TimeValue time;
+
+  getRelativeTime(&time, UPDATE_SCHEDULE_DELAY);
+
+  if (compareTimeValues(&time, &updateTime) < 0) {
+    updateTime = time;
+    if (updateAlarm) asyncResetAlarmTo(updateAlarm, &updateTime);
+  }
+}
+
+static int
+isBlinking (const BlinkingState *state) {
+  return *state->blinkingEnabled;
+}
+
+static int
+isPollingRequired (void) {
+  if (pollScreen()) return 1;
+  if (scr.unreadable) return 1;
+  if (opt_releaseDevice) return 1;
+  if (infoMode) return 1;
+  if (isRouting()) return 1;
+  if (prefs.windowFollowsPointer) return 1;
+
+  if (isBlinking(&cursorBlinkingState)) return 1;
+  if (isBlinking(&attributesBlinkingState)) return 1;
+  if (isBlinking(&capitalsBlinkingState)) return 1;
+  if (isBlinking(&speechCursorBlinkingState)) return 1;
+
+#ifdef ENABLE_SPEECH_SUPPORT
+  if (speechTracking) return 1;
+#endif /* ENABLE_SPEECH_SUPPORT */
+
+#ifdef ENABLE_CONTRACTED_BRAILLE
+  if (isContracting() && isContractionPending(contractionTable)) return 1;
+#endif /* ENABLE_CONTRACTED_BRAILLE */
+
+  return 0;
+}
+
 static void setUpdateAlarm (void *data);
 
 static void
 handleUpdateAlarm (const AsyncAlarmResult *result) {
-  setUpdateTime(updateInterval);
+  setUpdateTime(isPollingRequired()? updateInterval: UPDATE_IDLE_INTERVAL);
   asyncDiscardHandle(updateAlarm);
   updateAlarm = NULL;
+  beginUpdateCycle();
 
 #ifdef ENABLE_SPEECH_SUPPORT
+  startUpdateStage(UPDATE_STAGE_SPEECH);
   speech->doTrack(&spk);
-  if (speechTracking && !speech->isSpeaking(&spk)) speechTracking = 0;
+  if (speechTracking && !isSpeechQueued() && !speech->isSpeaking(&spk)) speechTracking = 0;
+  stopUpdateStage(UPDATE_STAGE_SPEECH);
 #endif /* ENABLE_SPEECH_SUPPORT */
 
+  startUpdateStage(UPDATE_STAGE_SCREEN);
+  beginScreenSnapshot();
+  stopUpdateStage(UPDATE_STAGE_SCREEN);
+
   if (opt_releaseDevice) {
     if (scr.unreadable) {
       if (!isSuspended) {
@@ -1699,98 +1970,130 @@ handleUpdateAlarm (const AsyncAlarmResult *result) {
         if (isContracting()) {
           while (1) {
             int inputLength = scr.cols - ses->winx;
-            ScreenCharacter inputCharacters[inputLength];
-            wchar_t inputText[inputLength];
-
             int outputLength = textLength;
             unsigned char outputBuffer[outputLength];
-
-            readScreen(ses->winx, ses->winy, inputLength, 1, inputCharacters);
-
-            {
-              int i;
-              for (i=0; i<inputLength; ++i) {
-                inputText[i] = inputCharacters[i].text;
+            RenderedWindowKey key;
+
+            setRenderedWindowKey(&key, inputLength, textLength);
+            setContractedWindowKey(&key, getContractedCursor());
+
+            startUpdateStage(UPDATE_STAGE_TRANSLATE);
+            prepareContractedLines(textLength);
+            stopUpdateStage(UPDATE_STAGE_TRANSLATE);
+
+            if (!contractedTrack && canReuseRenderedWindow(&key) &&
+                !isScreenRowDirty(ses->winy, renderedWindow.generation)) {
+              /* the row, and how it's contracted, are as they were */
+              inputLength = renderedWindow.inputLength;
+              outputLength = renderedWindow.outputLength;
+              memcpy(outputBuffer, renderedWindow.dots, outputLength);
+            } else {
+              ScreenCharacter inputCharacters[inputLength];
+              wchar_t inputText[inputLength];
+
+              startUpdateStage(UPDATE_STAGE_SCREEN);
+              readScreen(ses->winx, ses->winy, inputLength, 1, inputCharacters);
+              stopUpdateStage(UPDATE_STAGE_SCREEN);
+
+              {
+                int i;
+                for (i=0; i<inputLength; ++i) {
+                  inputText[i] = inputCharacters[i].text;
+                }
               }
-            }
 
-            contractText(contractionTable,
-                         inputText, &inputLength,
-                         outputBuffer, &outputLength,
-                         contractedOffsets, getContractedCursor());
-
-            {
-              int inputEnd = inputLength;
-
-              if (contractedTrack) {
-                if (outputLength == textLength) {
-                  int inputIndex = inputEnd;
-                  while (inputIndex) {
-                    int offset = contractedOffsets[--inputIndex];
-                    if (offset != CTB_NO_OFFSET) {
-                      if (offset != outputLength) break;
-                      inputEnd = inputIndex;
+              startUpdateStage(UPDATE_STAGE_TRANSLATE);
+              contractText(contractionTable,
+                           inputText, &inputLength,
+                           outputBuffer, &outputLength,
+                           contractedOffsets, getContractedCursor());
+              stopUpdateStage(UPDATE_STAGE_TRANSLATE);
+
+              {
+                int inputEnd = inputLength;
+
+                if (contractedTrack) {
+                  if (outputLength == textLength) {
+                    int inputIndex = inputEnd;
+                    while (inputIndex) {
+                      int offset = contractedOffsets[--inputIndex];
+                      if (offset != CTB_NO_OFFSET) {
+                        if (offset != outputLength) break;
+                        inputEnd = inputIndex;
+                      }
                     }
                   }
-                }
 
-                if (scr.posx >= (ses->winx + inputEnd)) {
-                  int offset = 0;
-                  int length = scr.cols - ses->winx;
-                  int onspace = 0;
+                  if (scr.posx >= (ses->winx + inputEnd)) {
+                    int offset = 0;
+                    int length = scr.cols - ses->winx;
+                    int onspace = 0;
+
+                    while (offset < length) {
+                      if ((iswspace(inputCharacters[offset].text) != 0) != onspace) {
+                        if (onspace) break;
+                        onspace = 1;
+                      }
+                      ++offset;
+                    }
 
-                  while (offset < length) {
-                    if ((iswspace(inputCharacters[offset].text) != 0) != onspace) {
-                      if (onspace) break;
-                      onspace = 1;
+                    if ((offset += ses->winx) > scr.posx) {
+                      ses->winx = (ses->winx + scr.posx) / 2;
+                    } else {
+                      ses->winx = offset;
                     }
-                    ++offset;
+
+                    continue;
                   }
+                }
+              }
 
-                  if ((offset += ses->winx) > scr.posx) {
-                    ses->winx = (ses->winx + scr.posx) / 2;
-                  } else {
-                    ses->winx = offset;
+              if (ses->displayMode || showAttributesUnderline()) {
+                int inputOffset;
+                int outputOffset = 0;
+                unsigned char attributes = 0;
+                unsigned char attributesBuffer[outputLength];
+
+                for (inputOffset=0; inputOffset<inputLength; ++inputOffset) {
+                  int offset = contractedOffsets[inputOffset];
+                  if (offset != CTB_NO_OFFSET) {
+                    while (outputOffset < offset) attributesBuffer[outputOffset++] = attributes;
+                    attributes = 0;
                   }
+                  attributes |= inputCharacters[inputOffset].attributes;
+                }
+                while (outputOffset < outputLength) attributesBuffer[outputOffset++] = attributes;
 
-                  continue;
+                if (ses->displayMode) {
+                  for (outputOffset=0; outputOffset<outputLength; ++outputOffset) {
+                    outputBuffer[outputOffset] = convertAttributesToDots(attributesTable, attributesBuffer[outputOffset]);
+                  }
+                } else {
+                  int i;
+                  for (i=0; i<outputLength; ++i) {
+                    overlayAttributesUnderline(&outputBuffer[i], attributesBuffer[i]);
+                  }
                 }
               }
+
+              /* an external translation which is still pending will be redone */
+              if (isContractionPending(contractionTable)) {
+                renderedWindow.valid = 0;
+              } else if (allocateRenderedWindow(textLength)) {
+                memcpy(renderedWindow.dots, outputBuffer, outputLength);
+                renderedWindow.inputLength = inputLength;
+                renderedWindow.outputLength = outputLength;
+                renderedWindow.key = key;
+                renderedWindow.valid = 1;
+              }
             }
 
+            renderedWindow.generation = getScreenGeneration();
             contractedStart = ses->winx;
             contractedLength = inputLength;
             contractedTrack = 0;
             isContracted = 1;
 
-            if (ses->displayMode || showAttributesUnderline()) {
-              int inputOffset;
-              int outputOffset = 0;
-              unsigned char attributes = 0;
-              unsigned char attributesBuffer[outputLength];
-
-              for (inputOffset=0; inputOffset<contractedLength; ++inputOffset) {
-                int offset = contractedOffsets[inputOffset];
-                if (offset != CTB_NO_OFFSET) {
-                  while (outputOffset < offset) attributesBuffer[outputOffset++] = attributes;
-                  attributes = 0;
-                }
-                attributes |= inputCharacters[inputOffset].attributes;
-              }
-              while (outputOffset < outputLength) attributesBuffer[outputOffset++] = attributes;
-
-              if (ses->displayMode) {
-                for (outputOffset=0; outputOffset<outputLength; ++outputOffset) {
-                  outputBuffer[outputOffset] = convertAttributesToDots(attributesTable, attributesBuffer[outputOffset]);
-                }
-              } else {
-                int i;
-                for (i=0; i<outputLength; ++i) {
-                  overlayAttributesUnderline(&outputBuffer[i], attributesBuffer[i]);
-                }
-              }
-            }
-
             fillDotsRegion(textBuffer, brl.buffer,
                            textStart, textCount, brl.textColumns, brl.textRows,
                            outputBuffer, outputLength);
@@ -1802,74 +2105,57 @@ handleUpdateAlarm (const AsyncAlarmResult *result) {
 #endif /* ENABLE_CONTRACTED_BRAILLE */
         {
           int windowColumns = MIN(textCount, scr.cols-ses->winx);
-          ScreenCharacter characters[textLength];
-
-          readScreen(ses->winx, ses->winy, windowColumns, brl.textRows, characters);
-          if (windowColumns < textCount) {
-            /* We got a rectangular piece of text with readScreen but the display
-             * is in an off-right position with some cells at the end blank
-             * so we'll insert these cells and blank them.
-             */
-            int i;
-
-            for (i=brl.textRows-1; i>0; i--) {
-              memmove(characters + (i * textCount),
-                      characters + (i * windowColumns),
-                      windowColumns * sizeof(*characters));
-            }
+          RenderedWindowKey key;
+          int reuse;
+          int row;
+
+          setRenderedWindowKey(&key, textCount, textLength);
+          reuse = canReuseRenderedWindow(&key);
+
+          /* only the rows which the screen driver says have changed are reread,
+           * and all of them are when it can't say
+           */
+          for (row=0; row<brl.textRows; row+=1) {
+            unsigned int start = (row * brl.textColumns) + textStart;
+            unsigned char *target = &brl.buffer[start];
+            wchar_t *text = &textBuffer[start];
+
+            if (reuse && !isScreenRowDirty(ses->winy+row, renderedWindow.generation)) {
+              memcpy(target, &renderedWindow.dots[row * textCount], textCount);
+              wmemcpy(text, &renderedWindow.text[row * textCount], textCount);
+            } else {
+              ScreenCharacter characters[textCount];
+
+              startUpdateStage(UPDATE_STAGE_SCREEN);
+
+              if (!readScreen(ses->winx, ses->winy+row, windowColumns, 1, characters)) {
+                clearScreenCharacters(characters, textCount);
+              } else if (windowColumns < textCount) {
+                /* The display is in an off-right position with some cells at
+                 * the end of the row blank.
+                 */
+                clearScreenCharacters(characters + windowColumns, textCount-windowColumns);
+              }
 
-            for (i=0; i<brl.textRows; i++) {
-              clearScreenCharacters(characters + (i * textCount) + windowColumns,
-                                    textCount-windowColumns);
-            }
-          }
+              stopUpdateStage(UPDATE_STAGE_SCREEN);
 
-          /* blank out capital letters if they're blinking and should be off */
-          if (!isBlinkedOn(&capitalsBlinkingState)) {
-            unsigned int i;
-            for (i=0; i<textCount*brl.textRows; i+=1) {
-              ScreenCharacter *character = &characters[i];
-              if (iswupper(character->text)) character->text = WC_C(' ');
+              startUpdateStage(UPDATE_STAGE_TRANSLATE);
+              renderWindowRow(characters, target, text);
+              stopUpdateStage(UPDATE_STAGE_TRANSLATE);
             }
           }
 
-          /* convert to dots using the current translation table */
-          if (ses->displayMode) {
-            int row;
-
+          if (allocateRenderedWindow(textLength)) {
             for (row=0; row<brl.textRows; row+=1) {
-              const ScreenCharacter *source = &characters[row * textCount];
               unsigned int start = (row * brl.textColumns) + textStart;
-              unsigned char *target = &brl.buffer[start];
-              wchar_t *text = &textBuffer[start];
-              int column;
 
-              for (column=0; column<textCount; column+=1) {
-                text[column] = UNICODE_BRAILLE_ROW | (target[column] = convertAttributesToDots(attributesTable, source[column].attributes));
-              }
+              memcpy(&renderedWindow.dots[row * textCount], &brl.buffer[start], textCount);
+              wmemcpy(&renderedWindow.text[row * textCount], &textBuffer[start], textCount);
             }
-          } else {
-            int underline = showAttributesUnderline();
-            int row;
-
-            for (row=0; row<brl.textRows; row+=1) {
-              const ScreenCharacter *source = &characters[row * textCount];
-              unsigned int start = (row * brl.textColumns) + textStart;
-              unsigned char *target = &brl.buffer[start];
-              wchar_t *text = &textBuffer[start];
-              int column;
 
-              for (column=0; column<textCount; column+=1) {
-                const ScreenCharacter *character = &source[column];
-                unsigned char *dots = &target[column];
-
-                *dots = convertCharacterToDots(textTable, character->text);
-                if (prefs.textStyle) *dots &= ~(BRL_DOT7 | BRL_DOT8);
-                if (underline) overlayAttributesUnderline(dots, character->attributes);
-
-                text[column] = character->text;
-              }
-            }
+            renderedWindow.key = key;
+            renderedWindow.generation = getScreenGeneration();
+            renderedWindow.valid = 1;
           }
         }
 
@@ -1903,7 +2189,9 @@ handleUpdateAlarm (const AsyncAlarmResult *result) {
           fillStatusSeparator(textBuffer, brl.buffer);
         }
 
-        if (!(writeStatusCells() && braille->writeWindow(&brl, textBuffer))) restartRequired = 1;
+        startUpdateStage(UPDATE_STAGE_WRITE);
+        if (!(writeStatusCells() && writeBrailleWindow(&brl, textBuffer))) restartRequired = 1;
+        stopUpdateStage(UPDATE_STAGE_WRITE);
       }
     }
 
@@ -1911,11 +2199,14 @@ handleUpdateAlarm (const AsyncAlarmResult *result) {
   }
 
 #ifdef ENABLE_SPEECH_SUPPORT
+  startUpdateStage(UPDATE_STAGE_SPEECH);
   if (autospeak()) doAutospeak();
   processSpeechInput(&spk);
+  stopUpdateStage(UPDATE_STAGE_SPEECH);
 #endif /* ENABLE_SPEECH_SUPPORT */
 
-  drainBrailleOutput(&brl, 0);
+  endScreenSnapshot();
+  endUpdateCycle();
   setUpdateAlarm(result->data);
 }
 
@@ -1930,6 +2221,7 @@ startUpdates (void) {
   updateSuspendCount = 0;
   setUpdateTime(0);
   setUpdateAlarm(NULL);
+  setScreenUpdatedHandler(scheduleUpdate);
 }
 
 void
@@ -2172,7 +2464,7 @@ showDotPattern (unsigned char dots, unsigned char duration) {
   }
 
   memset(brl.buffer, dots, brl.textColumns*brl.textRows);
-  if (!braille->writeWindow(&brl, NULL)) return 0;
+  if (!writeBrailleWindow(&brl, NULL)) return 0;
 
   drainBrailleOutput(&brl, duration);
   return 1;
@@ -114,6 +114,7 @@ extern int isSuspended;
 extern int inputModifiers;
 
 extern void resetBrailleState (void);
+extern void brailleOutputFailed (void);
 
 extern void placeRightEdge (int column);
 extern void placeWindowRight (void);
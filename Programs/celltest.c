@@ -0,0 +1,284 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+/* celltest.c - Test program for the changed cell finders
+ *
+ * Fixed cases check the exact ranges which cellRangesHaveChanged reports
+ * (forced rewrites, gap merging, the range limit, and changes in a tail
+ * which is shorter than the word used for comparing), and random cases
+ * check that every change is covered.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "program.h"
+#include "options.h"
+#include "log.h"
+#include "brl.h"
+
+BEGIN_OPTION_TABLE(programOptions)
+END_OPTION_TABLE
+
+#define TEST_CELL_COUNT 43
+#define TEST_RANGE_LIMIT 4
+#define TEST_RANGE_GAP 4
+#define TEST_RANDOM_CASES 100000
+
+typedef struct {
+  const char *name;
+  unsigned int count;
+  int force;
+  unsigned char changes[TEST_CELL_COUNT];
+  unsigned int changeCount;
+  ChangedRange ranges[TEST_RANGE_LIMIT];
+  unsigned int rangeCount;
+} RangeTest;
+
+static const RangeTest rangeTests[] = {
+  { .name = "unchanged",
+    .count = TEST_CELL_COUNT
+  },
+
+  { .name = "forced unchanged",
+    .count = TEST_CELL_COUNT, .force = 1,
+    .ranges = {{0, TEST_CELL_COUNT}}, .rangeCount = 1
+  },
+
+  { .name = "forced empty",
+    .count = 0, .force = 1
+  },
+
+  { .name = "forced one change",
+    .count = TEST_CELL_COUNT, .force = 1,
+    .changes = {20}, .changeCount = 1,
+    .ranges = {{0, TEST_CELL_COUNT}}, .rangeCount = 1
+  },
+
+  { .name = "one change",
+    .count = TEST_CELL_COUNT,
+    .changes = {20}, .changeCount = 1,
+    .ranges = {{20, 21}}, .rangeCount = 1
+  },
+
+  { .name = "gap merged",
+    .count = TEST_CELL_COUNT,
+    .changes = {5, 10}, .changeCount = 2,
+    .ranges = {{5, 11}}, .rangeCount = 1
+  },
+
+  { .name = "gap not merged",
+    .count = TEST_CELL_COUNT,
+    .changes = {5, 11}, .changeCount = 2,
+    .ranges = {{5, 6}, {11, 12}}, .rangeCount = 2
+  },
+
+  { .name = "range limit",
+    .count = TEST_CELL_COUNT,
+    .changes = {0, 10, 20, 30, 40}, .changeCount = 5,
+    .ranges = {{0, 1}, {10, 11}, {20, 21}, {30, 41}}, .rangeCount = 4
+  },
+
+  { .name = "unaligned tail",
+    .count = TEST_CELL_COUNT,
+    .changes = {42}, .changeCount = 1,
+    .ranges = {{42, 43}}, .rangeCount = 1
+  },
+
+  { .name = "unaligned head and tail",
+    .count = TEST_CELL_COUNT,
+    .changes = {1, 41}, .changeCount = 2,
+    .ranges = {{1, 2}, {41, 42}}, .rangeCount = 2
+  },
+
+  { .name = "short buffer",
+    .count = 3,
+    .changes = {2}, .changeCount = 1,
+    .ranges = {{2, 3}}, .rangeCount = 1
+  },
+};
+
+static int
+findRanges (
+  const char *name,
+  const unsigned char *old, const unsigned char *new, unsigned int count,
+  int force, ChangedRange *ranges, unsigned int *rangeCount
+) {
+  unsigned char cells[count + 1];
+  const char *problem = NULL;
+  int forced = force;
+  unsigned int index;
+
+  memcpy(cells, old, count);
+  *rangeCount = cellRangesHaveChanged(cells, new, count,
+                                      ranges, TEST_RANGE_LIMIT, TEST_RANGE_GAP,
+                                      &force);
+
+  if (force) {
+    problem = "force not reset";
+  } else if (memcmp(cells, new, count) != 0) {
+    problem = "cells not updated";
+  } else if (*rangeCount > TEST_RANGE_LIMIT) {
+    problem = "too many ranges";
+  } else if (forced && count) {
+    if ((*rangeCount != 1) || (ranges[0].from != 0) || (ranges[0].to != count)) {
+      problem = "forced rewrite not whole";
+    }
+  } else {
+    unsigned int previous = 0;
+
+    for (index=0; index<*rangeCount; index+=1) {
+      const ChangedRange *range = &ranges[index];
+
+      if (range->from >= range->to) {
+        problem = "empty range";
+        break;
+      }
+
+      if ((range->from < previous) || (range->to > count)) {
+        problem = "range out of order";
+        break;
+      }
+
+      previous = range->to;
+    }
+
+    if (!problem) {
+      for (index=0; index<count; index+=1) {
+        if (old[index] != new[index]) {
+          unsigned int range = 0;
+
+          while ((range < *rangeCount) && (ranges[range].to <= index)) range += 1;
+
+          if ((range == *rangeCount) || (ranges[range].from > index)) {
+            problem = "change not covered";
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  if (!problem) return 1;
+  logMessage(LOG_ERR, "%s: %s", name, problem);
+  return 0;
+}
+
+static void
+logRanges (const char *label, const ChangedRange *ranges, unsigned int count) {
+  char buffer[0X100];
+  size_t length = 0;
+  unsigned int index;
+
+  buffer[0] = 0;
+
+  for (index=0; index<count; index+=1) {
+    int result = snprintf(&buffer[length], sizeof(buffer)-length, " [%u,%u)",
+                          ranges[index].from, ranges[index].to);
+
+    if ((result < 0) || (result >= (sizeof(buffer) - length))) break;
+    length += result;
+  }
+
+  logMessage(LOG_ERR, "%s:%s", label, (length? buffer: " none"));
+}
+
+static int
+checkRangeTest (const RangeTest *test) {
+  unsigned char old[TEST_CELL_COUNT];
+  unsigned char new[TEST_CELL_COUNT];
+  ChangedRange ranges[TEST_RANGE_LIMIT];
+  unsigned int rangeCount;
+  unsigned int index;
+
+  memset(old, 0, sizeof(old));
+  memcpy(new, old, sizeof(new));
+  for (index=0; index<test->changeCount; index+=1) new[test->changes[index]] = 1;
+
+  if (findRanges(test->name, old, new, test->count, test->force, ranges, &rangeCount)) {
+    if ((rangeCount == test->rangeCount) &&
+        (memcmp(ranges, test->ranges, ARRAY_SIZE(ranges, rangeCount)) == 0)) {
+      return 1;
+    }
+
+    logMessage(LOG_ERR, "%s: unexpected ranges", test->name);
+    logRanges("expected", test->ranges, test->rangeCount);
+    logRanges("actual", ranges, rangeCount);
+  }
+
+  return 0;
+}
+
+static int
+checkRandomRanges (void) {
+  unsigned char old[TEST_CELL_COUNT];
+  unsigned char new[TEST_CELL_COUNT];
+  unsigned int iteration;
+
+  srand(0);
+
+  for (iteration=0; iteration<TEST_RANDOM_CASES; iteration+=1) {
+    unsigned int count = rand() % (TEST_CELL_COUNT + 1);
+    unsigned int changes = rand() % (count + 1);
+    int force = (rand() % 8) == 0;
+    ChangedRange ranges[TEST_RANGE_LIMIT];
+    unsigned int rangeCount;
+    unsigned int index;
+
+    for (index=0; index<count; index+=1) old[index] = new[index] = rand();
+    while (changes--) new[rand() % count] ^= 1 << (rand() % 8);
+
+    if (!findRanges("random", old, new, count, force, ranges, &rangeCount)) {
+      logRanges("actual", ranges, rangeCount);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int
+main (int argc, char *argv[]) {
+  int ok = 1;
+
+  {
+    static const OptionsDescriptor descriptor = {
+      OPTION_TABLE(programOptions),
+      .applicationName = "celltest"
+    };
+    PROCESS_OPTIONS(descriptor, argc, argv);
+  }
+
+  {
+    const RangeTest *test = rangeTests;
+    const RangeTest *end = test + ARRAY_COUNT(rangeTests);
+
+    while (test < end) {
+      if (!checkRangeTest(test)) ok = 0;
+      test += 1;
+    }
+  }
+
+  if (!checkRandomRanges()) ok = 0;
+
+  logMessage(LOG_NOTICE, "cell range checks %s", (ok? "passed": "failed"));
+  return ok? PROG_EXIT_SUCCESS: PROG_EXIT_FATAL;
+}
@@ -40,6 +40,8 @@
 #include "scr.h"
 #include "charset.h"
 #include "brltty.h"
+#include "spk_queue.h"
+#include "update_timing.h"
 
 static int
 getWindowLength (void) {
@@ -960,6 +962,10 @@ doCommand:
         playTune(cpbRestore()? &tune_command_done: &tune_command_rejected);
         break;
 
+      case BRL_CMD_UPDATE_TIMES:
+        if (!showUpdateTimings()) playTune(&tune_command_rejected);
+        break;
+
       case BRL_CMD_CSRJMP_VERT:
         playTune(routeCursor(-1, ses->winy, scr.number)?
                  &tune_routing_started:
@@ -1254,7 +1260,7 @@ doCommand:
         break;
 
       case BRL_CMD_MUTE:
-        speech->mute(&spk);
+        muteSpeech(&spk);
         break;
 
       case BRL_CMD_SAY_LINE:
@@ -32,9 +32,11 @@
 #include "cmd.h"
 #include "brl.h"
 #include "spk.h"
+#include "spk_queue.h"
 #include "scr.h"
 #include "status.h"
 #include "datafile.h"
+#include "tblcache.h"
 #include "ttb.h"
 #include "atb.h"
 #include "ctb.h"
@@ -48,8 +50,12 @@
 #include "file.h"
 #include "parse.h"
 #include "dynld.h"
+#include "timing.h"
 #include "async_alarm.h"
+#include "async_io.h"
+#include "async_wait.h"
 #include "program.h"
+#include "queue.h"
 #include "service.h"
 #include "options.h"
 #include "cmd_queue.h"
@@ -69,6 +75,13 @@ int isWindowsService = 0;
 #include "system_msdos.h"
 #endif /* __MSDOS__ */
 
+#if !defined(__MINGW32__) && !defined(__MSDOS__)
+#include <signal.h>
+#include <sys/wait.h>
+
+#define CAN_PROBE_BRAILLE_DEVICES_IN_PARALLEL
+#endif /* parallel braille device probing */
+
 #define SERVICE_NAME "BrlAPI"
 #define SERVICE_DESCRIPTION "Braille API (BrlAPI)"
 
@@ -110,6 +123,7 @@ static char *opt_driversDirectory;
 
 static char *opt_brailleDevice;
 int opt_releaseDevice;
+static int opt_parallelProbes;
 static char **brailleDevices = NULL;
 static const char *brailleDevice = NULL;
 static int brailleConstructed;
@@ -310,6 +324,14 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("Path to device for accessing braille display.")
   },
 
+  { .letter = 'j',
+    .word = "parallel-probes",
+    .flags = OPT_Hidden | OPT_Config | OPT_Environ,
+    .setting.flag = &opt_parallelProbes,
+    .defaultSetting = FLAG_FALSE_WORD,
+    .description = strtext("Probe all of the braille devices at the same time.")
+  },
+
   { .letter = 'r',
     .word = "release-device",
     .flags = OPT_Hidden | OPT_Config | OPT_Environ,
@@ -945,8 +967,19 @@ activateDriver (const DriverActivationData *data, int verify) {
 
   while (*driver) {
     if (!autodetect || data->haveDriver(*driver)) {
+      TimeValue start;
+      int initialized;
+
       logMessage(LOG_DEBUG, "checking for %s driver: %s", data->driverType, *driver);
-      if (data->initializeDriver(*driver, verify)) return 1;
+      getMonotonicTime(&start);
+      initialized = data->initializeDriver(*driver, verify);
+
+      logMessage(LOG_DEBUG, "%s driver %s: %s after %ldms",
+                 data->driverType, *driver,
+                 initialized? "found": "not found",
+                 getMonotonicElapsed(&start));
+
+      if (initialized) return 1;
     }
 
     ++driver;
@@ -976,6 +1009,7 @@ void
 initializeBraille (void) {
   initializeBrailleDisplay(&brl);
   brl.bufferResized = &windowConfigurationChanged;
+  brl.outputFailed = &brailleOutputFailed;
 }
 
 int
@@ -1077,6 +1111,7 @@ destructBrailleDriver (void) {
   brailleConstructed = 0;
   stopBrailleCommands();
   drainBrailleOutput(&brl, 0);
+  stopBrailleOutput(&brl);
   braille->destruct(&brl);
   disableHelpPage(brailleHelpPageNumber);
 
@@ -1154,65 +1189,539 @@ initializeBrailleDriver (const char *code, int verify) {
   return 0;
 }
 
+static int
+activateBrailleDevice (const char *device, const char *const *drivers, int verify) {
+  const char *const *autodetectableDrivers;
+
+  brailleDevice = device;
+  logMessage(LOG_DEBUG, "checking braille device: %s", brailleDevice);
+
+  {
+    const char *dev = brailleDevice;
+
+    if (isSerialDevice(&dev)) {
+      static const char *const serialDrivers[] = {
+        "md", "pm", "ts", "ht", "bn", "al", "bm", "pg", "sk",
+        NULL
+      };
+      autodetectableDrivers = serialDrivers;
+    } else if (isUsbDevice(&dev)) {
+      static const char *const usbDrivers[] = {
+        "al", "bm", "eu", "fs", "ht", "hm", "hw", "mt", "pg", "pm", "sk", "vo",
+        NULL
+      };
+      autodetectableDrivers = usbDrivers;
+    } else if (isBluetoothDevice(&dev)) {
+      if (!(autodetectableDrivers = bthGetDriverCodes(dev, 5000))) {
+        static const char *bluetoothDrivers[] = {
+          "np", "ht", "al", "bm",
+          NULL
+        };
+        autodetectableDrivers = bluetoothDrivers;
+      }
+    } else {
+      static const char *noDrivers[] = {NULL};
+      autodetectableDrivers = noDrivers;
+    }
+  }
+
+  {
+    const DriverActivationData data = {
+      .driverType = "braille",
+      .requestedDrivers = drivers,
+      .autodetectableDrivers = autodetectableDrivers,
+      .getDefaultDriver = getDefaultBrailleDriver,
+      .haveDriver = haveBrailleDriver,
+      .initializeDriver = initializeBrailleDriver
+    };
+
+    return activateDriver(&data, verify);
+  }
+}
+
+#ifdef CAN_PROBE_BRAILLE_DEVICES_IN_PARALLEL
+static void deactivateBrailleDriver (void);
+
+typedef struct {
+  const char *device;
+  pid_t process;
+  int pipe;
+  AsyncHandle monitor;
+
+  TimeValue start;
+  long int elapsed;
+
+  char driver[0X10];
+  size_t length;
+  unsigned finished:1;
+} BrailleDeviceProbe;
+
+typedef struct {
+  BrailleDeviceProbe *probes;
+  unsigned int count;
+} BrailleDeviceProbes;
+
+static void
+runBrailleDeviceProbe (const char *device, int output) {
+  /* Don't act upon (or disturb) the parent's pending requests. */
+  asyncAbandonRequests();
+
+#ifdef ENABLE_API
+  apiStarted = 0;
+#endif /* ENABLE_API */
+
+  if (activateBrailleDevice(device, (const char *const *)brailleDrivers, 0)) {
+    char driver[0X10];
+    size_t length = snprintf(driver, sizeof(driver), "%s", braille->definition.code);
+
+    /* The parent can't open the device until we've released it. */
+    deactivateBrailleDriver();
+
+    if (write(output, driver, length) == -1) logSystemError("write");
+  }
+}
+
+static int
+handleBrailleDeviceProbeOutput (const AsyncMonitorResult *result) {
+  BrailleDeviceProbe *probe = result->data;
+  size_t size = sizeof(probe->driver) - 1 - probe->length;
+  ssize_t count = read(probe->pipe, &probe->driver[probe->length], size);
+
+  if (count > 0) {
+    probe->length += count;
+    return 1;
+  }
+
+  if (count == -1) {
+    if ((errno == EINTR) || (errno == EAGAIN)) return 1;
+    logSystemError("read");
+  }
+
+  probe->driver[probe->length] = 0;
+  probe->elapsed = getMonotonicElapsed(&probe->start);
+  probe->finished = 1;
+  return 0;
+}
+
+static BrailleDeviceProbe *
+getBrailleDeviceProbeWinner (const BrailleDeviceProbes *bdp) {
+  BrailleDeviceProbe *probe = bdp->probes;
+  BrailleDeviceProbe *end = probe + bdp->count;
+
+  while (probe < end) {
+    if (probe->finished && probe->length) return probe;
+    probe += 1;
+  }
+
+  return NULL;
+}
+
+static int
+testBrailleDeviceProbes (void *data) {
+  const BrailleDeviceProbes *bdp = data;
+
+  if (getBrailleDeviceProbeWinner(bdp)) return 1;
+
+  {
+    unsigned int index;
+
+    for (index=0; index<bdp->count; index+=1) {
+      if (!bdp->probes[index].finished) return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+startBrailleDeviceProbe (BrailleDeviceProbe *probe) {
+  int fds[2];
+
+  if (pipe(fds) != -1) {
+    getMonotonicTime(&probe->start);
+
+    switch ((probe->process = fork())) {
+      case 0: /* child: probe the device */
+        close(fds[0]);
+        runBrailleDeviceProbe(probe->device, fds[1]);
+        _exit(0);
+
+      case -1:
+        logSystemError("fork");
+        break;
+
+      default: /* parent: wait for the driver code */
+        close(fds[1]);
+        probe->pipe = fds[0];
+
+        if (asyncMonitorFileInput(&probe->monitor, probe->pipe,
+                                  handleBrailleDeviceProbeOutput, probe)) {
+          return 1;
+        }
+
+        kill(probe->process, SIGKILL);
+        waitpid(probe->process, NULL, 0);
+        close(probe->pipe);
+        return 0;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+  } else {
+    logSystemError("pipe");
+  }
+
+  return 0;
+}
+
+static void
+stopBrailleDeviceProbe (BrailleDeviceProbe *probe) {
+  if (!probe->finished) {
+    probe->elapsed = getMonotonicElapsed(&probe->start);
+    kill(probe->process, SIGKILL);
+  }
+
+  asyncCancelRequest(probe->monitor);
+  close(probe->pipe);
+  waitpid(probe->process, NULL, 0);
+
+  logMessage(LOG_DEBUG, "braille device probe: %s -> %s after %ldms",
+             probe->device,
+             !probe->finished? "cancelled":
+             probe->length? probe->driver: "not found",
+             probe->elapsed);
+}
+
+static int
+probeBrailleDevices (void) {
+  unsigned int count = 0;
+  while (brailleDevices[count]) count += 1;
+
+  {
+    BrailleDeviceProbe probes[count];
+    BrailleDeviceProbes bdp = {
+      .probes = probes,
+      .count = 0
+    };
+
+    while (bdp.count < count) {
+      BrailleDeviceProbe *probe = &probes[bdp.count];
+
+      memset(probe, 0, sizeof(*probe));
+      probe->device = brailleDevices[bdp.count];
+
+      if (!startBrailleDeviceProbe(probe)) break;
+      bdp.count += 1;
+    }
+
+    if (bdp.count == count) {
+      BrailleDeviceProbe *winner;
+      TimeValue start;
+
+      logMessage(LOG_DEBUG, "probing %u braille devices in parallel", count);
+      getMonotonicTime(&start);
+      while (!testBrailleDeviceProbes(&bdp)) {
+        asyncAwaitCondition(1000, testBrailleDeviceProbes, &bdp);
+      }
+
+      {
+        unsigned int index;
+
+        for (index=0; index<bdp.count; index+=1) {
+          stopBrailleDeviceProbe(&probes[index]);
+        }
+      }
+
+      logMessage(LOG_DEBUG, "parallel braille device probing finished after %ldms",
+                 getMonotonicElapsed(&start));
+
+      if ((winner = getBrailleDeviceProbeWinner(&bdp))) {
+        const char *const drivers[] = {winner->driver, NULL};
+
+        if (activateBrailleDevice(winner->device, drivers, 0)) return 1;
+      }
+
+      brailleDevice = NULL;
+      return 0;
+    }
+
+    while (bdp.count > 0) stopBrailleDeviceProbe(&probes[--bdp.count]);
+  }
+
+  logMessage(LOG_WARNING, "parallel braille device probing not available");
+  return -1;
+}
+#endif /* CAN_PROBE_BRAILLE_DEVICES_IN_PARALLEL */
+
+#define BRAILLE_DRIVER_CACHE_FILE "braille-drivers.cache"
+
+typedef struct {
+  char *device;
+  char *driver;
+  char *fingerprint;
+} BrailleDriverCacheEntry;
+
+static void
+deallocateBrailleDriverCacheEntry (void *item, void *data) {
+  BrailleDriverCacheEntry *entry = item;
+
+  free(entry->device);
+  free(entry->driver);
+  if (entry->fingerprint) free(entry->fingerprint);
+  free(entry);
+}
+
+static int
+testBrailleDriverCacheEntry (const void *item, const void *data) {
+  const BrailleDriverCacheEntry *entry = item;
+  const char *device = data;
+
+  return strcmp(entry->device, device) == 0;
+}
+
+static BrailleDriverCacheEntry *
+newBrailleDriverCacheEntry (const char *device, const char *driver, const char *fingerprint) {
+  BrailleDriverCacheEntry *entry;
+
+  if ((entry = malloc(sizeof(*entry)))) {
+    memset(entry, 0, sizeof(*entry));
+
+    if ((entry->device = strdup(device))) {
+      if ((entry->driver = strdup(driver))) {
+        if (!fingerprint || (entry->fingerprint = strdup(fingerprint))) {
+          return entry;
+        }
+
+        free(entry->driver);
+      }
+
+      free(entry->device);
+    }
+
+    free(entry);
+  }
+
+  logMallocError();
+  return NULL;
+}
+
+static int
+addBrailleDriverCacheEntry (Queue *cache, const char *device, const char *driver, const char *fingerprint) {
+  BrailleDriverCacheEntry *entry = newBrailleDriverCacheEntry(device, driver, fingerprint);
+
+  if (entry) {
+    if (enqueueItem(cache, entry)) return 1;
+    deallocateBrailleDriverCacheEntry(entry, NULL);
+  }
+
+  return 0;
+}
+
+static int
+handleBrailleDriverCacheLine (char *line, void *data) {
+  Queue *cache = data;
+  static const char delimiters[] = " \t";
+  char *device = strtok(line, delimiters);
+  char *driver = strtok(NULL, delimiters);
+  char *fingerprint = strtok(NULL, "");
+
+  if (device && driver) {
+    if (fingerprint) {
+      fingerprint += strspn(fingerprint, delimiters);
+      if (!*fingerprint) fingerprint = NULL;
+    }
+
+    if (!findItem(cache, testBrailleDriverCacheEntry, device)) {
+      addBrailleDriverCacheEntry(cache, device, driver, fingerprint);
+    }
+  }
+
+  return 1;
+}
+
+static Queue *
+loadBrailleDriverCache (void) {
+  Queue *cache = newQueue(deallocateBrailleDriverCacheEntry, NULL);
+
+  if (cache) {
+    char *path = makeWritablePath(BRAILLE_DRIVER_CACHE_FILE);
+
+    if (path) {
+      FILE *file = openFile(path, "r", 1);
+
+      if (file) {
+        processLines(file, handleBrailleDriverCacheLine, cache);
+        fclose(file);
+      }
+
+      free(path);
+    }
+  }
+
+  return cache;
+}
+
+static int
+writeBrailleDriverCacheEntry (void *item, void *data) {
+  const BrailleDriverCacheEntry *entry = item;
+  FILE *file = data;
+
+  fprintf(file, "%s %s", entry->device, entry->driver);
+  if (entry->fingerprint) fprintf(file, " %s", entry->fingerprint);
+  fprintf(file, "\n");
+  return ferror(file) != 0;
+}
+
+static void
+saveBrailleDriverCache (Queue *cache) {
+  char *path = makeWritablePath(BRAILLE_DRIVER_CACHE_FILE);
+
+  if (path) {
+    char *newPath = ensureFileExtension(path, ".new");
+
+    if (newPath) {
+      FILE *file = openFile(newPath, "w", 0);
+
+      if (file) {
+        int ok = !processQueue(cache, writeBrailleDriverCacheEntry, file);
+
+        if (fclose(file) == EOF) {
+          logSystemError("fclose");
+          ok = 0;
+        }
+
+        if (ok) {
+          if (rename(newPath, path) == -1) {
+            logSystemError("rename");
+            ok = 0;
+          }
+        }
+
+        if (!ok) unlink(newPath);
+      }
+
+      free(newPath);
+    }
+
+    free(path);
+  }
+}
+
+static int
+isAutodetectingBrailleDriver (void) {
+  if (!brailleDrivers[0] || brailleDrivers[1]) return 0;
+  if (strcmp(brailleDrivers[0], "auto") != 0) return 0;
+  return !getDefaultBrailleDriver();
+}
+
+static int
+activateCachedBrailleDriver (void) {
+  int activated = 0;
+  Queue *cache = loadBrailleDriverCache();
+
+  if (cache) {
+    const char *const *device = (const char *const *)brailleDevices;
+    int changed = 0;
+
+    while (*device) {
+      BrailleDriverCacheEntry *entry = findItem(cache, testBrailleDriverCacheEntry, *device);
+
+      if (entry) {
+        const char *dev = *device;
+
+        if (entry->fingerprint && isUsbDevice(&dev) &&
+            !usbHaveDeviceFingerprint(entry->fingerprint)) {
+          logMessage(LOG_DEBUG, "cached braille device not present: %s -> %s",
+                     *device, entry->fingerprint);
+        } else {
+          const char *const drivers[] = {entry->driver, NULL};
+
+          logMessage(LOG_DEBUG, "trying cached braille driver: %s -> %s",
+                     entry->driver, *device);
+
+          if (activateBrailleDevice(*device, drivers, 0)) {
+            activated = 1;
+            break;
+          }
+
+          logMessage(LOG_DEBUG, "forgetting cached braille driver: %s -> %s",
+                     entry->driver, *device);
+          deleteItem(cache, entry);
+          changed = 1;
+        }
+      }
+
+      device += 1;
+    }
+
+    if (changed) saveBrailleDriverCache(cache);
+    deallocateQueue(cache);
+  }
+
+  if (!activated) brailleDevice = NULL;
+  return activated;
+}
+
+static void
+cacheBrailleDriver (void) {
+  Queue *cache = loadBrailleDriverCache();
+
+  if (cache) {
+    const char *dev = brailleDevice;
+    char *fingerprint = isUsbDevice(&dev)? usbGetChannelFingerprint(): NULL;
+    BrailleDriverCacheEntry *entry = findItem(cache, testBrailleDriverCacheEntry, brailleDevice);
+
+    if (entry) deleteItem(cache, entry);
+
+    if (addBrailleDriverCacheEntry(cache, brailleDevice, braille->definition.code, fingerprint)) {
+      saveBrailleDriverCache(cache);
+    }
+
+    if (fingerprint) free(fingerprint);
+    deallocateQueue(cache);
+  }
+}
+
 static int
 activateBrailleDriver (int verify) {
   int oneDevice = brailleDevices[0] && !brailleDevices[1];
+  int autodetect = isAutodetectingBrailleDriver();
   const char *const *device = (const char *const *)brailleDevices;
+  int activated = -1;
 
   if (!oneDevice) verify = 0;
+  if (verify) autodetect = 0;
 
-  while (*device) {
-    const char *const *autodetectableDrivers;
+  if (autodetect) {
+    if (activateCachedBrailleDriver()) return 1;
+  }
 
-    brailleDevice = *device;
-    logMessage(LOG_DEBUG, "checking braille device: %s", brailleDevice);
+#ifdef CAN_PROBE_BRAILLE_DEVICES_IN_PARALLEL
+  if (opt_parallelProbes && *device && !oneDevice) {
+    activated = probeBrailleDevices();
+  }
+#endif /* CAN_PROBE_BRAILLE_DEVICES_IN_PARALLEL */
 
-    {
-      const char *dev = brailleDevice;
+  if (activated == -1) {
+    activated = 0;
 
-      if (isSerialDevice(&dev)) {
-        static const char *const serialDrivers[] = {
-          "md", "pm", "ts", "ht", "bn", "al", "bm", "pg", "sk",
-          NULL
-        };
-        autodetectableDrivers = serialDrivers;
-      } else if (isUsbDevice(&dev)) {
-        static const char *const usbDrivers[] = {
-          "al", "bm", "eu", "fs", "ht", "hm", "hw", "mt", "pg", "pm", "sk", "vo",
-          NULL
-        };
-        autodetectableDrivers = usbDrivers;
-      } else if (isBluetoothDevice(&dev)) {
-        if (!(autodetectableDrivers = bthGetDriverCodes(dev, 5000))) {
-          static const char *bluetoothDrivers[] = {
-            "np", "ht", "al", "bm",
-            NULL
-          };
-          autodetectableDrivers = bluetoothDrivers;
-        }
-      } else {
-        static const char *noDrivers[] = {NULL};
-        autodetectableDrivers = noDrivers;
+    while (*device) {
+      if (activateBrailleDevice(*device, (const char *const *)brailleDrivers, verify)) {
+        activated = 1;
+        break;
       }
-    }
 
-    {
-      const DriverActivationData data = {
-        .driverType = "braille",
-        .requestedDrivers = (const char *const *)brailleDrivers,
-        .autodetectableDrivers = autodetectableDrivers,
-        .getDefaultDriver = getDefaultBrailleDriver,
-        .haveDriver = haveBrailleDriver,
-        .initializeDriver = initializeBrailleDriver
-      };
-      if (activateDriver(&data, verify)) return 1;
+      device += 1;
     }
+  }
 
-    device += 1;
+  if (!activated) {
+    brailleDevice = NULL;
+    return 0;
   }
 
-  brailleDevice = NULL;
-  return 0;
+  if (autodetect) cacheBrailleDriver();
+  return 1;
 }
 
 static void
@@ -1472,6 +1981,7 @@ deactivateSpeechDriver (void) {
 
 static int
 startSpeechDriver (void) {
+  setSpeechQueueEnabled(1);
   if (!activateSpeechDriver(0)) return 0;
   applySpeechPreferences();
 
@@ -1500,6 +2010,7 @@ trySpeechDriver (void) {
 
 static void
 stopSpeechDriver (void) {
+  discardSpeechRequests();
   speech->mute(&spk);
   deactivateSpeechDriver();
 }
@@ -2071,6 +2582,7 @@ brlttyStart (int argc, char *argv[]) {
 
   logMessage(LOG_INFO, "%s: %s", gettext("Writable Directory"), opt_writableDirectory);
   writableDirectory = opt_writableDirectory;
+  setTableCacheEnabled(1);
 
   logMessage(LOG_INFO, "%s: %s", gettext("Configuration File"), opt_configurationFile);
   logMessage(LOG_INFO, "%s: %s", gettext("Preferences File"), opt_preferencesFile);
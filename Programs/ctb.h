@@ -39,6 +39,16 @@ extern void contractText (
   int cursorOffset /* Position of coursor in source */
 );
 
+extern void prepareContractedText (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int inputLength,
+  int outputLength, int cursorOffset
+);
+
+extern void setContractionRuleChains (ContractionTable *contractionTable, int state);
+extern int isContractionTableExternal (ContractionTable *contractionTable);
+extern int isContractionPending (ContractionTable *contractionTable);
+
 extern char *ensureContractionTableExtension (const char *path);
 extern char *makeContractionTablePath (const char *directory, const char *name);
 
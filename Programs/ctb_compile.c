@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
  
 #include "log.h"
 #include "file.h"
@@ -169,6 +170,227 @@ saveCharacterTable (ContractionTableData *ctd) {
   return 1;
 }
 
+typedef struct RuleTrieNodeStruct RuleTrieNode;
+
+struct RuleTrieNodeStruct {
+  wchar_t character;
+
+  struct {
+    RuleTrieNode **array;
+    unsigned int size;
+    unsigned int count;
+  } children;
+
+  struct {
+    ContractionTableOffset *array;
+    unsigned int size;
+    unsigned int count;
+  } rules;
+};
+
+static RuleTrieNode *
+newRuleTrieNode (wchar_t character) {
+  RuleTrieNode *node;
+
+  if ((node = malloc(sizeof(*node)))) {
+    memset(node, 0, sizeof(*node));
+    node->character = character;
+    return node;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static void
+destroyRuleTrieNode (RuleTrieNode *node) {
+  while (node->children.count) destroyRuleTrieNode(node->children.array[--node->children.count]);
+  if (node->children.array) free(node->children.array);
+  if (node->rules.array) free(node->rules.array);
+  free(node);
+}
+
+static wchar_t
+foldRuleCharacter (wchar_t character) {
+  /* This must agree with the lowercase mapping used while translating. */
+  if (iswspace(character)) return character;
+  if (!iswalpha(character)) return character;
+  if (!iswupper(character)) return character;
+  return towlower(character);
+}
+
+static RuleTrieNode *
+getRuleTrieChild (RuleTrieNode *node, wchar_t character) {
+  int first = 0;
+  int last = node->children.count - 1;
+
+  while (first <= last) {
+    int current = (first + last) / 2;
+    RuleTrieNode *child = node->children.array[current];
+
+    if (child->character < character) {
+      first = current + 1;
+    } else if (child->character > character) {
+      last = current - 1;
+    } else {
+      return child;
+    }
+  }
+
+  if (node->children.count == node->children.size) {
+    unsigned int newSize = node->children.size? node->children.size<<1: 4;
+    RuleTrieNode **newArray = realloc(node->children.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      return NULL;
+    }
+
+    node->children.array = newArray;
+    node->children.size = newSize;
+  }
+
+  {
+    RuleTrieNode *child = newRuleTrieNode(character);
+    if (!child) return NULL;
+
+    memmove(&node->children.array[first+1],
+            &node->children.array[first],
+            ARRAY_SIZE(node->children.array, (node->children.count - first)));
+    node->children.array[first] = child;
+    node->children.count += 1;
+    return child;
+  }
+}
+
+static int
+addRuleTrieRule (RuleTrieNode *node, ContractionTableOffset offset) {
+  if (node->rules.count == node->rules.size) {
+    unsigned int newSize = node->rules.size? node->rules.size<<1: 2;
+    ContractionTableOffset *newArray = realloc(node->rules.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      return 0;
+    }
+
+    node->rules.array = newArray;
+    node->rules.size = newSize;
+  }
+
+  node->rules.array[node->rules.count++] = offset;
+  return 1;
+}
+
+static int
+saveRuleTrieNode (ContractionTableData *ctd, const RuleTrieNode *node, ContractionTableOffset *offset) {
+  DataOffset nodeOffset;
+  DataOffset branchesOffset = 0;
+  DataOffset rulesOffset = 0;
+
+  if (!allocateDataItem(ctd->area, &nodeOffset,
+                        sizeof(ContractionTableTrieNode),
+                        __alignof__(ContractionTableTrieNode)))
+    return 0;
+
+  if (node->rules.count) {
+    if (!saveDataItem(ctd->area, &rulesOffset, node->rules.array,
+                      ARRAY_SIZE(node->rules.array, node->rules.count),
+                      __alignof__(node->rules.array[0])))
+      return 0;
+  }
+
+  if (node->children.count) {
+    unsigned int index;
+
+    if (!allocateDataItem(ctd->area, &branchesOffset,
+                          node->children.count * sizeof(ContractionTableTrieBranch),
+                          __alignof__(ContractionTableTrieBranch)))
+      return 0;
+
+    for (index=0; index<node->children.count; index+=1) {
+      const RuleTrieNode *child = node->children.array[index];
+      ContractionTableOffset childOffset;
+
+      if (!saveRuleTrieNode(ctd, child, &childOffset)) return 0;
+
+      {
+        ContractionTableTrieBranch *branch = getDataItem(ctd->area, branchesOffset);
+
+        branch += index;
+        branch->character = child->character;
+        branch->node = childOffset;
+      }
+    }
+  }
+
+  {
+    ContractionTableTrieNode *ctn = getDataItem(ctd->area, nodeOffset);
+
+    ctn->branches = branchesOffset;
+    ctn->branchCount = node->children.count;
+    ctn->rules = rulesOffset;
+    ctn->ruleCount = node->rules.count;
+  }
+
+  *offset = nodeOffset;
+  return 1;
+}
+
+static int
+saveRuleTrie (ContractionTableData *ctd) {
+  int ok = 0;
+  RuleTrieNode *root;
+
+  if ((root = newRuleTrieNode(0))) {
+    unsigned int bucket;
+
+    for (bucket=0; bucket<HASHNUM; bucket+=1) {
+      ContractionTableOffset ruleOffset = getContractionTableHeader(ctd)->rules[bucket];
+
+      /* Walking each chain in order keeps the rules attached to any one node
+       * in the same order in which selectRule would have tested them. */
+      while (ruleOffset) {
+        const ContractionTableRule *rule = getDataItem(ctd->area, ruleOffset);
+        wchar_t characters[2];
+
+        characters[0] = foldRuleCharacter(rule->findrep[0]);
+        characters[1] = foldRuleCharacter(rule->findrep[1]);
+
+        /* The chain is looked up via the case-folded input, so a rule filed
+         * under a different bucket can never be selected - leave it out. */
+        if (CTH(characters) == bucket) {
+          RuleTrieNode *node = root;
+          unsigned int index;
+
+          for (index=0; index<rule->findlen; index+=1) {
+            if (!(node = getRuleTrieChild(node, foldRuleCharacter(rule->findrep[index])))) goto done;
+          }
+
+          if (!addRuleTrieRule(node, ruleOffset)) goto done;
+        }
+
+        ruleOffset = rule->next;
+      }
+    }
+
+    {
+      ContractionTableOffset offset;
+
+      if (saveRuleTrieNode(ctd, root, &offset)) {
+        getContractionTableHeader(ctd)->ruleTrie = offset;
+        ok = 1;
+      }
+    }
+
+  done:
+    destroyRuleTrieNode(root);
+  }
+
+  return ok;
+}
+
 static ContractionTableRule *
 addRule (
   DataFile *file,
@@ -541,6 +763,18 @@ startContractionCommand (ContractionTable *table) {
     if (runHostCommand(command, &options) != 0) return 0;
     logMessage(LOG_DEBUG, "external contraction table started: %s", table->command);
 
+#ifdef O_NONBLOCK
+    {
+      /* responses are collected as they arrive - see getExternalResponses */
+      int descriptor = fileno(table->data.external.standardOutput);
+      int flags = fcntl(descriptor, F_GETFL);
+
+      if ((flags == -1) || (fcntl(descriptor, F_SETFL, (flags | O_NONBLOCK)) == -1)) {
+        logSystemError("fcntl[F_SETFL]");
+      }
+    }
+#endif /* O_NONBLOCK */
+
     table->data.external.commandStarted = 1;
   }
 
@@ -556,25 +790,113 @@ stopContractionCommand (ContractionTable *table) {
     logMessage(LOG_DEBUG, "external contraction table stopped: %s", table->command);
     table->data.external.commandStarted = 0;
   }
+
+  table->data.external.requests.first = 0;
+  table->data.external.requests.sent = 0;
+  table->data.external.requests.count = 0;
+  table->data.external.requests.responding = 0;
+  table->data.external.response.length = 0;
+}
+
+static void
+destroyExternalRequests (ContractionTable *table) {
+  unsigned int index;
+
+  for (index=0; index<CTB_EXTERNAL_REQUESTS; index+=1) {
+    ContractionExternalRequest *request = &table->data.external.requests.entries[index];
+
+    if (request->input.characters) free(request->input.characters);
+    if (request->output.cells) free(request->output.cells);
+    if (request->offsets.array) free(request->offsets.array);
+  }
+
+  if (table->data.external.response.buffer) free(table->data.external.response.buffer);
+}
+
+static void
+initializeContractionCache (ContractionTable *table) {
+  ContractionCacheEntry *newer = NULL;
+  unsigned int index;
+
+  for (index=0; index<CTB_CACHE_ENTRIES; index+=1) {
+    ContractionCacheEntry *entry = &table->cache.entries[index];
+
+    entry->newerEntry = newer;
+    entry->olderEntry = NULL;
+    entry->bucketNext = NULL;
+    entry->hash = 0;
+    entry->active = 0;
+
+    entry->input.characters = NULL;
+    entry->input.size = 0;
+    entry->input.count = 0;
+
+    entry->output.cells = NULL;
+    entry->output.size = 0;
+    entry->output.count = 0;
+
+    entry->offsets.array = NULL;
+    entry->offsets.size = 0;
+    entry->offsets.count = 0;
+
+    if (newer) newer->olderEntry = entry;
+    newer = entry;
+  }
+
+  for (index=0; index<CTB_CACHE_BUCKETS; index+=1) {
+    table->cache.buckets[index] = NULL;
+  }
+
+  table->cache.newestEntry = &table->cache.entries[0];
+  table->cache.oldestEntry = newer;
+
+  table->cache.hits = 0;
+  table->cache.misses = 0;
+}
+
+static void
+destroyContractionCache (ContractionTable *table) {
+  unsigned int index;
+
+  if (table->cache.hits || table->cache.misses) {
+    logMessage(LOG_DEBUG, "contraction cache: %lu hits, %lu misses",
+               table->cache.hits, table->cache.misses);
+  }
+
+  for (index=0; index<CTB_CACHE_ENTRIES; index+=1) {
+    ContractionCacheEntry *entry = &table->cache.entries[index];
+
+    if (entry->input.characters) {
+      free(entry->input.characters);
+      entry->input.characters = NULL;
+    }
+
+    if (entry->output.cells) {
+      free(entry->output.cells);
+      entry->output.cells = NULL;
+    }
+
+    if (entry->offsets.array) {
+      free(entry->offsets.array);
+      entry->offsets.array = NULL;
+    }
+
+    entry->active = 0;
+  }
+
+  for (index=0; index<CTB_CACHE_BUCKETS; index+=1) {
+    table->cache.buckets[index] = NULL;
+  }
 }
 
 static void
 initializeCommonFields (ContractionTable *table) {
+  table->characters.dense = NULL;
   table->characters.array = NULL;
   table->characters.size = 0;
   table->characters.count = 0;
 
-  table->cache.input.characters = NULL;
-  table->cache.input.size = 0;
-  table->cache.input.count = 0;
-
-  table->cache.output.cells = NULL;
-  table->cache.output.size = 0;
-  table->cache.output.count = 0;
-
-  table->cache.offsets.array = NULL;
-  table->cache.offsets.size = 0;
-  table->cache.offsets.count = 0;
+  initializeContractionCache(table);
 }
 
 ContractionTable *
@@ -606,6 +928,28 @@ compileContractionTable (const char *fileName) {
     return NULL;
   }
 
+  {
+    TableCache *cache = openTableCache(fileName, CONTRACTION_TABLE_EXTENSION, CONTRACTION_TABLE_CACHE_FORMAT);
+
+    if (cache) {
+      if ((table = malloc(sizeof(*table)))) {
+        initializeCommonFields(table);
+        table->command = NULL;
+
+        table->data.internal.header.bytes = getTableCacheImage(cache, &table->data.internal.size);
+        table->data.internal.cache = cache;
+        table->data.internal.ruleChains = 0;
+        return table;
+      } else {
+        logMallocError();
+      }
+
+      closeTableCache(cache);
+    }
+  }
+
+  startTableCacheDependencies();
+
   if (setGlobalTableVariables(CONTRACTION_TABLE_EXTENSION, CONTRACTION_SUBTABLE_EXTENSION)) {
     ContractionTableData ctd;
     memset(&ctd, 0, sizeof(ctd));
@@ -628,14 +972,19 @@ compileContractionTable (const char *fileName) {
       if (allocateDataItem(ctd.area, NULL, sizeof(ContractionTableHeader), __alignof__(ContractionTableHeader))) {
         if (allocateCharacterClasses(&ctd)) {
           if (processDataFile(fileName, processContractionTableLine, &ctd)) {
-            if (saveCharacterTable(&ctd)) {
+            if (saveCharacterTable(&ctd) && saveRuleTrie(&ctd)) {
               if ((table = malloc(sizeof(*table)))) {
                 initializeCommonFields(table);
                 table->command = NULL;
 
                 table->data.internal.header.fields = getContractionTableHeader(&ctd);
                 table->data.internal.size = getDataSize(ctd.area);
+                table->data.internal.cache = NULL;
+                table->data.internal.ruleChains = 0;
                 resetDataArea(ctd.area);
+
+                saveTableCache(fileName, CONTRACTION_TABLE_EXTENSION, CONTRACTION_TABLE_CACHE_FORMAT,
+                               table->data.internal.header.bytes, table->data.internal.size);
               } else {
                 logMallocError();
               }
@@ -652,38 +1001,52 @@ compileContractionTable (const char *fileName) {
     if (ctd.characterTable) free(ctd.characterTable);
   }
 
+  stopTableCacheDependencies();
   return table;
 }
 
 void
-destroyContractionTable (ContractionTable *table) {
-  if (table->characters.array) {
-    free(table->characters.array);
-    table->characters.array = NULL;
-  }
+setContractionRuleChains (ContractionTable *table, int state) {
+  if (!table->command) {
+    state = !!state;
 
-  if (table->cache.input.characters) {
-    free(table->cache.input.characters);
-    table->cache.input.characters = NULL;
+    if (state != table->data.internal.ruleChains) {
+      /* the cached contractions were made the other way */
+      destroyContractionCache(table);
+      initializeContractionCache(table);
+
+      table->data.internal.ruleChains = state;
+    }
   }
+}
 
-  if (table->cache.output.cells) {
-    free(table->cache.output.cells);
-    table->cache.output.cells = NULL;
+void
+destroyContractionTable (ContractionTable *table) {
+  if (table->characters.dense) {
+    free(table->characters.dense);
+    table->characters.dense = NULL;
   }
 
-  if (table->cache.offsets.array) {
-    free(table->cache.offsets.array);
-    table->cache.offsets.array = NULL;
+  if (table->characters.array) {
+    free(table->characters.array);
+    table->characters.array = NULL;
   }
 
+  destroyContractionCache(table);
+
   if (table->command) {
     stopContractionCommand(table);
+    destroyExternalRequests(table);
     free(table->command);
     free(table);
   } else {
     if (table->data.internal.size) {
-      free(table->data.internal.header.fields);
+      if (table->data.internal.cache) {
+        closeTableCache(table->data.internal.cache);
+      } else {
+        free(table->data.internal.header.fields);
+      }
+
       free(table);
     }
   }
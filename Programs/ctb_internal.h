@@ -21,6 +21,8 @@
 
 #include <stdio.h>
 
+#include "tblcache.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -32,6 +34,9 @@ extern "C" {
 
 typedef uint32_t ContractionTableOffset;
 
+/* change this whenever the layout of the compiled table changes */
+#define CONTRACTION_TABLE_CACHE_FORMAT 1
+
 typedef enum {
   CTC_Space       = 0X01,
   CTC_Letter      = 0X02,
@@ -101,6 +106,18 @@ typedef struct {
   wchar_t findrep[1]; /*find and replacement strings*/
 } ContractionTableRule;
 
+typedef struct {
+  wchar_t character; /*case-folded character*/
+  ContractionTableOffset node; /*node reached via this character*/
+} ContractionTableTrieBranch;
+
+typedef struct {
+  ContractionTableOffset branches; /*branches sorted by character*/
+  ContractionTableOffset rules; /*rules whose find string ends here, in chain order*/
+  uint32_t branchCount;
+  uint32_t ruleCount;
+} ContractionTableTrieNode;
+
 typedef struct {
   ContractionTableOffset capitalSign; /*capitalization sign*/
   ContractionTableOffset beginCapitalSign; /*begin capitals sign*/
@@ -110,6 +127,7 @@ typedef struct {
   ContractionTableOffset characters;
   uint32_t characterCount;
   ContractionTableOffset rules[HASHNUM]; /*locations of multi-character rules in table*/
+  ContractionTableOffset ruleTrie; /*case-folded trie of multi-character rules*/
 } ContractionTableHeader;
 
 typedef struct {
@@ -119,37 +137,92 @@ typedef struct {
   ContractionTableCharacterAttributes attributes;
 } CharacterEntry;
 
+/* Latin, IPA, Greek, Cyrillic, Armenian, Hebrew, Arabic, Syriac, Thaana */
+#define CTB_DENSE_CHARACTERS 0X800
+
+#define CTB_CACHE_ENTRIES 0X20
+#define CTB_CACHE_BUCKETS 0X1F
+
+typedef struct ContractionCacheEntryStruct ContractionCacheEntry;
+
+struct ContractionCacheEntryStruct {
+  ContractionCacheEntry *newerEntry; /*toward the most recently used entry*/
+  ContractionCacheEntry *olderEntry; /*toward the least recently used entry*/
+  ContractionCacheEntry *bucketNext; /*next entry with the same hash bucket*/
+  unsigned int hash;
+  unsigned active:1;
+
+  struct {
+    wchar_t *characters;
+    unsigned int size;
+    unsigned int count;
+    unsigned int consumed;
+  } input;
+
+  struct {
+    unsigned char *cells;
+    unsigned int size;
+    unsigned int count;
+    unsigned int maximum;
+  } output;
+
+  struct {
+    int *array;
+    unsigned int size;
+    unsigned int count;
+  } offsets;
+
+  int cursorOffset;
+  unsigned char expandCurrentWord;
+  unsigned char capitalizationMode;
+};
+
+#define CTB_EXTERNAL_REQUESTS 0X10
+#define CTB_EXTERNAL_TIMEOUT 100
+
+typedef struct {
+  unsigned int identifier;
+  unsigned int hash;
+  unsigned awaited:1;
+
+  struct {
+    wchar_t *characters;
+    unsigned int size;
+    unsigned int count;
+  } input;
+
+  struct {
+    unsigned char *cells;
+    unsigned int size;
+    unsigned int maximum;
+  } output;
+
+  struct {
+    int *array;
+    unsigned int size;
+  } offsets;
+
+  int cursorOffset;
+  unsigned char expandCurrentWord;
+  unsigned char capitalizationMode;
+} ContractionExternalRequest;
+
 struct ContractionTableStruct {
   struct {
-    CharacterEntry *array;
+    CharacterEntry *dense; /*indexed by character below CTB_DENSE_CHARACTERS*/
+    CharacterEntry *array; /*sorted, filled in on demand for the rest*/
     int size;
     int count;
   } characters;
 
   struct {
-    struct {
-      wchar_t *characters;
-      unsigned int size;
-      unsigned int count;
-      unsigned int consumed;
-    } input;
+    ContractionCacheEntry entries[CTB_CACHE_ENTRIES];
+    ContractionCacheEntry *buckets[CTB_CACHE_BUCKETS];
+    ContractionCacheEntry *newestEntry;
+    ContractionCacheEntry *oldestEntry;
 
-    struct {
-      unsigned char *cells;
-      unsigned int size;
-      unsigned int count;
-      unsigned int maximum;
-    } output;
-
-    struct {
-      int *array;
-      unsigned int size;
-      unsigned int count;
-    } offsets;
-
-    int cursorOffset;
-    unsigned char expandCurrentWord;
-    unsigned char capitalizationMode;
+    unsigned long int hits;
+    unsigned long int misses;
   } cache;
 
   char *command;
@@ -162,12 +235,29 @@ struct ContractionTableStruct {
       } header;
 
       size_t size;
+      TableCache *cache;
+      unsigned ruleChains:1; /*look multi-character rules up via the hash chains rather than the trie*/
     } internal;
 
     struct {
       unsigned commandStarted:1;
       FILE *standardInput;
       FILE *standardOutput;
+
+      struct {
+        ContractionExternalRequest entries[CTB_EXTERNAL_REQUESTS];
+        unsigned int first; /*the oldest request*/
+        unsigned int sent; /*written to the command, awaiting a response*/
+        unsigned int count; /*including those not yet written*/
+        unsigned int identifier; /*of the most recent request*/
+        unsigned responding:1; /*a response to the oldest one is being read*/
+      } requests;
+
+      struct {
+        char *buffer;
+        size_t size;
+        size_t length;
+      } response;
     } external;
   } data;
 };
@@ -20,6 +20,11 @@
 
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif /* HAVE_SYS_POLL_H */
 
 #ifdef HAVE_ICU
 #include <unicode/uchar.h>
@@ -36,6 +41,7 @@
 #include "log.h"
 #include "file.h"
 #include "parse.h"
+#include "timing.h"
 
 static ContractionTable *table;
 static const wchar_t *src, *srcmin, *srcmax, *cursor;
@@ -95,77 +101,107 @@ getContractionTableCharacter (wchar_t character) {
   return NULL;
 }
 
-static CharacterEntry *
-getCharacterEntry (wchar_t character) {
-  int first = 0;
-  int last = table->characters.count - 1;
-
-  while (first <= last) {
-    int current = (first + last) / 2;
-    CharacterEntry *entry = &table->characters.array[current];
+static void
+initializeCharacterEntry (CharacterEntry *entry, wchar_t character) {
+  memset(entry, 0, sizeof(*entry));
+  entry->value = entry->uppercase = entry->lowercase = character;
+
+  if (iswspace(character)) {
+    entry->attributes |= CTC_Space;
+  } else if (iswalpha(character)) {
+    entry->attributes |= CTC_Letter;
+
+    if (iswupper(character)) {
+      entry->attributes |= CTC_UpperCase;
+      entry->lowercase = towlower(character);
+    }
 
-    if (entry->value < character) {
-      first = current + 1;
-    } else if (entry->value > character) {
-      last = current - 1;
-    } else {
-      return entry;
+    if (iswlower(character)) {
+      entry->attributes |= CTC_LowerCase;
+      entry->uppercase = towupper(character);
     }
+  } else if (iswdigit(character)) {
+    entry->attributes |= CTC_Digit;
+  } else if (iswpunct(character)) {
+    entry->attributes |= CTC_Punctuation;
   }
 
-  if (table->characters.count == table->characters.size) {
-    int newSize = table->characters.size;
-    newSize = newSize? newSize<<1: 0X80;
+  if (!table->command) {
+    const ContractionTableCharacter *ctc = getContractionTableCharacter(character);
+    if (ctc) entry->attributes |= ctc->attributes;
+  }
+}
 
-    {
-      CharacterEntry *newArray = realloc(table->characters.array, (newSize * sizeof(*newArray)));
+static void
+prepareDenseCharacterEntries (void) {
+  if (!table->characters.dense) {
+    CharacterEntry *entries;
 
-      if (!newArray) {
-        logMallocError();
-        return NULL;
+    if ((entries = malloc(ARRAY_SIZE(entries, CTB_DENSE_CHARACTERS)))) {
+      wchar_t character;
+
+      for (character=0; character<CTB_DENSE_CHARACTERS; character+=1) {
+        initializeCharacterEntry(&entries[character], character);
       }
 
-      table->characters.array = newArray;
-      table->characters.size = newSize;
+      table->characters.dense = entries;
+    } else {
+      logMallocError();
     }
   }
+}
 
-  memmove(&table->characters.array[first+1],
-          &table->characters.array[first],
-          (table->characters.count - first) * sizeof(*table->characters.array));
-  table->characters.count += 1;
+static CharacterEntry *
+getCharacterEntry (wchar_t character) {
+  if (((uint32_t)character < CTB_DENSE_CHARACTERS) && table->characters.dense) {
+    return &table->characters.dense[character];
+  }
 
   {
-    CharacterEntry *entry = &table->characters.array[first];
-    memset(entry, 0, sizeof(*entry));
-    entry->value = entry->uppercase = entry->lowercase = character;
-
-    if (iswspace(character)) {
-      entry->attributes |= CTC_Space;
-    } else if (iswalpha(character)) {
-      entry->attributes |= CTC_Letter;
-
-      if (iswupper(character)) {
-        entry->attributes |= CTC_UpperCase;
-        entry->lowercase = towlower(character);
-      }
+    int first = 0;
+    int last = table->characters.count - 1;
+
+    while (first <= last) {
+      int current = (first + last) / 2;
+      CharacterEntry *entry = &table->characters.array[current];
 
-      if (iswlower(character)) {
-        entry->attributes |= CTC_LowerCase;
-        entry->uppercase = towupper(character);
+      if (entry->value < character) {
+        first = current + 1;
+      } else if (entry->value > character) {
+        last = current - 1;
+      } else {
+        return entry;
       }
-    } else if (iswdigit(character)) {
-      entry->attributes |= CTC_Digit;
-    } else if (iswpunct(character)) {
-      entry->attributes |= CTC_Punctuation;
     }
 
-    if (!table->command) {
-      const ContractionTableCharacter *ctc = getContractionTableCharacter(character);
-      if (ctc) entry->attributes |= ctc->attributes;
+    if (table->characters.count == table->characters.size) {
+      int newSize = table->characters.size;
+      newSize = newSize? newSize<<1: 0X80;
+
+      {
+        CharacterEntry *newArray = realloc(table->characters.array, (newSize * sizeof(*newArray)));
+
+        if (!newArray) {
+          logMallocError();
+          return NULL;
+        }
+
+        table->characters.array = newArray;
+        table->characters.size = newSize;
+      }
     }
 
-    return entry;
+    memmove(&table->characters.array[first+1],
+            &table->characters.array[first],
+            (table->characters.count - first) * sizeof(*table->characters.array));
+    table->characters.count += 1;
+
+    {
+      CharacterEntry *entry = &table->characters.array[first];
+
+      initializeCharacterEntry(entry, character);
+      return entry;
+    }
   }
 }
 
@@ -234,192 +270,187 @@ isEnding (void) {
 }
 
 static int
-selectRule (int length) {
-  int ruleOffset;
-  int maximumLength;
+testCurrentRule (int *maximumLength) {
+  setAfter(currentFindLength);
 
-  if (length < 1) return 0;
-  if (length == 1) {
-    const ContractionTableCharacter *ctc = getContractionTableCharacter(toLowerCase(*src));
-    if (!ctc) return 0;
-    ruleOffset = ctc->rules;
-    maximumLength = 1;
-  } else {
-    wchar_t characters[2];
-    characters[0] = toLowerCase(src[0]);
-    characters[1] = toLowerCase(src[1]);
-    ruleOffset = getContractionTableHeader()->rules[CTH(characters)];
-    maximumLength = 0;
-  }
+  if (!*maximumLength) {
+    *maximumLength = currentFindLength;
 
-  while (ruleOffset) {
-    currentRule = getContractionTableItem(ruleOffset);
-    currentOpcode = currentRule->opcode;
-    currentFindLength = currentRule->findlen;
+    if (prefs.capitalizationMode != CTB_CAP_NONE) {
+      typedef enum {CS_Any, CS_Lower, CS_UpperSingle, CS_UpperMultiple} CapitalizationState;
+#define STATE(c) (testCharacter((c), CTC_UpperCase)? CS_UpperSingle: testCharacter((c), CTC_LowerCase)? CS_Lower: CS_Any)
 
-    if ((length == 1) ||
-        ((currentFindLength <= length) &&
-         checkCurrentRule(src))) {
-      setAfter(currentFindLength);
+      CapitalizationState current = STATE(before);
+      int i;
 
-      if (!maximumLength) {
-        maximumLength = currentFindLength;
+      for (i=0; i<currentFindLength; i+=1) {
+        wchar_t character = src[i];
+        CapitalizationState next = STATE(character);
 
-        if (prefs.capitalizationMode != CTB_CAP_NONE) {
-          typedef enum {CS_Any, CS_Lower, CS_UpperSingle, CS_UpperMultiple} CapitalizationState;
-#define STATE(c) (testCharacter((c), CTC_UpperCase)? CS_UpperSingle: testCharacter((c), CTC_LowerCase)? CS_Lower: CS_Any)
+        if (i > 0) {
+          if (((current == CS_Lower) && (next == CS_UpperSingle)) ||
+              ((current == CS_UpperMultiple) && (next == CS_Lower))) {
+            *maximumLength = i;
+            break;
+          }
+
+          if ((prefs.capitalizationMode != CTB_CAP_SIGN) &&
+              (next == CS_UpperSingle)) {
+            *maximumLength = i;
+            break;
+          }
+        }
+
+        if ((prefs.capitalizationMode == CTB_CAP_SIGN) && (current > CS_Lower) && (next == CS_UpperSingle)) {
+          current = CS_UpperMultiple;
+        } else if (next != CS_Any) {
+          current = next;
+        } else if (current == CS_Any) {
+          current = CS_Lower;
+        }
+      }
 
-          CapitalizationState current = STATE(before);
-          int i;
+#undef STATE
+    }
+  }
 
-          for (i=0; i<currentFindLength; i+=1) {
-            wchar_t character = src[i];
-            CapitalizationState next = STATE(character);
+  if ((currentFindLength <= *maximumLength) &&
+      (!currentRule->after || testCharacter(before, currentRule->after)) &&
+      (!currentRule->before || testCharacter(after, currentRule->before))) {
+    switch (currentOpcode) {
+      case CTO_Always:
+      case CTO_Repeatable:
+      case CTO_Literal:
+        return 1;
 
-            if (i > 0) {
-              if (((current == CS_Lower) && (next == CS_UpperSingle)) ||
-                  ((current == CS_UpperMultiple) && (next == CS_Lower))) {
-                maximumLength = i;
-                break;
-              }
+      case CTO_LargeSign:
+      case CTO_LastLargeSign:
+        if (!isBeginning() || !isEnding()) currentOpcode = CTO_Always;
+        return 1;
 
-              if ((prefs.capitalizationMode != CTB_CAP_SIGN) &&
-                  (next == CS_UpperSingle)) {
-                maximumLength = i;
-                break;
-              }
-            }
+      case CTO_WholeWord:
+      case CTO_Contraction:
+        if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
+            testCharacter(after, CTC_Space|CTC_Punctuation))
+          return 1;
+        break;
+
+      case CTO_LowWord:
+        if (testCharacter(before, CTC_Space) && testCharacter(after, CTC_Space) &&
+            (previousOpcode != CTO_JoinedWord) &&
+            ((dest == destmin) || !dest[-1]))
+          return 1;
+        break;
 
-            if ((prefs.capitalizationMode == CTB_CAP_SIGN) && (current > CS_Lower) && (next == CS_UpperSingle)) {
-              current = CS_UpperMultiple;
-            } else if (next != CS_Any) {
-              current = next;
-            } else if (current == CS_Any) {
-              current = CS_Lower;
+      case CTO_JoinedWord:
+        if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
+            (before != '-') &&
+            (dest + currentRule->replen < destmax)) {
+          const wchar_t *end = src + currentFindLength;
+          const wchar_t *ptr = end;
+
+          while (ptr < srcmax) {
+            if (!testCharacter(*ptr, CTC_Space)) {
+              if (!testCharacter(*ptr, CTC_Letter)) break;
+              if (ptr == end) break;
+              return 1;
             }
-          }
 
-#undef STATE
+            if (ptr++ == cursor) break;
+          }
         }
-      }
+        break;
 
-      if ((currentFindLength <= maximumLength) &&
-          (!currentRule->after || testCharacter(before, currentRule->after)) &&
-          (!currentRule->before || testCharacter(after, currentRule->before))) {
-        switch (currentOpcode) {
-          case CTO_Always:
-          case CTO_Repeatable:
-          case CTO_Literal:
-            return 1;
-
-          case CTO_LargeSign:
-          case CTO_LastLargeSign:
-            if (!isBeginning() || !isEnding()) currentOpcode = CTO_Always;
-            return 1;
-
-          case CTO_WholeWord:
-          case CTO_Contraction:
-            if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
-                testCharacter(after, CTC_Space|CTC_Punctuation))
-              return 1;
-            break;
+      case CTO_SuffixableWord:
+        if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
+            testCharacter(after, CTC_Space|CTC_Letter|CTC_Punctuation))
+          return 1;
+        break;
 
-          case CTO_LowWord:
-            if (testCharacter(before, CTC_Space) && testCharacter(after, CTC_Space) &&
-                (previousOpcode != CTO_JoinedWord) &&
-                ((dest == destmin) || !dest[-1]))
-              return 1;
-            break;
+      case CTO_PrefixableWord:
+        if (testCharacter(before, CTC_Space|CTC_Letter|CTC_Punctuation) &&
+            testCharacter(after, CTC_Space|CTC_Punctuation))
+          return 1;
+        break;
 
-          case CTO_JoinedWord:
-            if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
-                (before != '-') &&
-                (dest + currentRule->replen < destmax)) {
-              const wchar_t *end = src + currentFindLength;
-              const wchar_t *ptr = end;
-
-              while (ptr < srcmax) {
-                if (!testCharacter(*ptr, CTC_Space)) {
-                  if (!testCharacter(*ptr, CTC_Letter)) break;
-                  if (ptr == end) break;
-                  return 1;
-                }
-
-                if (ptr++ == cursor) break;
-              }
-            }
-            break;
+      case CTO_BegWord:
+        if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
+            testCharacter(after, CTC_Letter))
+          return 1;
+        break;
 
-          case CTO_SuffixableWord:
-            if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
-                testCharacter(after, CTC_Space|CTC_Letter|CTC_Punctuation))
-              return 1;
-            break;
+      case CTO_BegMidWord:
+        if (testCharacter(before, CTC_Letter|CTC_Space|CTC_Punctuation) &&
+            testCharacter(after, CTC_Letter))
+          return 1;
+        break;
 
-          case CTO_PrefixableWord:
-            if (testCharacter(before, CTC_Space|CTC_Letter|CTC_Punctuation) &&
-                testCharacter(after, CTC_Space|CTC_Punctuation))
-              return 1;
-            break;
+      case CTO_MidWord:
+        if (testCharacter(before, CTC_Letter) && testCharacter(after, CTC_Letter))
+          return 1;
+        break;
 
-          case CTO_BegWord:
-            if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
-                testCharacter(after, CTC_Letter))
-              return 1;
-            break;
+      case CTO_MidEndWord:
+        if (testCharacter(before, CTC_Letter) &&
+            testCharacter(after, CTC_Letter|CTC_Space|CTC_Punctuation))
+          return 1;
+        break;
 
-          case CTO_BegMidWord:
-            if (testCharacter(before, CTC_Letter|CTC_Space|CTC_Punctuation) &&
-                testCharacter(after, CTC_Letter))
-              return 1;
-            break;
+      case CTO_EndWord:
+        if (testCharacter(before, CTC_Letter) &&
+            testCharacter(after, CTC_Space|CTC_Punctuation))
+          return 1;
+        break;
 
-          case CTO_MidWord:
-            if (testCharacter(before, CTC_Letter) && testCharacter(after, CTC_Letter))
-              return 1;
-            break;
+      case CTO_BegNum:
+        if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
+            testCharacter(after, CTC_Digit))
+          return 1;
+        break;
 
-          case CTO_MidEndWord:
-            if (testCharacter(before, CTC_Letter) &&
-                testCharacter(after, CTC_Letter|CTC_Space|CTC_Punctuation))
-              return 1;
-            break;
+      case CTO_MidNum:
+        if (testCharacter(before, CTC_Digit) && testCharacter(after, CTC_Digit))
+          return 1;
+        break;
 
-          case CTO_EndWord:
-            if (testCharacter(before, CTC_Letter) &&
-                testCharacter(after, CTC_Space|CTC_Punctuation))
-              return 1;
-            break;
+      case CTO_EndNum:
+        if (testCharacter(before, CTC_Digit) &&
+            testCharacter(after, CTC_Space|CTC_Punctuation))
+          return 1;
+        break;
 
-          case CTO_BegNum:
-            if (testCharacter(before, CTC_Space|CTC_Punctuation) &&
-                testCharacter(after, CTC_Digit))
-              return 1;
-            break;
+      case CTO_PrePunc:
+        if (testCharacter(*src, CTC_Punctuation) && isBeginning() && !isEnding()) return 1;
+        break;
 
-          case CTO_MidNum:
-            if (testCharacter(before, CTC_Digit) && testCharacter(after, CTC_Digit))
-              return 1;
-            break;
+      case CTO_PostPunc:
+        if (testCharacter(*src, CTC_Punctuation) && !isBeginning() && isEnding()) return 1;
+        break;
 
-          case CTO_EndNum:
-            if (testCharacter(before, CTC_Digit) &&
-                testCharacter(after, CTC_Space|CTC_Punctuation))
-              return 1;
-            break;
+      default:
+        break;
+    }
+  }
 
-          case CTO_PrePunc:
-            if (testCharacter(*src, CTC_Punctuation) && isBeginning() && !isEnding()) return 1;
-            break;
+  return 0;
+}
 
-          case CTO_PostPunc:
-            if (testCharacter(*src, CTC_Punctuation) && !isBeginning() && isEnding()) return 1;
-            break;
+static void
+setCurrentRule (ContractionTableOffset ruleOffset) {
+  currentRule = getContractionTableItem(ruleOffset);
+  currentOpcode = currentRule->opcode;
+  currentFindLength = currentRule->findlen;
+}
 
-          default:
-            break;
-        }
-      }
+static int
+selectChainedRule (ContractionTableOffset ruleOffset, int length, int *maximumLength) {
+  while (ruleOffset) {
+    setCurrentRule(ruleOffset);
+
+    if ((length == 1) ||
+        ((currentFindLength <= length) &&
+         checkCurrentRule(src))) {
+      if (testCurrentRule(maximumLength)) return 1;
     }
 
     ruleOffset = currentRule->next;
@@ -428,6 +459,85 @@ selectRule (int length) {
   return 0;
 }
 
+static const ContractionTableTrieNode *
+getTrieBranch (const ContractionTableTrieNode *node, wchar_t character) {
+  const ContractionTableTrieBranch *branches = getContractionTableItem(node->branches);
+  int first = 0;
+  int last = node->branchCount - 1;
+
+  while (first <= last) {
+    int current = (first + last) / 2;
+    const ContractionTableTrieBranch *branch = &branches[current];
+
+    if (branch->character < character) {
+      first = current + 1;
+    } else if (branch->character > character) {
+      last = current - 1;
+    } else {
+      return getContractionTableItem(branch->node);
+    }
+  }
+
+  return NULL;
+}
+
+static int
+selectTrieRule (int length, int *maximumLength) {
+  const ContractionTableTrieNode *path[UINT8_MAX + 1];
+  const ContractionTableTrieNode *node = getContractionTableItem(getContractionTableHeader()->ruleTrie);
+  int depth = 0;
+
+  if (length > UINT8_MAX) length = UINT8_MAX;
+
+  /* Walk the case-folded input once, remembering every node on the way,
+   * and then try the rules from the longest match down to the shortest. */
+  while (depth < length) {
+    if (!(node = getTrieBranch(node, toLowerCase(src[depth])))) break;
+    path[++depth] = node;
+  }
+
+  while (depth > 1) {
+    node = path[depth--];
+
+    if (node->ruleCount) {
+      const ContractionTableOffset *rules = getContractionTableItem(node->rules);
+      unsigned int index;
+
+      for (index=0; index<node->ruleCount; index+=1) {
+        setCurrentRule(rules[index]);
+        if (testCurrentRule(maximumLength)) return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int
+selectRule (int length) {
+  int maximumLength = 0;
+
+  if (length < 1) return 0;
+
+  if (length == 1) {
+    const ContractionTableCharacter *ctc = getContractionTableCharacter(toLowerCase(*src));
+    if (!ctc) return 0;
+    maximumLength = 1;
+    return selectChainedRule(ctc->rules, length, &maximumLength);
+  }
+
+  if (getContractionTableHeader()->ruleTrie && !table->data.internal.ruleChains) {
+    return selectTrieRule(length, &maximumLength);
+  }
+
+  {
+    wchar_t characters[2];
+    characters[0] = toLowerCase(src[0]);
+    characters[1] = toLowerCase(src[1]);
+    return selectChainedRule(getContractionTableHeader()->rules[CTH(characters)], length, &maximumLength);
+  }
+}
+
 static int
 putCells (const BYTE *cells, int count) {
   if (dest + count > destmax) return 0;
@@ -1160,7 +1270,7 @@ done:
 }
 
 static int
-putExternalRequests (void) {
+putExternalRequest (const ContractionExternalRequest *request) {
   typedef enum {
     REQ_TEXT,
     REQ_NUMBER
@@ -1181,31 +1291,36 @@ putExternalRequests (void) {
   } ExternalRequestEntry;
 
   const ExternalRequestEntry externalRequestTable[] = {
+    { .name = "request-id",
+      .type = REQ_NUMBER,
+      .value.number = request->identifier
+    },
+
     { .name = "cursor-position",
       .type = REQ_NUMBER,
-      .value.number = cursor? cursor-srcmin+1: 0
+      .value.number = (request->cursorOffset == CTB_NO_CURSOR)? 0: request->cursorOffset+1
     },
 
     { .name = "expand-current-word",
       .type = REQ_NUMBER,
-      .value.number = prefs.expandCurrentWord
+      .value.number = request->expandCurrentWord
     },
 
     { .name = "capitalization-mode",
       .type = REQ_NUMBER,
-      .value.number = prefs.capitalizationMode
+      .value.number = request->capitalizationMode
     },
 
     { .name = "maximum-length",
       .type = REQ_NUMBER,
-      .value.number = destmax - destmin
+      .value.number = request->output.maximum
     },
 
     { .name = "text",
       .type = REQ_TEXT,
       .value.text = {
-        .start = srcmin,
-        .count = srcmax - srcmin
+        .start = request->input.characters,
+        .count = request->input.count
       }
     },
 
@@ -1248,7 +1363,6 @@ putExternalRequests (void) {
     req += 1;
   }
 
-  if (fflush(stream) == EOF) goto outputError;
   return 1;
 
 outputError:
@@ -1400,198 +1514,683 @@ handleExternalResponse_outputOffsets (const char *value) {
   return 1;
 }
 
-typedef struct {
-  const char *name;
-  int (*handler) (const char *value);
-  unsigned stop:1;
-} ExternalResponseEntry;
+static inline unsigned int
+makeCachedInputCount (void) {
+  return srcmax - srcmin;
+}
 
-static const ExternalResponseEntry externalResponseTable[] = {
-  { .name = "brf",
-    .stop = 1,
-    .handler = handleExternalResponse_brf
-  },
+static inline unsigned int
+makeCachedOutputMaximum (void) {
+  return destmax - destmin;
+}
 
-  { .name = "consumed-length",
-    .handler = handleExternalResponse_consumedLength
-  },
+static inline int
+makeCachedCursorOffset (void) {
+  return cursor? (cursor - srcmin): CTB_NO_CURSOR;
+}
 
-  { .name = "output-offsets",
-    .handler = handleExternalResponse_outputOffsets
-  },
+static unsigned int
+makeCacheHash (void) {
+  unsigned int hash = 2166136261U;
 
-  { .name = NULL }
-};
+#define HASH_VALUE(value) (hash = (hash ^ (unsigned int)(value)) * 16777619U)
+  HASH_VALUE(makeCachedInputCount());
+  HASH_VALUE(makeCachedOutputMaximum());
+  HASH_VALUE(makeCachedCursorOffset());
+  HASH_VALUE(prefs.expandCurrentWord);
+  HASH_VALUE(prefs.capitalizationMode);
 
-static int
-getExternalResponses (void) {
-  static char *buffer = NULL;
-  static size_t size = 0;
+  {
+    const wchar_t *character = srcmin;
 
-  FILE *stream = table->data.external.standardOutput;
+    while (character < srcmax) HASH_VALUE(*character++);
+  }
+#undef HASH_VALUE
 
-  while (readLine(stream, &buffer, &size)) {
-    int ok = 0;
-    int stop = 0;
-    char *delimiter = strchr(buffer, '=');
+  return hash;
+}
 
-    if (delimiter) {
-      const char *value = delimiter + 1;
-      const ExternalResponseEntry *rsp = externalResponseTable;
+static inline ContractionCacheEntry **
+getCacheBucket (unsigned int hash) {
+  return &table->cache.buckets[hash % CTB_CACHE_BUCKETS];
+}
 
-      char oldDelimiter = *delimiter;
-      *delimiter = 0;
+static int
+isCacheEntry (const ContractionCacheEntry *entry, unsigned int hash) {
+  if (entry->hash != hash) return 0;
+  if (entry->output.maximum != makeCachedOutputMaximum()) return 0;
+  if (entry->cursorOffset != makeCachedCursorOffset()) return 0;
+  if (entry->expandCurrentWord != prefs.expandCurrentWord) return 0;
+  if (entry->capitalizationMode != prefs.capitalizationMode) return 0;
 
-      while (rsp->name) {
-        if (strcmp(buffer, rsp->name) == 0) {
-          if (rsp->handler(value)) ok = 1;
-          if (rsp->stop) stop = 1;
-          break;
-        }
+  {
+    unsigned int count = makeCachedInputCount();
+    if (entry->input.count != count) return 0;
+    if (wmemcmp(srcmin, entry->input.characters, count) != 0) return 0;
+  }
 
-        rsp += 1;
-      }
+  return 1;
+}
 
-      *delimiter = oldDelimiter;
-    }
+static ContractionCacheEntry *
+findCacheEntry (unsigned int hash) {
+  ContractionCacheEntry *entry = *getCacheBucket(hash);
 
-    if (!ok) logMessage(LOG_WARNING, "unexpected external contraction response: %s: %s", table->command, buffer);
-    if (stop) return 1;
+  while (entry) {
+    if (isCacheEntry(entry, hash)) return entry;
+    entry = entry->bucketNext;
   }
 
-  logMessage(LOG_WARNING, "incomplete external contraction response: %s", table->command);
-  return 0;
+  return NULL;
 }
 
-static int
-contractTextExternally (void) {
-  setOffset();
-  while (++src < srcmax) clearOffset();
+static void
+unlinkCacheEntry (ContractionCacheEntry *entry) {
+  if (entry->active) {
+    ContractionCacheEntry **link = getCacheBucket(entry->hash);
 
-  if (startContractionCommand(table)) {
-    if (putExternalRequests()) {
-      if (getExternalResponses()) {
-        return 1;
+    while (*link) {
+      if (*link == entry) {
+        *link = entry->bucketNext;
+        break;
       }
-    }
-  }
 
-  stopContractionCommand(table);
-  return 0;
-}
-
-static inline unsigned int
-makeCachedInputCount (void) {
-  return srcmax - srcmin;
-}
+      link = &(*link)->bucketNext;
+    }
 
-static inline unsigned int
-makeCachedOutputMaximum (void) {
-  return destmax - destmin;
+    entry->bucketNext = NULL;
+    entry->active = 0;
+  }
 }
 
-static inline int
-makeCachedCursorOffset (void) {
-  return cursor? (cursor - srcmin): CTB_NO_CURSOR;
-}
+static void
+touchCacheEntry (ContractionCacheEntry *entry) {
+  if (entry != table->cache.newestEntry) {
+    if (entry->olderEntry) {
+      entry->olderEntry->newerEntry = entry->newerEntry;
+    } else {
+      table->cache.oldestEntry = entry->newerEntry;
+    }
 
-static int
-checkCache (void) {
-  if (!table->cache.input.characters) return 0;
-  if (!table->cache.output.cells) return 0;
-  if (offsets && !table->cache.offsets.count) return 0;
-  if (table->cache.output.maximum != makeCachedOutputMaximum()) return 0;
-  if (table->cache.cursorOffset != makeCachedCursorOffset()) return 0;
-  if (table->cache.expandCurrentWord != prefs.expandCurrentWord) return 0;
-  if (table->cache.capitalizationMode != prefs.capitalizationMode) return 0;
+    entry->newerEntry->olderEntry = entry->olderEntry;
 
-  {
-    unsigned int count = makeCachedInputCount();
-    if (table->cache.input.count != count) return 0;
-    if (wmemcmp(srcmin, table->cache.input.characters, count) != 0) return 0;
+    entry->olderEntry = table->cache.newestEntry;
+    entry->newerEntry = NULL;
+    table->cache.newestEntry->newerEntry = entry;
+    table->cache.newestEntry = entry;
   }
-
-  return 1;
 }
 
 static void
-updateCache (void) {
+updateCacheEntry (ContractionCacheEntry *entry, unsigned int hash) {
+  unlinkCacheEntry(entry);
+
   {
     unsigned int count = makeCachedInputCount();
 
-    if (count > table->cache.input.size) {
+    if (count > entry->input.size) {
       unsigned int newSize = count | 0X7F;
       wchar_t *newCharacters = malloc(ARRAY_SIZE(newCharacters, newSize));
 
       if (!newCharacters) {
         logMallocError();
-        table->cache.input.count = 0;
-        goto inputDone;
+        return;
       }
 
-      if (table->cache.input.characters) free(table->cache.input.characters);
-      table->cache.input.characters = newCharacters;
-      table->cache.input.size = newSize;
+      if (entry->input.characters) free(entry->input.characters);
+      entry->input.characters = newCharacters;
+      entry->input.size = newSize;
     }
 
-    wmemcpy(table->cache.input.characters, srcmin, count);
-    table->cache.input.count = count;
-    table->cache.input.consumed = src - srcmin;
+    wmemcpy(entry->input.characters, srcmin, count);
+    entry->input.count = count;
+    entry->input.consumed = src - srcmin;
   }
-inputDone:
 
   {
     unsigned int count = dest - destmin;
 
-    if (count > table->cache.output.size) {
+    if (count > entry->output.size) {
       unsigned int newSize = count | 0X7F;
       unsigned char *newCells = malloc(ARRAY_SIZE(newCells, newSize));
 
       if (!newCells) {
         logMallocError();
-        table->cache.output.count = 0;
-        goto outputDone;
+        return;
       }
 
-      if (table->cache.output.cells) free(table->cache.output.cells);
-      table->cache.output.cells = newCells;
-      table->cache.output.size = newSize;
+      if (entry->output.cells) free(entry->output.cells);
+      entry->output.cells = newCells;
+      entry->output.size = newSize;
     }
 
-    memcpy(table->cache.output.cells, destmin, count);
-    table->cache.output.count = count;
-    table->cache.output.maximum = makeCachedOutputMaximum();
+    memcpy(entry->output.cells, destmin, count);
+    entry->output.count = count;
+    entry->output.maximum = makeCachedOutputMaximum();
   }
-outputDone:
 
   if (offsets) {
     unsigned int count = makeCachedInputCount();
 
-    if (count > table->cache.offsets.size) {
+    if (count > entry->offsets.size) {
       unsigned int newSize = count | 0X7F;
       int *newArray = malloc(ARRAY_SIZE(newArray, newSize));
 
       if (!newArray) {
         logMallocError();
-        table->cache.offsets.count = 0;
-        goto offsetsDone;
+        return;
       }
 
-      if (table->cache.offsets.array) free(table->cache.offsets.array);
-      table->cache.offsets.array = newArray;
-      table->cache.offsets.size = newSize;
+      if (entry->offsets.array) free(entry->offsets.array);
+      entry->offsets.array = newArray;
+      entry->offsets.size = newSize;
     }
 
-    memcpy(table->cache.offsets.array, offsets, ARRAY_SIZE(offsets, count));
-    table->cache.offsets.count = count;
+    memcpy(entry->offsets.array, offsets, ARRAY_SIZE(offsets, count));
+    entry->offsets.count = count;
   } else {
-    table->cache.offsets.count = 0;
+    entry->offsets.count = 0;
+  }
+
+  entry->cursorOffset = makeCachedCursorOffset();
+  entry->expandCurrentWord = prefs.expandCurrentWord;
+  entry->capitalizationMode = prefs.capitalizationMode;
+
+  {
+    ContractionCacheEntry **bucket = getCacheBucket(hash);
+
+    entry->hash = hash;
+    entry->bucketNext = *bucket;
+    *bucket = entry;
+    entry->active = 1;
+  }
+
+  touchCacheEntry(entry);
+}
+
+static inline ContractionExternalRequest *
+getExternalRequest (unsigned int index) {
+  return &table->data.external.requests.entries[(table->data.external.requests.first + index) % CTB_EXTERNAL_REQUESTS];
+}
+
+static int
+isExternalRequest (const ContractionExternalRequest *request, unsigned int hash) {
+  if (request->hash != hash) return 0;
+  if (request->output.maximum != makeCachedOutputMaximum()) return 0;
+  if (request->cursorOffset != makeCachedCursorOffset()) return 0;
+  if (request->expandCurrentWord != prefs.expandCurrentWord) return 0;
+  if (request->capitalizationMode != prefs.capitalizationMode) return 0;
+
+  {
+    unsigned int count = makeCachedInputCount();
+    if (request->input.count != count) return 0;
+    if (wmemcmp(srcmin, request->input.characters, count) != 0) return 0;
+  }
+
+  return 1;
+}
+
+static ContractionExternalRequest *
+findExternalRequest (unsigned int hash) {
+  unsigned int index;
+
+  for (index=0; index<table->data.external.requests.count; index+=1) {
+    ContractionExternalRequest *request = getExternalRequest(index);
+
+    if (isExternalRequest(request, hash)) return request;
+  }
+
+  return NULL;
+}
+
+static int
+isExternalRequestPending (unsigned int identifier) {
+  unsigned int index;
+
+  for (index=0; index<table->data.external.requests.count; index+=1) {
+    if (getExternalRequest(index)->identifier == identifier) return 1;
+  }
+
+  return 0;
+}
+
+static ContractionExternalRequest *
+addExternalRequest (unsigned int hash) {
+  ContractionExternalRequest *request;
+
+  if (table->data.external.requests.count == CTB_EXTERNAL_REQUESTS) {
+    logMessage(LOG_DEBUG, "too many external contraction requests: %s", table->command);
+    return NULL;
+  }
+
+  request = getExternalRequest(table->data.external.requests.count);
+
+  {
+    unsigned int count = makeCachedInputCount();
+
+    if (count > request->input.size) {
+      unsigned int newSize = count | 0X7F;
+      wchar_t *newCharacters = malloc(ARRAY_SIZE(newCharacters, newSize));
+
+      if (!newCharacters) {
+        logMallocError();
+        return NULL;
+      }
+
+      if (request->input.characters) free(request->input.characters);
+      request->input.characters = newCharacters;
+      request->input.size = newSize;
+    }
+
+    if (count > request->offsets.size) {
+      unsigned int newSize = count | 0X7F;
+      int *newArray = malloc(ARRAY_SIZE(newArray, newSize));
+
+      if (!newArray) {
+        logMallocError();
+        return NULL;
+      }
+
+      if (request->offsets.array) free(request->offsets.array);
+      request->offsets.array = newArray;
+      request->offsets.size = newSize;
+    }
+
+    wmemcpy(request->input.characters, srcmin, count);
+    request->input.count = count;
+  }
+
+  {
+    unsigned int maximum = makeCachedOutputMaximum();
+
+    if (maximum > request->output.size) {
+      unsigned int newSize = maximum | 0X7F;
+      unsigned char *newCells = malloc(ARRAY_SIZE(newCells, newSize));
+
+      if (!newCells) {
+        logMallocError();
+        return NULL;
+      }
+
+      if (request->output.cells) free(request->output.cells);
+      request->output.cells = newCells;
+      request->output.size = newSize;
+    }
+
+    request->output.maximum = maximum;
+  }
+
+  request->cursorOffset = makeCachedCursorOffset();
+  request->expandCurrentWord = prefs.expandCurrentWord;
+  request->capitalizationMode = prefs.capitalizationMode;
+
+  request->hash = hash;
+  request->awaited = 0;
+  request->identifier = ++table->data.external.requests.identifier;
+  table->data.external.requests.count += 1;
+  return request;
+}
+
+static void
+removeExternalRequest (void) {
+  table->data.external.requests.first += 1;
+  table->data.external.requests.first %= CTB_EXTERNAL_REQUESTS;
+  table->data.external.requests.sent -= 1;
+  table->data.external.requests.count -= 1;
+  table->data.external.requests.responding = 0;
+}
+
+static int
+putExternalRequests (void) {
+  FILE *stream = table->data.external.standardInput;
+  int written = 0;
+
+  while (table->data.external.requests.sent < table->data.external.requests.count) {
+    if (!putExternalRequest(getExternalRequest(table->data.external.requests.sent))) return 0;
+    table->data.external.requests.sent += 1;
+    written = 1;
+  }
+
+  if (written) {
+    if (fflush(stream) == EOF) {
+      logMessage(LOG_WARNING, "external contraction output error: %s: %s", table->command, strerror(errno));
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void
+putUncontractedText (void) {
+  size_t count = srcmax - src;
+
+  if (count > (destmax - dest)) count = destmax - dest;
+  convertCharactersToDots(textTable, src, count, dest);
+
+  while (count--) {
+    setOffset();
+    src += 1;
+    dest += 1;
+  }
+}
+
+static void
+finishContraction (void) {
+  if (src < srcmax) {
+    const wchar_t *srcorig = src;
+    int done = 1;
+
+    setOffset();
+    while (1) {
+      if (done && !testCharacter(*src, CTC_Space)) {
+        done = 0;
+
+        if (!cursor || (cursor < srcorig) || (cursor >= src)) {
+          setOffset();
+          srcorig = src;
+        }
+      }
+
+      if (++src == srcmax) break;
+      clearOffset();
+    }
+
+    if (!done) src = srcorig;
+  }
+}
+
+static void
+beginExternalResponse (void) {
+  const ContractionExternalRequest *request = getExternalRequest(0);
+
+  srcmax = (srcmin = src = request->input.characters) + request->input.count;
+  destmax = (destmin = dest = request->output.cells) + request->output.maximum;
+  offsets = request->offsets.array;
+  cursor = (request->cursorOffset == CTB_NO_CURSOR)? NULL: &srcmin[request->cursorOffset];
+
+  setOffset();
+  while (++src < srcmax) clearOffset();
+  table->data.external.requests.responding = 1;
+}
+
+static void
+endExternalResponse (void) {
+  const ContractionExternalRequest *request = getExternalRequest(0);
+
+  if ((request->expandCurrentWord == prefs.expandCurrentWord) &&
+      (request->capitalizationMode == prefs.capitalizationMode)) {
+    ContractionCacheEntry *entry = findCacheEntry(request->hash);
+
+    finishContraction();
+    updateCacheEntry((entry? entry: table->cache.oldestEntry), request->hash);
+  }
+
+  removeExternalRequest();
+}
+
+static int
+handleExternalResponse_requestIdentifier (const char *value) {
+  int identifier;
+
+  if (!isInteger(&identifier, value)) return 0;
+
+  while (getExternalRequest(0)->identifier != identifier) {
+    logMessage(LOG_WARNING, "external contraction request not answered: %s: %u",
+               table->command, getExternalRequest(0)->identifier);
+
+    removeExternalRequest();
+    if (!table->data.external.requests.sent) return 0;
+    beginExternalResponse();
   }
-offsetsDone:
 
-  table->cache.cursorOffset = makeCachedCursorOffset();
-  table->cache.expandCurrentWord = prefs.expandCurrentWord;
-  table->cache.capitalizationMode = prefs.capitalizationMode;
+  return 1;
+}
+
+typedef struct {
+  const char *name;
+  int (*handler) (const char *value);
+  unsigned stop:1;
+} ExternalResponseEntry;
+
+static const ExternalResponseEntry externalResponseTable[] = {
+  { .name = "request-id",
+    .handler = handleExternalResponse_requestIdentifier
+  },
+
+  { .name = "brf",
+    .stop = 1,
+    .handler = handleExternalResponse_brf
+  },
+
+  { .name = "consumed-length",
+    .handler = handleExternalResponse_consumedLength
+  },
+
+  { .name = "output-offsets",
+    .handler = handleExternalResponse_outputOffsets
+  },
+
+  { .name = NULL }
+};
+
+static void
+handleExternalResponse (char *line) {
+  int ok = 0;
+  int stop = 0;
+
+  if (table->data.external.requests.sent) {
+    char *delimiter = strchr(line, '=');
+
+    if (!table->data.external.requests.responding) beginExternalResponse();
+
+    if (delimiter) {
+      const char *value = delimiter + 1;
+      const ExternalResponseEntry *rsp = externalResponseTable;
+
+      char oldDelimiter = *delimiter;
+      *delimiter = 0;
+
+      while (rsp->name) {
+        if (strcmp(line, rsp->name) == 0) {
+          if (rsp->handler(value)) ok = 1;
+          if (rsp->stop) stop = 1;
+          break;
+        }
+
+        rsp += 1;
+      }
+
+      *delimiter = oldDelimiter;
+    }
+  }
+
+  if (!ok) logMessage(LOG_WARNING, "unexpected external contraction response: %s: %s", table->command, line);
+  if (stop && table->data.external.requests.responding) endExternalResponse();
+}
+
+static int
+getExternalResponses (int timeout) {
+  int descriptor = fileno(table->data.external.standardOutput);
+
+#ifdef HAVE_SYS_POLL_H
+  {
+    struct pollfd pfd = {
+      .fd = descriptor,
+      .events = POLLIN
+    };
+
+    int result = poll(&pfd, 1, timeout);
+
+    if (result == -1) {
+      if (errno == EINTR) return 0;
+      logSystemError("poll");
+      return -1;
+    }
+
+    if (!result) return 0;
+  }
+#elif !defined(O_NONBLOCK)
+  /* The read would block - only do it when waiting for a response. */
+  if (!timeout) return 0;
+#endif /* HAVE_SYS_POLL_H */
+
+  if ((table->data.external.response.size - table->data.external.response.length) < 0X80) {
+    size_t newSize = table->data.external.response.size;
+    char *newBuffer;
+
+    newSize = newSize? newSize<<1: 0X200;
+
+    if (!(newBuffer = realloc(table->data.external.response.buffer, newSize))) {
+      logMallocError();
+      return -1;
+    }
+
+    table->data.external.response.buffer = newBuffer;
+    table->data.external.response.size = newSize;
+  }
+
+  {
+    char *buffer = table->data.external.response.buffer;
+    size_t length = table->data.external.response.length;
+    ssize_t count = read(descriptor, &buffer[length],
+                         (table->data.external.response.size - length));
+
+    if (count == -1) {
+      if (errno == EINTR) return 0;
+
+      if (errno == EAGAIN) {
+#ifndef HAVE_SYS_POLL_H
+        /* nothing to wait on - don't spin */
+        if (timeout) approximateDelay(1);
+#endif /* HAVE_SYS_POLL_H */
+
+        return 0;
+      }
+
+      logSystemError("read");
+      return -1;
+    }
+
+    if (!count) {
+      logMessage(LOG_WARNING, "incomplete external contraction response: %s", table->command);
+      return -1;
+    }
+
+    length += count;
+
+    {
+      char *line = buffer;
+      char *end = buffer + length;
+      char *newline;
+
+      while ((newline = memchr(line, '\n', (end - line)))) {
+        *newline = 0;
+        handleExternalResponse(line);
+        line = newline + 1;
+      }
+
+      length = end - line;
+      memmove(buffer, line, length);
+    }
+
+    table->data.external.response.length = length;
+  }
+
+  return 1;
+}
+
+static void
+pollExternalResponses (void) {
+  if (table->data.external.commandStarted) {
+    while (table->data.external.requests.sent) {
+      int result = getExternalResponses(0);
+
+      if (result < 0) {
+        stopContractionCommand(table);
+        break;
+      }
+
+      if (!result) break;
+    }
+  }
+}
+
+static int
+awaitExternalResponse (ContractionExternalRequest *request) {
+  unsigned int identifier = request->identifier;
+  int timeout = request->awaited? 0: CTB_EXTERNAL_TIMEOUT;
+  TimePeriod period;
+
+  request->awaited = 1;
+  startTimePeriod(&period, timeout);
+
+  while (isExternalRequestPending(identifier)) {
+    long int elapsed;
+    int expired = afterTimePeriod(&period, &elapsed);
+    int result = getExternalResponses(expired? 0: (timeout - elapsed));
+
+    if (result < 0) return -1;
+    if (!result && expired) return 0;
+  }
+
+  return 1;
+}
+
+static int
+contractTextExternally (unsigned int hash) {
+  if (startContractionCommand(table)) {
+    ContractionExternalRequest *request = findExternalRequest(hash);
+
+    if (!request) {
+      if (!(request = addExternalRequest(hash))) return 0;
+
+      {
+        /* send it ahead of the ones which have only been prepared */
+        ContractionExternalRequest *next = getExternalRequest(table->data.external.requests.sent);
+
+        if (next != request) {
+          ContractionExternalRequest swap = *next;
+          *next = *request;
+          *request = swap;
+          request = next;
+        }
+      }
+    }
+
+    if (putExternalRequests()) {
+      int result = awaitExternalResponse(request);
+
+      if (result >= 0) return result;
+    }
+  }
+
+  stopContractionCommand(table);
+  return 0;
+}
+
+static void
+beginContraction (
+  const wchar_t *inputBuffer, int inputLength,
+  BYTE *outputBuffer, int outputLength,
+  int *offsetsMap, int cursorOffset
+) {
+  srcmax = (srcmin = src = inputBuffer) + inputLength;
+  destmax = (destmin = dest = outputBuffer) + outputLength;
+  offsets = offsetsMap;
+  cursor = (cursorOffset == CTB_NO_CURSOR)? NULL: &src[cursorOffset];
+}
+
+static void
+putCacheEntry (const ContractionCacheEntry *entry) {
+  src = srcmin + entry->input.consumed;
+  if (offsets && entry->offsets.count)
+    memcpy(offsets, entry->offsets.array,
+           ARRAY_SIZE(offsets, entry->offsets.count));
+
+  dest = destmin + entry->output.count;
+  memcpy(destmin, entry->output.cells,
+         ARRAY_SIZE(destmin, entry->output.count));
 }
 
 void
@@ -1601,57 +2200,85 @@ contractText (
   BYTE *outputBuffer, int *outputLength,
   int *offsetsMap, const int cursorOffset
 ) {
-  table = contractionTable;
-  srcmax = (srcmin = src = inputBuffer) + *inputLength;
-  destmax = (destmin = dest = outputBuffer) + *outputLength;
-  offsets = offsetsMap;
-  cursor = (cursorOffset == CTB_NO_CURSOR)? NULL: &src[cursorOffset];
-
-  if (checkCache()) {
-    src = srcmin + table->cache.input.consumed;
-    if (offsets)
-      memcpy(offsets, table->cache.offsets.array,
-             ARRAY_SIZE(offsets, table->cache.offsets.count));
+  unsigned int hash;
+  ContractionCacheEntry *entry;
 
-    dest = destmin + table->cache.output.count;
-    memcpy(destmin, table->cache.output.cells,
-           ARRAY_SIZE(destmin, table->cache.output.count));
-  } else {
-    if (!(table->command? contractTextExternally(): contractTextInternally())) {
-      src = srcmin;
-      dest = destmin;
-
-      while ((src < srcmax) && (dest < destmax)) {
-        setOffset();
-        *dest++ = convertCharacterToDots(textTable, *src++);
+  table = contractionTable;
+  prepareDenseCharacterEntries();
+  if (table->command) pollExternalResponses();
+
+  beginContraction(inputBuffer, *inputLength, outputBuffer, *outputLength, offsetsMap, cursorOffset);
+  hash = makeCacheHash();
+  entry = findCacheEntry(hash);
+
+  if (entry && (!offsets || (entry->offsets.count == entry->input.count))) {
+    table->cache.hits += 1;
+    touchCacheEntry(entry);
+    putCacheEntry(entry);
+
+    if (table->command) {
+      if (table->data.external.requests.sent < table->data.external.requests.count) {
+        if (!(startContractionCommand(table) && putExternalRequests())) {
+          stopContractionCommand(table);
+        }
       }
     }
+  } else {
+    table->cache.misses += 1;
 
-    if (src < srcmax) {
-      const wchar_t *srcorig = src;
-      int done = 1;
-
-      setOffset();
-      while (1) {
-        if (done && !testCharacter(*src, CTC_Space)) {
-          done = 0;
+    if (table->command) {
+      /* the response is cached - also when it arrives after we've stopped waiting */
+      int contracted = contractTextExternally(hash);
 
-          if (!cursor || (cursor < srcorig) || (cursor >= src)) {
-            setOffset();
-            srcorig = src;
-          }
-        }
+      beginContraction(inputBuffer, *inputLength, outputBuffer, *outputLength, offsetsMap, cursorOffset);
+      entry = contracted? findCacheEntry(hash): NULL;
 
-        if (++src == srcmax) break;
-        clearOffset();
+      if (entry) {
+        putCacheEntry(entry);
+      } else {
+        putUncontractedText();
+        finishContraction();
+      }
+    } else {
+      if (!contractTextInternally()) {
+        src = srcmin;
+        dest = destmin;
+        putUncontractedText();
       }
 
-      if (!done) src = srcorig;
+      finishContraction();
+      updateCacheEntry((entry? entry: table->cache.oldestEntry), hash);
     }
-
-    updateCache();
   }
 
   *inputLength = src - srcmin;
   *outputLength = dest - destmin;
 }
+
+void
+prepareContractedText (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int inputLength,
+  int outputLength, int cursorOffset
+) {
+  if (contractionTable->command) {
+    BYTE outputBuffer[outputLength];
+    unsigned int hash;
+
+    table = contractionTable;
+    beginContraction(inputBuffer, inputLength, outputBuffer, outputLength, NULL, cursorOffset);
+    hash = makeCacheHash();
+
+    if (!findCacheEntry(hash) && !findExternalRequest(hash)) addExternalRequest(hash);
+  }
+}
+
+int
+isContractionTableExternal (ContractionTable *contractionTable) {
+  return contractionTable->command != NULL;
+}
+
+int
+isContractionPending (ContractionTable *contractionTable) {
+  return contractionTable->command && contractionTable->data.external.requests.count;
+}
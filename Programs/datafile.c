@@ -959,6 +959,13 @@ processUtf8Line (char *line, void *dataAddress) {
   return processWcharLine(file, characters);
 }
 
+static DataFileObserver *dataFileObserver = NULL;
+
+void
+setDataFileObserver (DataFileObserver *observer) {
+  dataFileObserver = observer;
+}
+
 int
 processDataStream (
   Queue *variables,
@@ -979,6 +986,7 @@ processDataStream (
       return 0;
 
   logMessage(LOG_DEBUG, "including data file: %s", file.name);
+  if (dataFileObserver) dataFileObserver(file.name);
   if ((file.variables = newDataVariableQueue(variables))) {
     if (processLines(stream, processUtf8Line, &file)) ok = 1;
     deallocateQueue(file.variables);
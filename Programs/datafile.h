@@ -43,6 +43,9 @@ extern int processDataStream (
   DataProcessor processor, void *data
 );
 
+typedef void DataFileObserver (const char *name);
+extern void setDataFileObserver (DataFileObserver *observer);
+
 extern int isKeyword (const wchar_t *keyword, const wchar_t *characters, size_t length);
 extern int isNumber (int *number, const wchar_t *characters, int length);
 extern int isHexadecimalDigit (wchar_t character, int *value, int *shift);
@@ -22,6 +22,7 @@
 #include <errno.h>
 
 #include "log.h"
+#include "driver.h"
 #include "async_wait.h"
 #include "io_generic.h"
 #include "gio_internal.h"
@@ -244,6 +245,24 @@ gioAwaitInput (GioEndpoint *endpoint, int timeout) {
   return method(endpoint->handle, timeout);
 }
 
+static ssize_t
+gioReadInput (GioEndpoint *endpoint, GioReadDataMethod *method, int wait) {
+  ssize_t result = method(endpoint->handle,
+                          &endpoint->input.buffer[endpoint->input.to],
+                          sizeof(endpoint->input.buffer) - endpoint->input.to,
+                          (wait? endpoint->options.inputTimeout: 0), 0);
+
+  if (result > 0) {
+    if (LOG_CATEGORY_FLAG(GENERIC_INPUT)) {
+      logBytes(categoryLogLevel, "generic input", &endpoint->input.buffer[endpoint->input.to], result);
+    }
+
+    endpoint->input.to += result;
+  }
+
+  return result;
+}
+
 ssize_t
 gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait) {
   GioReadDataMethod *method = endpoint->methods->readData;
@@ -282,17 +301,9 @@ gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait) {
       }
 
       {
-        ssize_t result = method(endpoint->handle,
-                                &endpoint->input.buffer[endpoint->input.to],
-                                sizeof(endpoint->input.buffer) - endpoint->input.to,
-                                (wait? endpoint->options.inputTimeout: 0), 0);
+        ssize_t result = gioReadInput(endpoint, method, wait);
 
         if (result > 0) {
-          if (LOG_CATEGORY_FLAG(GENERIC_INPUT)) {
-            logBytes(categoryLogLevel, "generic input", &endpoint->input.buffer[endpoint->input.to], result);
-          }
-
-          endpoint->input.to += result;
           wait = 1;
         } else {
           if (!result) break;
@@ -322,6 +333,164 @@ gioDiscardInput (GioEndpoint *endpoint) {
   return errno == EAGAIN;
 }
 
+static int
+gioFillInput (GioEndpoint *endpoint, int wait) {
+  GioReadDataMethod *method = endpoint->methods->readData;
+
+  if (!method) {
+    logUnsupportedOperation("readData");
+    return 0;
+  }
+
+  if (endpoint->input.to - endpoint->input.from) return 1;
+  endpoint->input.from = endpoint->input.to = 0;
+
+  if (endpoint->input.error) {
+    errno = endpoint->input.error;
+    endpoint->input.error = 0;
+    return 0;
+  }
+
+  {
+    ssize_t result = gioReadInput(endpoint, method, wait);
+
+    if (result > 0) return 1;
+    if (!result) errno = EAGAIN;
+    return 0;
+  }
+}
+
+static size_t
+gioGetPacketLength (const GioPacketGrammar *grammar, const unsigned char *bytes, size_t count) {
+  switch (grammar->framing) {
+    case GIO_PACKET_FIXED:
+      return grammar->format.fixed.length;
+
+    case GIO_PACKET_PREFIXED: {
+      size_t length = grammar->format.prefixed.headerLength;
+      size_t offset = grammar->format.prefixed.lengthOffset;
+
+      if (count < length) return 0;
+      length += grammar->format.prefixed.trailerLength;
+      length += bytes[offset];
+
+      if (grammar->format.prefixed.lengthSize > 1) {
+        length += bytes[offset+1] << 8;
+      }
+
+      return length;
+    }
+
+    default:
+      return 0;
+  }
+}
+
+size_t
+gioReadPacket (
+  GioEndpoint *endpoint, const GioPacketGrammar *grammar,
+  void *packet, size_t size
+) {
+  unsigned char *bytes = packet;
+  size_t count = 0;
+  size_t length = 0;
+  int escaped = 0;
+
+  while (1) {
+    unsigned char *from;
+    unsigned char *to;
+
+    if (!gioFillInput(endpoint, (count > 0))) {
+      if (count) logPartialPacket(bytes, MIN(count, size));
+      return 0;
+    }
+
+    from = &endpoint->input.buffer[endpoint->input.from];
+    to = &endpoint->input.buffer[endpoint->input.to];
+
+    if (!count && (grammar->leadByte != -1)) {
+      unsigned char *lead = memchr(from, grammar->leadByte, to-from);
+
+      if (!lead) lead = to;
+
+      if (lead != from) {
+        logDiscardedBytes(from, lead-from);
+        endpoint->input.from += lead - from;
+        from = lead;
+        if (from == to) continue;
+      }
+    }
+
+    if (grammar->framing == GIO_PACKET_TERMINATED) {
+      unsigned char terminator = grammar->format.terminated.terminator;
+      int escape = grammar->format.terminated.escape;
+      const unsigned char *next = from;
+      int terminated = 0;
+
+      if (escape == -1) {
+        const unsigned char *end = memchr(from, terminator, to-from);
+
+        if (end) {
+          next = end + 1;
+          terminated = 1;
+        } else {
+          next = to;
+        }
+
+        if (count < size) memcpy(&bytes[count], from, MIN((next - from), (size - count)));
+        count += next - from;
+      } else {
+        while (next < to) {
+          unsigned char byte = *next++;
+
+          if (escaped) {
+            escaped = 0;
+          } else if (byte == escape) {
+            escaped = 1;
+            continue;
+          } else if (byte == terminator) {
+            terminated = 1;
+          }
+
+          if (count < size) bytes[count] = byte;
+          count += 1;
+          if (terminated) break;
+        }
+      }
+
+      endpoint->input.from += next - from;
+      if (terminated) length = count;
+    } else {
+      if (!length) length = gioGetPacketLength(grammar, bytes, count);
+
+      {
+        size_t needed = (length? length: grammar->format.prefixed.headerLength) - count;
+        size_t amount = to - from;
+
+        if (amount > needed) amount = needed;
+        if (count < size) memcpy(&bytes[count], from, MIN(amount, (size - count)));
+
+        endpoint->input.from += amount;
+        count += amount;
+      }
+
+      if (!length) length = gioGetPacketLength(grammar, bytes, count);
+    }
+
+    if (length && (count == length)) {
+      if (length <= size) {
+        logInputPacket(bytes, length);
+        return length;
+      }
+
+      logTruncatedPacket(bytes, size);
+      count = 0;
+      length = 0;
+      escaped = 0;
+    }
+  }
+}
+
 int
 gioReconfigureResource (
   GioEndpoint *endpoint,
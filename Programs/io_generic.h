@@ -73,6 +73,40 @@ extern ssize_t gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, in
 extern int gioReadByte (GioEndpoint *endpoint, unsigned char *byte, int wait);
 extern int gioDiscardInput (GioEndpoint *endpoint);
 
+typedef enum {
+  GIO_PACKET_FIXED,
+  GIO_PACKET_PREFIXED,
+  GIO_PACKET_TERMINATED
+} GioPacketFraming;
+
+typedef struct {
+  GioPacketFraming framing;
+  int leadByte; /* -1 if a packet may begin with any byte */
+
+  union {
+    struct {
+      size_t length;
+    } fixed;
+
+    struct {
+      size_t headerLength;
+      unsigned char lengthOffset;
+      unsigned char lengthSize; /* 1 or 2 (little-endian) bytes */
+      size_t trailerLength;
+    } prefixed;
+
+    struct {
+      unsigned char terminator;
+      int escape; /* -1 if there is no escape byte */
+    } terminated;
+  } format;
+} GioPacketGrammar;
+
+extern size_t gioReadPacket (
+  GioEndpoint *endpoint, const GioPacketGrammar *grammar,
+  void *packet, size_t size
+);
+
 extern int gioReconfigureResource (
   GioEndpoint *endpoint,
   const SerialParameters *parameters
@@ -132,6 +132,9 @@ extern char *usbGetManufacturer (UsbDevice *device, int timeout);
 extern char *usbGetProduct (UsbDevice *device, int timeout);
 extern char *usbGetSerialNumber (UsbDevice *device, int timeout);
 
+extern char *usbMakeDeviceFingerprint (UsbDevice *device);
+extern int usbHaveDeviceFingerprint (const char *fingerprint);
+
 extern void usbLogString (
   UsbDevice *device,
   unsigned char number,
@@ -318,6 +321,7 @@ typedef struct {
 
 extern UsbChannel *usbOpenChannel (const UsbChannelDefinition *definitions, const char *identifier);
 extern void usbCloseChannel (UsbChannel *channel);
+extern char *usbGetChannelFingerprint (void);
 
 extern int isUsbDevice (const char **identifier);
 
@@ -180,6 +180,7 @@ getKeyContext (KeyTableData *ktd, unsigned char context) {
       ctx->keyBindings.size = 0;
       ctx->keyBindings.count = 0;
       ctx->keyBindings.sorted = NULL;
+      ctx->keyBindings.index = NULL;
 
       ctx->hotkeys.table = NULL;
       ctx->hotkeys.count = 0;
@@ -1286,6 +1287,7 @@ prepareKeyBindings (KeyContext *ctx) {
     }
 
     qsort(ctx->keyBindings.sorted, ctx->keyBindings.count, sizeof(*ctx->keyBindings.sorted), sortKeyBindings);
+    if (!prepareKeyBindingIndex(ctx)) return 0;
   }
 
   return 1;
@@ -1440,6 +1442,7 @@ destroyKeyTable (KeyTable *table) {
 
     if (ctx->keyBindings.table) free(ctx->keyBindings.table);
     if (ctx->keyBindings.sorted) free(ctx->keyBindings.sorted);
+    destroyKeyBindingIndex(ctx);
 
     if (ctx->hotkeys.table) free(ctx->hotkeys.table);
     if (ctx->hotkeys.sorted) free(ctx->hotkeys.sorted);
@@ -88,6 +88,10 @@ typedef struct {
     unsigned int size;
     unsigned int count;
     const KeyBinding **sorted;
+
+    const KeyBinding **index;
+    unsigned int mask;
+    unsigned char anyKeySets[0X100 / 8];
   } keyBindings;
 
   struct {
@@ -162,6 +166,21 @@ extern int deleteKeyValue (KeyValue *values, unsigned int *count, const KeyValue
 
 extern int compareKeyBindings (const KeyBinding *binding1, const KeyBinding *binding2);
 
+extern int prepareKeyBindingIndex (KeyContext *ctx);
+extern void destroyKeyBindingIndex (KeyContext *ctx);
+
+extern const KeyBinding *lookupKeyBinding (
+  const KeyContext *ctx,
+  const KeyValue *keys, unsigned int count,
+  const KeyValue *immediate, int *isIncomplete
+);
+
+extern const KeyBinding *searchKeyBindings (
+  const KeyContext *ctx,
+  const KeyValue *keys, unsigned int count,
+  const KeyValue *immediate, int *isIncomplete
+);
+
 extern void resetLongPressData (KeyTable *table);
 
 #ifdef __cplusplus
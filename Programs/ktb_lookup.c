@@ -0,0 +1,277 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "ktb.h"
+#include "ktb_internal.h"
+
+static unsigned int
+hashKeyCombination (const KeyCombination *combination) {
+  unsigned int hash = 2166136261U;
+  const KeyValue *key = combination->modifierKeys;
+  const KeyValue *end = key + combination->modifierCount;
+
+#define HASH_BYTE(byte) hash = (hash ^ (byte)) * 16777619U
+  HASH_BYTE(combination->modifierCount);
+
+  if (combination->flags & KCF_IMMEDIATE_KEY) {
+    HASH_BYTE(combination->immediateKey.set);
+    HASH_BYTE(combination->immediateKey.key);
+  } else {
+    HASH_BYTE(KTB_KEY_ANY);
+    HASH_BYTE(0);
+  }
+
+  while (key < end) {
+    HASH_BYTE(key->set);
+    HASH_BYTE(key->key);
+    key += 1;
+  }
+#undef HASH_BYTE
+
+  return hash ^ (hash >> 16);
+}
+
+static inline void
+setAnyKeySet (KeyContext *ctx, unsigned char set) {
+  ctx->keyBindings.anyKeySets[set / 8] |= 1 << (set % 8);
+}
+
+static inline int
+isAnyKeySet (const KeyContext *ctx, unsigned char set) {
+  return !!(ctx->keyBindings.anyKeySets[set / 8] & (1 << (set % 8)));
+}
+
+int
+prepareKeyBindingIndex (KeyContext *ctx) {
+  unsigned int size = 1;
+
+  memset(ctx->keyBindings.anyKeySets, 0, sizeof(ctx->keyBindings.anyKeySets));
+  while (size < (ctx->keyBindings.count * 2)) size <<= 1;
+
+  if ((ctx->keyBindings.index = calloc(size, sizeof(*ctx->keyBindings.index)))) {
+    const KeyBinding *const *binding = ctx->keyBindings.sorted;
+    const KeyBinding *const *end = binding + ctx->keyBindings.count;
+
+    ctx->keyBindings.mask = size - 1;
+
+    while (binding < end) {
+      const KeyCombination *combination = &(*binding)->combination;
+      unsigned int slot = hashKeyCombination(combination) & ctx->keyBindings.mask;
+
+      {
+        unsigned int index;
+
+        for (index=0; index<combination->modifierCount; index+=1) {
+          const KeyValue *key = &combination->modifierKeys[index];
+
+          if (key->key == KTB_KEY_ANY) setAnyKeySet(ctx, key->set);
+        }
+      }
+
+      while (ctx->keyBindings.index[slot]) {
+        if (compareKeyBindings(ctx->keyBindings.index[slot], *binding) == 0) break;
+        slot = (slot + 1) & ctx->keyBindings.mask;
+      }
+
+      if (!ctx->keyBindings.index[slot]) ctx->keyBindings.index[slot] = *binding;
+      binding += 1;
+    }
+
+    return 1;
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
+
+void
+destroyKeyBindingIndex (KeyContext *ctx) {
+  if (ctx->keyBindings.index) {
+    free(ctx->keyBindings.index);
+    ctx->keyBindings.index = NULL;
+  }
+}
+
+static const KeyBinding *
+getIndexedKeyBinding (const KeyContext *ctx, const KeyBinding *target) {
+  unsigned int slot = hashKeyCombination(&target->combination) & ctx->keyBindings.mask;
+  const KeyBinding *binding;
+
+  while ((binding = ctx->keyBindings.index[slot])) {
+    if (compareKeyBindings(target, binding) == 0) return binding;
+    slot = (slot + 1) & ctx->keyBindings.mask;
+  }
+
+  return NULL;
+}
+
+const KeyBinding *
+lookupKeyBinding (
+  const KeyContext *ctx,
+  const KeyValue *keys, unsigned int count,
+  const KeyValue *immediate, int *isIncomplete
+) {
+  if (ctx->keyBindings.index && (count <= MAX_MODIFIERS_PER_COMBINATION)) {
+    unsigned char positions[MAX_MODIFIERS_PER_COMBINATION];
+    unsigned int variable = 0;
+    KeyBinding target;
+
+    memset(&target, 0, sizeof(target));
+    target.combination.modifierCount = count;
+
+    if (immediate) {
+      target.combination.immediateKey = *immediate;
+      target.combination.flags |= KCF_IMMEDIATE_KEY;
+    }
+
+    /* Only keys belonging to a set that some binding refers to as a whole
+     * can be matched by a wildcard, so only they need to be varied.
+     * Trying the subsets in increasing order of their bits yields the same
+     * precedence as varying every pressed key would.
+     */
+    {
+      unsigned int index;
+
+      for (index=0; index<count; index+=1) {
+        if (isAnyKeySet(ctx, keys[index].set)) positions[variable++] = index;
+      }
+    }
+
+    while (1) {
+      unsigned int all = (1 << variable) - 1;
+      unsigned int bits;
+
+      for (bits=0; bits<=all; bits+=1) {
+        KeyValue *modifiers = target.combination.modifierKeys;
+
+        copyKeyValues(modifiers, keys, count);
+
+        {
+          unsigned int index = variable;
+
+          while (index--) {
+            if (bits & (1 << index)) {
+              unsigned int position = positions[index];
+              KeyValue any = {.set=modifiers[position].set, .key=KTB_KEY_ANY};
+
+              /* the keys are sorted so the wildcard goes after the last one in its set
+               * (working backward leaves the earlier positions where they were)
+               */
+              while (++position < count) {
+                if (modifiers[position].set != any.set) break;
+                if (modifiers[position].key == KTB_KEY_ANY) break;
+                modifiers[position-1] = modifiers[position];
+              }
+
+              modifiers[position-1] = any;
+            }
+          }
+        }
+
+        {
+          const KeyBinding *binding = getIndexedKeyBinding(ctx, &target);
+
+          if (binding) {
+            if (binding->command != EOF) return binding;
+            *isIncomplete = 1;
+          }
+        }
+      }
+
+      if (!(target.combination.flags & KCF_IMMEDIATE_KEY)) break;
+      if (target.combination.immediateKey.key == KTB_KEY_ANY) break;
+      target.combination.immediateKey.key = KTB_KEY_ANY;
+    }
+  }
+
+  return NULL;
+}
+
+static int
+sortModifierKeys (const void *element1, const void *element2) {
+  const KeyValue *modifier1 = element1;
+  const KeyValue *modifier2 = element2;
+  return compareKeyValues(modifier1, modifier2);
+}
+
+static int
+searchKeyBinding (const void *target, const void *element) {
+  const KeyBinding *reference = target;
+  const KeyBinding *const *binding = element;
+  return compareKeyBindings(reference, *binding);
+}
+
+const KeyBinding *
+searchKeyBindings (
+  const KeyContext *ctx,
+  const KeyValue *keys, unsigned int count,
+  const KeyValue *immediate, int *isIncomplete
+) {
+  if (ctx->keyBindings.sorted && (count <= MAX_MODIFIERS_PER_COMBINATION)) {
+    KeyBinding target;
+    memset(&target, 0, sizeof(target));
+
+    if (immediate) {
+      target.combination.immediateKey = *immediate;
+      target.combination.flags |= KCF_IMMEDIATE_KEY;
+    }
+    target.combination.modifierCount = count;
+
+    while (1) {
+      unsigned int all = (1 << count) - 1;
+      unsigned int bits;
+
+      for (bits=0; bits<=all; bits+=1) {
+        {
+          unsigned int index;
+          unsigned int bit;
+
+          for (index=0, bit=1; index<count; index+=1, bit<<=1) {
+            KeyValue *modifier = &target.combination.modifierKeys[index];
+
+            *modifier = keys[index];
+            if (bits & bit) modifier->key = KTB_KEY_ANY;
+          }
+        }
+        qsort(target.combination.modifierKeys, count, sizeof(*target.combination.modifierKeys), sortModifierKeys);
+
+        {
+          const KeyBinding *const *binding = bsearch(&target, ctx->keyBindings.sorted, ctx->keyBindings.count, sizeof(*ctx->keyBindings.sorted), searchKeyBinding);
+
+          if (binding) {
+            if ((*binding)->command != EOF) return *binding;
+            *isIncomplete = 1;
+          }
+        }
+      }
+
+      if (!(target.combination.flags & KCF_IMMEDIATE_KEY)) break;
+      if (target.combination.immediateKey.key == KTB_KEY_ANY) break;
+      target.combination.immediateKey.key = KTB_KEY_ANY;
+    }
+  }
+
+  return NULL;
+}
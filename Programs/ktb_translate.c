@@ -29,69 +29,11 @@
 #include "cmd_queue.h"
 #include "async_alarm.h"
 
-static int
-sortModifierKeys (const void *element1, const void *element2) {
-  const KeyValue *modifier1 = element1;
-  const KeyValue *modifier2 = element2;
-  return compareKeyValues(modifier1, modifier2);
-}
-
-static int
-searchKeyBinding (const void *target, const void *element) {
-  const KeyBinding *reference = target;
-  const KeyBinding *const *binding = element;
-  return compareKeyBindings(reference, *binding);
-}
-
 static const KeyBinding *
 findKeyBinding (KeyTable *table, unsigned char context, const KeyValue *immediate, int *isIncomplete) {
   const KeyContext *ctx = getKeyContext(table, context);
 
-  if (ctx && ctx->keyBindings.sorted &&
-      (table->pressedKeys.count <= MAX_MODIFIERS_PER_COMBINATION)) {
-    KeyBinding target;
-    memset(&target, 0, sizeof(target));
-
-    if (immediate) {
-      target.combination.immediateKey = *immediate;
-      target.combination.flags |= KCF_IMMEDIATE_KEY;
-    }
-    target.combination.modifierCount = table->pressedKeys.count;
-
-    while (1) {
-      unsigned int all = (1 << table->pressedKeys.count) - 1;
-      unsigned int bits;
-
-      for (bits=0; bits<=all; bits+=1) {
-        {
-          unsigned int index;
-          unsigned int bit;
-
-          for (index=0, bit=1; index<table->pressedKeys.count; index+=1, bit<<=1) {
-            KeyValue *modifier = &target.combination.modifierKeys[index];
-
-            *modifier = table->pressedKeys.table[index];
-            if (bits & bit) modifier->key = KTB_KEY_ANY;
-          }
-        }
-        qsort(target.combination.modifierKeys, table->pressedKeys.count, sizeof(*target.combination.modifierKeys), sortModifierKeys);
-
-        {
-          const KeyBinding *const *binding = bsearch(&target, ctx->keyBindings.sorted, ctx->keyBindings.count, sizeof(*ctx->keyBindings.sorted), searchKeyBinding);
-
-          if (binding) {
-            if ((*binding)->command != EOF) return *binding;
-            *isIncomplete = 1;
-          }
-        }
-      }
-
-      if (!(target.combination.flags & KCF_IMMEDIATE_KEY)) break;
-      if (target.combination.immediateKey.key == KTB_KEY_ANY) break;
-      target.combination.immediateKey.key = KTB_KEY_ANY;
-    }
-  }
-
+  if (ctx) return lookupKeyBinding(ctx, table->pressedKeys.table, table->pressedKeys.count, immediate, isIncomplete);
   return NULL;
 }
 
@@ -19,6 +19,7 @@
 #include "prologue.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "program.h"
@@ -27,7 +28,10 @@
 #include "file.h"
 #include "parse.h"
 #include "dynld.h"
+#include "timing.h"
 #include "ktb.h"
+#include "ktb_internal.h"
+#include "ktb_inspect.h"
 #include "ktb_keyboard.h"
 #include "brl.h"
 
@@ -35,6 +39,7 @@ static char *opt_driversDirectory;
 static char *opt_tablesDirectory;
 static int opt_listKeyNames;
 static int opt_listKeyTable;
+static int opt_timeKeyLookups;
 
 BEGIN_OPTION_TABLE(programOptions)
   { .letter = 'k',
@@ -51,6 +56,13 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("List key table on standard output.")
   },
 
+  { .letter = 't',
+    .word = "time",
+    .flags = OPT_Config | OPT_Environ,
+    .setting.flag = &opt_timeKeyLookups,
+    .description = strtext("Time key binding lookups and check them against a full search.")
+  },
+
   { .letter = 'D',
     .word = "drivers-directory",
     .flags = OPT_Hidden | OPT_Config | OPT_Environ,
@@ -78,6 +90,208 @@ listLine (const wchar_t *line, void *data) {
   return !ferror(stream);
 }
 
+#define LOOKUP_RANDOM_CHORDS 1000
+#define LOOKUP_REPETITIONS 100
+
+typedef struct {
+  KeyValue keys[MAX_MODIFIERS_PER_COMBINATION];
+  unsigned char count;
+  unsigned hasImmediate:1;
+  KeyValue immediate;
+} LookupChord;
+
+typedef const KeyBinding *KeyBindingFinder (
+  const KeyContext *ctx,
+  const KeyValue *keys, unsigned int count,
+  const KeyValue *immediate, int *isIncomplete
+);
+
+static int
+sortChordKeys (const void *element1, const void *element2) {
+  return compareKeyValues(element1, element2);
+}
+
+static void
+addChordKey (LookupChord *chord, const KeyValue *value) {
+  unsigned int index;
+
+  for (index=0; index<chord->count; index+=1) {
+    if (compareKeyValues(&chord->keys[index], value) == 0) return;
+  }
+
+  chord->keys[chord->count++] = *value;
+}
+
+static KeyValue
+getConcreteKey (const KeyValue *value, unsigned int variant) {
+  KeyValue key = *value;
+
+  if (key.key == KTB_KEY_ANY) key.key = variant % 4;
+  return key;
+}
+
+static unsigned long int
+timeKeyBindingFinder (KeyBindingFinder *find, const KeyContext *ctx, const LookupChord *chords, unsigned int count) {
+  TimeValue start;
+  TimeValue end;
+  unsigned int repetition;
+
+  getMonotonicTime(&start);
+
+  for (repetition=0; repetition<LOOKUP_REPETITIONS; repetition+=1) {
+    const LookupChord *chord = chords;
+    const LookupChord *last = chord + count;
+
+    while (chord < last) {
+      int isIncomplete = 0;
+
+      find(ctx, chord->keys, chord->count, (chord->hasImmediate? &chord->immediate: NULL), &isIncomplete);
+      chord += 1;
+    }
+  }
+
+  getMonotonicTime(&end);
+  return (((end.seconds - start.seconds) * NSECS_PER_SEC) + (end.nanoseconds - start.nanoseconds))
+       / ((unsigned long int)count * LOOKUP_REPETITIONS);
+}
+
+static int
+timeKeyContextLookups (KeyTable *table, unsigned char context, const KeyValue *pool, unsigned int poolCount) {
+  const KeyContext *ctx = getKeyContext(table, context);
+  if (!ctx || !ctx->keyBindings.count) return 1;
+
+  {
+    unsigned int chordCount = (ctx->keyBindings.count * 2) + LOOKUP_RANDOM_CHORDS;
+    LookupChord *chords = malloc(ARRAY_SIZE(chords, chordCount));
+
+    if (chords) {
+      unsigned int count = 0;
+      unsigned int mismatches = 0;
+
+      {
+        const KeyBinding *binding = ctx->keyBindings.table;
+        const KeyBinding *end = binding + ctx->keyBindings.count;
+
+        while (binding < end) {
+          const KeyCombination *combination = &binding->combination;
+          LookupChord *chord = &chords[count++];
+          unsigned int index;
+
+          chord->count = 0;
+          chord->hasImmediate = 0;
+
+          for (index=0; index<combination->modifierCount; index+=1) {
+            KeyValue key = getConcreteKey(&combination->modifierKeys[index], count+index);
+            addChordKey(chord, &key);
+          }
+
+          qsort(chord->keys, chord->count, sizeof(*chord->keys), sortChordKeys);
+
+          if (combination->flags & KCF_IMMEDIATE_KEY) {
+            LookupChord *pressed = &chords[count++];
+
+            chord->hasImmediate = 1;
+            chord->immediate = getConcreteKey(&combination->immediateKey, count);
+
+            /* the same chord as seen once the immediate key is held */
+            *pressed = *chord;
+            pressed->hasImmediate = 0;
+
+            if (pressed->count < MAX_MODIFIERS_PER_COMBINATION) {
+              addChordKey(pressed, &chord->immediate);
+              qsort(pressed->keys, pressed->count, sizeof(*pressed->keys), sortChordKeys);
+            }
+          }
+
+          binding += 1;
+        }
+      }
+
+      if (poolCount) {
+        unsigned int index;
+
+        for (index=0; index<LOOKUP_RANDOM_CHORDS; index+=1) {
+          LookupChord *chord = &chords[count++];
+          unsigned int keys = 1 + (rand() % 6);
+
+          chord->count = 0;
+          while (keys--) addChordKey(chord, &pool[rand() % poolCount]);
+          qsort(chord->keys, chord->count, sizeof(*chord->keys), sortChordKeys);
+
+          if ((chord->hasImmediate = rand() & 1)) chord->immediate = pool[rand() % poolCount];
+        }
+      }
+
+      {
+        const LookupChord *chord = chords;
+        const LookupChord *end = chord + count;
+
+        while (chord < end) {
+          const KeyValue *immediate = chord->hasImmediate? &chord->immediate: NULL;
+          int searchIncomplete = 0;
+          int lookupIncomplete = 0;
+          const KeyBinding *searched = searchKeyBindings(ctx, chord->keys, chord->count, immediate, &searchIncomplete);
+          const KeyBinding *looked = lookupKeyBinding(ctx, chord->keys, chord->count, immediate, &lookupIncomplete);
+
+          if ((searchIncomplete != lookupIncomplete) || (!searched != !looked) ||
+              (searched && ((searched->command != looked->command) || compareKeyBindings(searched, looked)))) {
+            mismatches += 1;
+          }
+
+          chord += 1;
+        }
+      }
+
+      printf("context %u: %u chords, %u mismatches, search %luns, lookup %luns\n",
+             context, count, mismatches,
+             timeKeyBindingFinder(searchKeyBindings, ctx, chords, count),
+             timeKeyBindingFinder(lookupKeyBinding, ctx, chords, count));
+
+      free(chords);
+      return !mismatches;
+    } else {
+      logMallocError();
+    }
+  }
+
+  return 0;
+}
+
+static int
+timeKeyTableLookups (KeyTable *table) {
+  int ok = 1;
+  KeyValue pool[(table->keyNames.count * 4) + 1];
+  unsigned int poolCount = 0;
+
+  {
+    unsigned int index;
+
+    for (index=0; index<table->keyNames.count; index+=1) {
+      const KeyValue *value = &table->keyNames.table[index]->value;
+
+      if (value->key == KTB_KEY_ANY) {
+        unsigned int variant;
+
+        for (variant=0; variant<4; variant+=1) pool[poolCount++] = getConcreteKey(value, variant);
+      } else {
+        pool[poolCount++] = *value;
+      }
+    }
+  }
+
+  srand(1);
+
+  {
+    unsigned int context;
+
+    for (context=0; context<table->keyContexts.count; context+=1) {
+      if (!timeKeyContextLookups(table, context, pool, poolCount)) ok = 0;
+    }
+  }
+
+  return ok;
+}
+
 static KEY_NAME_TABLES_REFERENCE
 getKeyNameTables (const char *keyTableName) {
   KEY_NAME_TABLES_REFERENCE keyNameTables = NULL;
@@ -217,6 +431,10 @@ main (int argc, char *argv[]) {
               if (!listKeyTable(keyTable, listLine, NULL))
                 exitStatus = PROG_EXIT_FATAL;
 
+            if (opt_timeKeyLookups)
+              if (!timeKeyTableLookups(keyTable))
+                exitStatus = PROG_EXIT_FATAL;
+
             destroyKeyTable(keyTable);
           } else {
             exitStatus = PROG_EXIT_FATAL;
@@ -94,6 +94,21 @@ static const LogCategoryEntry logCategoryTable[LOG_CATEGORY_COUNT] = {
     .name = "csrrtg",
     .prefix = "cursor routing"
   },
+
+  [LOG_CATEGORY_INDEX(ASYNC_EVENTS)] = {
+    .name = "async",
+    .prefix = "async event"
+  },
+
+  [LOG_CATEGORY_INDEX(UPDATE_TIMING)] = {
+    .name = "updtim",
+    .prefix = "update timing"
+  },
+
+  [LOG_CATEGORY_INDEX(SPEECH_QUEUE)] = {
+    .name = "spkque",
+    .prefix = "speech queue"
+  },
 };
 
 unsigned char categoryLogLevel = LOG_WARNING;
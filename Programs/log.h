@@ -66,6 +66,10 @@ typedef enum {
   LOG_CATEGORY_INDEX(CURSOR_TRACKING),
   LOG_CATEGORY_INDEX(CURSOR_ROUTING),
 
+  LOG_CATEGORY_INDEX(ASYNC_EVENTS),
+  LOG_CATEGORY_INDEX(UPDATE_TIMING),
+  LOG_CATEGORY_INDEX(SPEECH_QUEUE),
+
   LOG_CATEGORY_COUNT /* must be last */
 } LogCategoryIndex;
 
@@ -21,94 +21,284 @@
 #include <string.h>
 #include <errno.h>
 
+#ifdef HAVE_POSIX_THREADS
+#ifdef __MINGW32__
+#include "win_pthread.h"
+#else /* __MINGW32__ */
+#include <pthread.h>
+#endif /* __MINGW32__ */
+#endif /* HAVE_POSIX_THREADS */
+
 #include "prefs.h"
 #include "log.h"
+#include "program.h"
 #include "pcm.h"
 #include "notes.h"
 
 char *opt_pcmDevice;
 
+typedef struct PcmToneStruct PcmTone;
+
+struct PcmToneStruct {
+  PcmTone *next;
+
+  unsigned int duration;
+  unsigned char note;
+  unsigned char volume;
+
+  int sampleRate;
+  int channelCount;
+  PcmAmplitudeFormat amplitudeFormat;
+
+  size_t size;
+  unsigned char bytes[];
+};
+
+#define PCM_TONE_HASH_SIZE 0X40
+#define PCM_TONE_CACHE_LIMIT 0X200000
+#define PCM_TONE_CHUNK_SIZE 0X100
+
+static PcmTone *pcmTones[PCM_TONE_HASH_SIZE];
+static size_t pcmToneCacheSize = 0;
+static int pcmTonesInitialized = 0;
+
+typedef struct PcmTuneStruct PcmTune;
+
+struct PcmTuneStruct {
+  PcmTune *next;
+  size_t length;
+  unsigned char bytes[];
+};
+
 struct NoteDeviceStruct {
   PcmDevice *pcm;
   int blockSize;
   int sampleRate;
   int channelCount;
   PcmAmplitudeFormat amplitudeFormat;
-  unsigned char *blockAddress;
-  size_t blockUsed;
+
+  PcmTune *tune;
+  size_t tuneSize;
+
+#ifdef HAVE_POSIX_THREADS
+  struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    PcmTune *first;
+    PcmTune *last;
+
+    unsigned started:1;
+    unsigned stop:1;
+  } player;
+#endif /* HAVE_POSIX_THREADS */
 };
 
-static NoteDevice *
-pcmConstruct (int errorLevel) {
-  NoteDevice *device;
+static void
+discardPcmTones (void) {
+  unsigned int index;
 
-  if ((device = malloc(sizeof(*device)))) {
-    if ((device->pcm = openPcmDevice(errorLevel, opt_pcmDevice))) {
-      device->blockSize = getPcmBlockSize(device->pcm);
-      device->sampleRate = getPcmSampleRate(device->pcm);
-      device->channelCount = getPcmChannelCount(device->pcm);
-      device->amplitudeFormat = getPcmAmplitudeFormat(device->pcm);
-      device->blockUsed = 0;
+  for (index=0; index<PCM_TONE_HASH_SIZE; index+=1) {
+    PcmTone *tone;
 
-      if ((device->blockAddress = malloc(device->blockSize))) {
-        logMessage(LOG_DEBUG, "PCM enabled: blk=%d rate=%d chan=%d fmt=%d",
-                   device->blockSize, device->sampleRate, device->channelCount, device->amplitudeFormat);
-        return device;
-      } else {
-        logMallocError();
-      }
+    while ((tone = pcmTones[index])) {
+      pcmTones[index] = tone->next;
+      free(tone);
+    }
+  }
+
+  pcmToneCacheSize = 0;
+}
+
+static void
+exitPcmTones (void *data) {
+  discardPcmTones();
+  pcmTonesInitialized = 0;
+}
 
-      closePcmDevice(device->pcm);
+static void
+renderPcmAmplitudes (
+  int16_t *amplitudes, uint32_t shift,
+  uint32_t shiftsPerSample, int32_t maximumAmplitude
+) {
+  /* A triangle waveform sounds nice, is lightweight, and avoids
+   * relying too much on floating-point performance and/or on
+   * expensive math functions like sin(). Considerations like
+   * these are especially important on PDAs without any FPU.
+   *
+   * A full wave is the whole 32-bit shift range so that the shift
+   * wraps by itself. The loop is branch-free and has a constant
+   * trip count so that the compiler can vectorize it.
+   */
+
+  const uint32_t shiftsPerQuarterWave = UINT32_C(1) << 30;
+  unsigned int index;
+
+  for (index=0; index<PCM_TONE_CHUNK_SIZE; index+=1) {
+    int32_t offset = shift - shiftsPerQuarterWave;
+    int32_t sign = offset >> 31;
+    uint32_t distance = ((uint32_t)offset ^ (uint32_t)sign) - (uint32_t)sign;
+    int32_t normalizedAmplitude = shiftsPerQuarterWave - distance;
+
+    amplitudes[index] = ((normalizedAmplitude >> 15) * maximumAmplitude) >> 15;
+    shift += shiftsPerSample;
+  }
+}
+
+static PcmTone *
+renderPcmTone (NoteDevice *device, unsigned char note, unsigned int duration, unsigned char volume) {
+  size_t sampleCount = device->sampleRate * duration / 1000;
+  size_t sampleLength = getPcmSampleLength(device->amplitudeFormat);
+  size_t frameSize = sampleLength * device->channelCount;
+  uint32_t shiftsPerSample = 0;
+  int32_t maximumAmplitude = 0;
+  PcmTone *tone;
+
+  if (note) {
+    const int32_t shiftsPerFullWave = INT32_C(1) << 30;
+
+    shiftsPerSample = (int32_t)((NOTE_FREQUENCY_TYPE)shiftsPerFullWave
+                              / (NOTE_FREQUENCY_TYPE)device->sampleRate
+                              * GET_NOTE_FREQUENCY(note));
+    shiftsPerSample <<= 2;
+    maximumAmplitude = INT16_MAX * volume / 100;
+
+    if (shiftsPerSample) {
+      /* finish the last wave so that the tone ends on a zero crossing */
+      const uint64_t fullWave = UINT64_C(1) << 32;
+      uint64_t waveCount = ((uint64_t)sampleCount * shiftsPerSample + fullWave - 1) / fullWave;
+      sampleCount = (waveCount * fullWave + shiftsPerSample - 1) / shiftsPerSample;
     }
+  }
 
-    free(device);
+  logMessage(LOG_DEBUG, "tone: msec=%d smct=%lu note=%d",
+             duration, (unsigned long)sampleCount, note);
+
+  if ((tone = malloc(sizeof(*tone) + (sampleCount * frameSize)))) {
+    uint32_t shift = 0;
+    unsigned char *frame = tone->bytes;
+    int16_t amplitudes[PCM_TONE_CHUNK_SIZE];
+
+    tone->next = NULL;
+    tone->duration = duration;
+    tone->note = note;
+    tone->volume = volume;
+    tone->sampleRate = device->sampleRate;
+    tone->channelCount = device->channelCount;
+    tone->amplitudeFormat = device->amplitudeFormat;
+    tone->size = sampleCount * frameSize;
+
+    if (frameSize) {
+      while (sampleCount > 0) {
+        size_t count = PCM_TONE_CHUNK_SIZE;
+        const int16_t *amplitude = amplitudes;
+
+        if (count > sampleCount) count = sampleCount;
+        sampleCount -= count;
+
+        renderPcmAmplitudes(amplitudes, shift, shiftsPerSample, maximumAmplitude);
+        shift += shiftsPerSample * PCM_TONE_CHUNK_SIZE;
+
+        while (count > 0) {
+          int channel;
+
+          makePcmSample(device->amplitudeFormat, *amplitude++, frame, sampleLength);
+
+          for (channel=1; channel<device->channelCount; channel+=1) {
+            memcpy(&frame[channel * sampleLength], frame, sampleLength);
+          }
+
+          frame += frameSize;
+          count -= 1;
+        }
+      }
+    }
+
+    return tone;
   } else {
     logMallocError();
   }
 
-  logMessage(LOG_DEBUG, "PCM not available");
   return NULL;
 }
 
-static int
-flushBytes (NoteDevice *device) {
-  int ok = writePcmData(device->pcm, device->blockAddress, device->blockUsed);
-  if (ok) device->blockUsed = 0;
-  return ok;
+static const PcmTone *
+getPcmTone (NoteDevice *device, unsigned char note, unsigned int duration) {
+  unsigned char volume = prefs.pcmVolume;
+  PcmTone **bucket = &pcmTones[(note ^ (duration * 31)) % PCM_TONE_HASH_SIZE];
+  PcmTone *tone = *bucket;
+
+  while (tone) {
+    if ((tone->note == note) &&
+        (tone->duration == duration) &&
+        (tone->volume == volume) &&
+        (tone->sampleRate == device->sampleRate) &&
+        (tone->channelCount == device->channelCount) &&
+        (tone->amplitudeFormat == device->amplitudeFormat)) {
+      return tone;
+    }
+
+    tone = tone->next;
+  }
+
+  if ((tone = renderPcmTone(device, note, duration, volume))) {
+    if ((pcmToneCacheSize + tone->size) > PCM_TONE_CACHE_LIMIT) discardPcmTones();
+    pcmToneCacheSize += tone->size;
+
+    tone->next = *bucket;
+    *bucket = tone;
+
+    if (!pcmTonesInitialized) {
+      pcmTonesInitialized = 1;
+      onProgramExit("pcm-tones", exitPcmTones, NULL);
+    }
+  }
+
+  return tone;
 }
 
 static int
-writeBytes (NoteDevice *device, const unsigned char *address, size_t length) {
-  while (length > 0) {
-    size_t count = device->blockSize - device->blockUsed;
-    if (length < count) count = length;
-    memcpy(&device->blockAddress[device->blockUsed], address, count);
-    address += count;
-    length -= count;
+addTuneBytes (NoteDevice *device, const unsigned char *bytes, size_t count) {
+  size_t length = device->tune? device->tune->length: 0;
+  size_t size = length + count;
+
+  if (size > device->tuneSize) {
+    size_t newSize = device->tuneSize? device->tuneSize: device->blockSize;
+    PcmTune *newTune;
 
-    if ((device->blockUsed += count) == device->blockSize)
-      if (!flushBytes(device))
-        return 0;
+    while (newSize < size) newSize <<= 1;
+
+    if (!(newTune = realloc(device->tune, sizeof(*newTune) + newSize))) {
+      logMallocError();
+      return 0;
+    }
+
+    newTune->length = length;
+    device->tune = newTune;
+    device->tuneSize = newSize;
   }
 
+  memcpy(&device->tune->bytes[length], bytes, count);
+  device->tune->length = size;
   return 1;
 }
 
 static int
-writeSample (NoteDevice *device, int amplitude) {
-  PcmAmplitudeFormat format = device->amplitudeFormat;
-  size_t length = getPcmSampleLength(format);
+addSilentFrames (NoteDevice *device, size_t count) {
+  size_t sampleLength = getPcmSampleLength(device->amplitudeFormat);
 
-  if (length) {
-    unsigned char buffer[length];
-    length = makePcmSample(format, amplitude, buffer, sizeof(buffer));
+  if (sampleLength) {
+    unsigned char sample[sampleLength];
+    makePcmSample(device->amplitudeFormat, 0, sample, sampleLength);
 
-    {
+    while (count > 0) {
       int channel;
 
       for (channel=0; channel<device->channelCount; channel+=1) {
-        if (!writeBytes(device, buffer, length)) return 0;
+        if (!addTuneBytes(device, sample, sampleLength)) return 0;
       }
+
+      count -= 1;
     }
   }
 
@@ -116,89 +306,181 @@ writeSample (NoteDevice *device, int amplitude) {
 }
 
 static int
-pcmPlay (NoteDevice *device, unsigned char note, unsigned int duration) {
-  long int sampleCount = device->sampleRate * duration / 1000;
+writeTune (NoteDevice *device, const PcmTune *tune) {
+  const unsigned char *address = tune->bytes;
+  size_t length = tune->length;
 
-  if (note) {
-    /* A triangle waveform sounds nice, is lightweight, and avoids
-     * relying too much on floating-point performance and/or on
-     * expensive math functions like sin(). Considerations like
-     * these are especially important on PDAs without any FPU.
-     */ 
+  while (length > 0) {
+    size_t count = device->blockSize;
+    if (count > length) count = length;
 
-    int32_t positiveShiftsPerQuarterWave = INT32_MAX / 8;
-    int32_t negativeShiftsPerQuarterWave = -positiveShiftsPerQuarterWave;
+    if (!writePcmData(device->pcm, address, count)) return 0;
+    address += count;
+    length -= count;
+  }
 
-    int32_t positiveShiftsPerHalfWave = 2 * positiveShiftsPerQuarterWave;
-    int32_t negativeSiftsPerHalfWave = -positiveShiftsPerHalfWave;
+  return 1;
+}
 
-    int32_t positiveShiftsPerFullWave = 2 * positiveShiftsPerHalfWave;
-    int32_t currentShift = 0;
+#ifdef HAVE_POSIX_THREADS
+static void *
+runPcmPlayer (void *argument) {
+  NoteDevice *device = argument;
+
+  pthread_mutex_lock(&device->player.mutex);
+
+  while (1) {
+    /* the player only shares this list, guarded by its mutex, with
+     * the main thread - the program's queues aren't thread-safe
+     */
+    PcmTune *tune = device->player.first;
+
+    if (tune) {
+      if (!(device->player.first = tune->next)) device->player.last = NULL;
+      pthread_mutex_unlock(&device->player.mutex);
+      writeTune(device, tune);
+      free(tune);
+      pthread_mutex_lock(&device->player.mutex);
+    } else if (device->player.stop) {
+      break;
+    } else {
+      pthread_cond_wait(&device->player.condition, &device->player.mutex);
+    }
+  }
 
-    int32_t shiftsPerSample = (NOTE_FREQUENCY_TYPE)positiveShiftsPerFullWave 
-                            / (NOTE_FREQUENCY_TYPE)device->sampleRate
-                            * GET_NOTE_FREQUENCY(note);
+  pthread_mutex_unlock(&device->player.mutex);
+  return NULL;
+}
 
-    int32_t maximumAmplitude = INT16_MAX * prefs.pcmVolume / 100;
-    int32_t amplitudeGranularity = positiveShiftsPerQuarterWave / maximumAmplitude;
+static void
+startPcmPlayer (NoteDevice *device) {
+  device->player.started = 0;
+  device->player.stop = 0;
+  device->player.first = NULL;
+  device->player.last = NULL;
+
+  pthread_mutex_init(&device->player.mutex, NULL);
+  pthread_cond_init(&device->player.condition, NULL);
+
+  if (!pthread_create(&device->player.thread, NULL, runPcmPlayer, device)) {
+    device->player.started = 1;
+    return;
+  }
 
-    logMessage(LOG_DEBUG, "tone: msec=%d smct=%lu note=%d",
-               duration, sampleCount, note);
+  logSystemError("pthread_create");
+  pthread_cond_destroy(&device->player.condition);
+  pthread_mutex_destroy(&device->player.mutex);
+}
 
-    while (sampleCount > 0) {
-      do {
-        {
-          int32_t normalizedAmplitude = positiveShiftsPerHalfWave - currentShift;
+static void
+stopPcmPlayer (NoteDevice *device) {
+  if (device->player.started) {
+    /* the player finishes the queued tunes before it stops */
+    pthread_mutex_lock(&device->player.mutex);
+    device->player.stop = 1;
+    pthread_cond_signal(&device->player.condition);
+    pthread_mutex_unlock(&device->player.mutex);
+
+    pthread_join(device->player.thread, NULL);
+    pthread_cond_destroy(&device->player.condition);
+    pthread_mutex_destroy(&device->player.mutex);
+    device->player.started = 0;
+  }
+}
+#endif /* HAVE_POSIX_THREADS */
 
-          if (normalizedAmplitude > positiveShiftsPerQuarterWave) {
-            normalizedAmplitude = positiveShiftsPerHalfWave - normalizedAmplitude;
-          } else if (normalizedAmplitude < negativeShiftsPerQuarterWave) {
-            normalizedAmplitude = negativeSiftsPerHalfWave - normalizedAmplitude;
-          }
+static NoteDevice *
+pcmConstruct (int errorLevel) {
+  NoteDevice *device;
 
-          {
-            int32_t actualAmplitude = normalizedAmplitude / amplitudeGranularity;
-            if (!writeSample(device, actualAmplitude)) return 0;
-            sampleCount -= 1;
-          }
-        }
-      } while ((currentShift += shiftsPerSample) < positiveShiftsPerFullWave);
+  if ((device = malloc(sizeof(*device)))) {
+    if ((device->pcm = openPcmDevice(errorLevel, opt_pcmDevice))) {
+      device->blockSize = getPcmBlockSize(device->pcm);
+      device->sampleRate = getPcmSampleRate(device->pcm);
+      device->channelCount = getPcmChannelCount(device->pcm);
+      device->amplitudeFormat = getPcmAmplitudeFormat(device->pcm);
+      device->tune = NULL;
+      device->tuneSize = 0;
 
-      do {
-        currentShift -= positiveShiftsPerFullWave;
-      } while (currentShift >= positiveShiftsPerFullWave);
-    }
-  } else {
-    logMessage(LOG_DEBUG, "tone: msec=%d smct=%lu note=%d",
-               duration, sampleCount, note);
+#ifdef HAVE_POSIX_THREADS
+      startPcmPlayer(device);
+#endif /* HAVE_POSIX_THREADS */
 
-    while (sampleCount > 0) {
-      if (!writeSample(device, 0)) return 0;
-      --sampleCount;
+      logMessage(LOG_DEBUG, "PCM enabled: blk=%d rate=%d chan=%d fmt=%d",
+                 device->blockSize, device->sampleRate, device->channelCount, device->amplitudeFormat);
+      return device;
     }
+
+    free(device);
+  } else {
+    logMallocError();
   }
 
-  return 1;
+  logMessage(LOG_DEBUG, "PCM not available");
+  return NULL;
 }
 
 static int
-flushBlock (NoteDevice *device) {
-  while (device->blockUsed)
-    if (!writeSample(device, 0))
-      return 0;
+pcmPlay (NoteDevice *device, unsigned char note, unsigned int duration) {
+  const PcmTone *tone = getPcmTone(device, note, duration);
 
-  return 1;
+  if (!tone) return 0;
+  return addTuneBytes(device, tone->bytes, tone->size);
 }
 
 static int
 pcmFlush (NoteDevice *device) {
-  return flushBlock(device);
+  PcmTune *tune = device->tune;
+
+  if (tune) {
+    size_t frameSize = getPcmSampleLength(device->amplitudeFormat) * device->channelCount;
+    size_t partial = tune->length % device->blockSize;
+
+    if (partial && frameSize) {
+      if (!addSilentFrames(device, (device->blockSize - partial + frameSize - 1) / frameSize)) return 0;
+      tune = device->tune;
+    }
+
+    device->tune = NULL;
+    device->tuneSize = 0;
+
+#ifdef HAVE_POSIX_THREADS
+    if (device->player.started) {
+      tune->next = NULL;
+
+      pthread_mutex_lock(&device->player.mutex);
+      if (device->player.last) {
+        device->player.last->next = tune;
+      } else {
+        device->player.first = tune;
+      }
+      device->player.last = tune;
+      pthread_cond_signal(&device->player.condition);
+      pthread_mutex_unlock(&device->player.mutex);
+
+      return 1;
+    }
+#endif /* HAVE_POSIX_THREADS */
+
+    {
+      int ok = writeTune(device, tune);
+      free(tune);
+      return ok;
+    }
+  }
+
+  return 1;
 }
 
 static void
 pcmDestruct (NoteDevice *device) {
-  flushBlock(device);
-  free(device->blockAddress);
+  pcmFlush(device);
+
+#ifdef HAVE_POSIX_THREADS
+  stopPcmPlayer(device);
+#endif /* HAVE_POSIX_THREADS */
+
+  if (device->tune) free(device->tune);
   closePcmDevice(device->pcm);
   free(device);
   logMessage(LOG_DEBUG, "PCM disabled");
@@ -34,6 +34,7 @@
 #include "log.h"
 #include "program.h"
 #include "timing.h"
+#include "async.h"
 #include "scr.h"
 #include "routing.h"
 
@@ -47,6 +48,17 @@
 #define ROUTING_NICENESS	10	/* niceness of cursor routing subprocess */
 #define ROUTING_INTERVAL	1	/* how often to check for response */
 #define ROUTING_TIMEOUT	2000	/* max wait for response to key press */
+#define ROUTING_MONITOR_INTERVAL 10	/* how often to check when the screen reports its updates */
+
+/*
+ * Once the application has been seen to respond quickly enough to
+ * single key presses, horizontal motion is requested several keys at a
+ * time. The final key press is always sent on its own so that an
+ * overshoot can still be corrected.
+ */
+#define ROUTING_BATCH_SAMPLES	3	/* responses needed before batching */
+#define ROUTING_BATCH_RESPONSE	20	/* max average response time for batching */
+#define ROUTING_BATCH_LIMIT	16	/* max key presses per batch */
 
 typedef enum {
   CRR_DONE,
@@ -71,6 +83,12 @@ typedef struct {
 
   long timeSum;
   int timeCount;
+
+  long responseSum;
+  int responseCount;
+
+  int monitored;
+  int stepwise;
 } RoutingData;
 
 typedef enum {
@@ -111,13 +129,15 @@ typedef struct {
   const CursorDirectionEntry *forward;
   const CursorDirectionEntry *backward;
   void (*adjustCoordinate) (int *y, int *x, int amount);
+  unsigned canBatch:1;
 } CursorAxisEntry;
 
 static const CursorAxisEntry cursorAxisTable[] = {
   [CURSOR_AXIS_HORIZONTAL] = {
     .forward  = &cursorDirectionTable[CURSOR_DIR_RIGHT],
     .backward = &cursorDirectionTable[CURSOR_DIR_LEFT],
-    .adjustCoordinate = adjustHorizontalCoordinate
+    .adjustCoordinate = adjustHorizontalCoordinate,
+    .canBatch = 1
   }
   ,
   [CURSOR_AXIS_VERTICAL] = {
@@ -185,14 +205,14 @@ error:
 }
 
 static void
-moveCursor (RoutingData *routing, const CursorDirectionEntry *direction) {
+moveCursor (RoutingData *routing, const CursorDirectionEntry *direction, int count) {
 #ifdef SIGUSR1
   sigset_t oldMask;
   sigprocmask(SIG_BLOCK, &routing->signalMask, &oldMask);
 #endif /* SIGUSR1 */
 
-  logRouting("move: %s", direction->name);
-  insertScreenKey(direction->key);
+  logRouting("move: %s (%d)", direction->name, count);
+  while (count-- > 0) insertScreenKey(direction->key);
 
 #ifdef SIGUSR1
   sigprocmask(SIG_SETMASK, &oldMask, NULL);
@@ -200,7 +220,20 @@ moveCursor (RoutingData *routing, const CursorDirectionEntry *direction) {
 }
 
 static int
-awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *axis) {
+getBatchSize (RoutingData *routing, const CursorAxisEntry *axis, int distance) {
+  if (!axis->canBatch) return 1;
+  if (routing->stepwise) return 1;
+  if (routing->responseCount < ROUTING_BATCH_SAMPLES) return 1;
+  if ((routing->responseSum / routing->responseCount) > ROUTING_BATCH_RESPONSE) return 1;
+
+  if (distance < 0) distance = -distance;
+  if ((distance -= 1) < 1) return 1;
+  if (distance > ROUTING_BATCH_LIMIT) distance = ROUTING_BATCH_LIMIT;
+  return distance;
+}
+
+static int
+awaitCursorMotion (RoutingData *routing, int direction, int count, const CursorAxisEntry *axis) {
   int moved = 0;
   long int timeout = routing->timeSum / routing->timeCount;
   TimeValue start;
@@ -211,7 +244,7 @@ awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *a
   routing->oldy = routing->cury;
   routing->oldx = routing->curx;
 
-  axis->adjustCoordinate(&trgy, &trgx, direction);
+  axis->adjustCoordinate(&trgy, &trgx, direction*count);
   getMonotonicTime(&start);
 
   while (1) {
@@ -221,7 +254,12 @@ awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *a
     int oldy;
     int oldx;
 
-    approximateDelay(ROUTING_INTERVAL);
+    if (routing->monitored) {
+      awaitRoutingScreenUpdate(ROUTING_MONITOR_INTERVAL);
+    } else {
+      approximateDelay(ROUTING_INTERVAL);
+    }
+
     getMonotonicTime(&now);
     time = millisecondsBetween(&start, &now) + 1;
 
@@ -275,6 +313,9 @@ awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *a
 
         routing->timeSum += time * 8;
         routing->timeCount += 1;
+
+        routing->responseSum += time;
+        routing->responseCount += 1;
       }
 
       if ((routing->cury == trgy) && (routing->curx == trgx)) break;
@@ -302,19 +343,28 @@ adjustCursorPosition (RoutingData *routing, int where, int trgy, int trgx, const
     int dify = trgy - routing->cury;
     int difx = (trgx < 0)? 0: (trgx - routing->curx);
     int dir;
+    int count;
 
     /* determine which direction the cursor needs to move in */
     if (dify) {
       dir = (dify > 0)? 1: -1;
+      count = 1;
     } else if (difx) {
       dir = (difx > 0)? 1: -1;
+      count = getBatchSize(routing, axis, difx);
     } else {
       return CRR_DONE;
     }
 
     /* tell the cursor to move in the needed direction */
-    moveCursor(routing, ((dir > 0)? axis->forward: axis->backward));
-    if (!awaitCursorMotion(routing, dir, axis)) return CRR_FAIL;
+    moveCursor(routing, ((dir > 0)? axis->forward: axis->backward), count);
+    if (!awaitCursorMotion(routing, dir, count, axis)) return CRR_FAIL;
+
+    if ((count > 1) && (((routing->curx - routing->oldx) != (dir * count)) ||
+                        (routing->cury != routing->oldy))) {
+      logRouting("batch fell short: %d", count);
+      routing->stepwise = 1;
+    }
 
     if (routing->cury != routing->oldy) {
       if (routing->oldy != trgy) {
@@ -351,8 +401,8 @@ adjustCursorPosition (RoutingData *routing, int where, int trgy, int trgx, const
      * try going back to the previous position since it was obviously
      * the nearest ever reached.
      */
-    moveCursor(routing, ((dir > 0)? axis->backward: axis->forward));
-    return awaitCursorMotion(routing, -dir, axis)? CRR_NEAR: CRR_FAIL;
+    moveCursor(routing, ((dir > 0)? axis->backward: axis->forward), 1);
+    return awaitCursorMotion(routing, -dir, 1, axis)? CRR_NEAR: CRR_FAIL;
   }
 }
 
@@ -382,6 +432,10 @@ doRouting (int column, int row, int screen) {
   routing.rowBuffer = NULL;
   routing.timeSum = ROUTING_TIMEOUT;
   routing.timeCount = 1;
+  routing.responseSum = 0;
+  routing.responseCount = 0;
+  routing.monitored = isRoutingScreenMonitored();
+  routing.stepwise = 0;
 
   if (getCurrentPosition(&routing)) {
     logRouting("from: [%d,%d]", routing.curx, routing.cury);
@@ -494,6 +548,11 @@ startRouting (int column, int row, int screen) {
         }
       }
 
+      /* The routing screen's waits mustn't run the parent's asynchronous
+       * requests.
+       */
+      asyncAbandonRequests();
+
       if (constructRoutingScreen()) {
         result = doRouting(column, row, screen);		/* terminate child process */
         destructRoutingScreen();		/* close second thread of screen reading */
@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include "log.h"
+#include "async_wait.h"
 #include "message.h"
 #include "menu_prefs.h"
 #include "scr.h"
@@ -38,6 +39,7 @@
 #include "scr_frozen.h"
 #include "scr_real.h"
 #include "driver.h"
+#include "brltty.h"
 
 static HelpScreen helpScreen;
 static MenuScreen menuScreen;
@@ -45,6 +47,12 @@ static FrozenScreen frozenScreen;
 static MainScreen mainScreen;
 static BaseScreen *currentScreen = &mainScreen.base;
 
+static ScreenDamage screenDamage;
+static int screenDamageCurrent = 0;
+
+static int routingScreenConstructed = 0;
+static int routingScreenUpdated = 0;
+
 const char *const *
 getScreenParameters (const ScreenDriver *driver) {
   return driver->parameters;
@@ -80,6 +88,7 @@ constructScreenDriver (char **parameters) {
 
 void
 destructScreenDriver (void) {
+  deallocateScreenDamage(&screenDamage);
   mainScreen.destruct();
   mainScreen.releaseParameters();
 }
@@ -228,6 +237,67 @@ formatScreenTitle (char *buffer, size_t size) {
   return currentScreen->formatTitle(buffer, size);
 }
 
+int
+pollScreen (void) {
+  return currentScreen->poll();
+}
+
+static ScreenUpdatedHandler *screenUpdatedHandler = NULL;
+
+void
+setScreenUpdatedHandler (ScreenUpdatedHandler *handler) {
+  screenUpdatedHandler = handler;
+}
+
+void
+mainScreenUpdated (void) {
+  if (routingScreenConstructed) {
+    routingScreenUpdated = 1;
+  } else if (isLiveScreen()) {
+    if (screenUpdatedHandler) screenUpdatedHandler();
+  }
+}
+
+static BaseScreen *snapshotScreen = NULL;
+
+void
+endScreenSnapshot (void) {
+  if (snapshotScreen) {
+    snapshotScreen->endSnapshot();
+    snapshotScreen = NULL;
+  }
+}
+
+int
+beginScreenSnapshot (void) {
+  endScreenSnapshot();
+  screenDamageCurrent = 0;
+  if (!currentScreen->beginSnapshot()) return 0;
+
+  snapshotScreen = currentScreen;
+  return 1;
+}
+
+static const ScreenDamage *
+getScreenDamage (void) {
+  if (!screenDamageCurrent) {
+    updateScreenDamage(currentScreen, &screenDamage);
+    screenDamageCurrent = 1;
+  }
+
+  return &screenDamage;
+}
+
+unsigned int
+getScreenGeneration (void) {
+  return getScreenDamage()->generation;
+}
+
+int
+isScreenRowDirty (int row, unsigned int generation) {
+  return testScreenDamage(getScreenDamage(), row, generation);
+}
+
 void
 describeScreen (ScreenDescription *description) {
   describeBaseScreen(currentScreen, description);
@@ -320,6 +390,8 @@ constructRoutingScreen (void) {
    * in the main thread.  So we close and reopen the device.
    */
   mainScreen.destruct();
+  routingScreenConstructed = 1;
+  routingScreenUpdated = 0;
   return mainScreen.construct();
 }
 
@@ -327,6 +399,27 @@ void
 destructRoutingScreen (void) {
   mainScreen.destruct();
   mainScreen.releaseParameters();
+  routingScreenConstructed = 0;
+}
+
+int
+isRoutingScreenMonitored (void) {
+  return routingScreenConstructed && !mainScreen.base.poll();
+}
+
+static int
+testRoutingScreenUpdated (void *data) {
+  return routingScreenUpdated;
+}
+
+int
+awaitRoutingScreenUpdate (int timeout) {
+  int updated;
+
+  asyncAwaitCondition(timeout, testRoutingScreenUpdated, NULL);
+  updated = routingScreenUpdated;
+  routingScreenUpdated = 0;
+  return updated;
 }
 
 
@@ -163,6 +163,14 @@ extern void deactivateFrozenScreen (void);
 
 /* Routines which apply to the current screen. */
 extern size_t formatScreenTitle (char *buffer, size_t size);
+extern int pollScreen (void);
+extern void mainScreenUpdated (void);
+typedef void ScreenUpdatedHandler (void);
+extern void setScreenUpdatedHandler (ScreenUpdatedHandler *handler);
+extern int beginScreenSnapshot (void);
+extern void endScreenSnapshot (void);
+extern unsigned int getScreenGeneration (void);
+extern int isScreenRowDirty (int row, unsigned int generation);
 extern void describeScreen (ScreenDescription *);		/* get screen status */
 extern int readScreen (short left, short top, short width, short height, ScreenCharacter *buffer);
 extern int readScreenText (short left, short top, short width, short height, wchar_t *buffer);
@@ -185,6 +193,8 @@ extern KeyTableCommandContext getScreenCommandContext (void);
  */
 extern int constructRoutingScreen (void);
 extern void destructRoutingScreen (void);
+extern int isRoutingScreenMonitored (void);
+extern int awaitRoutingScreenUpdate (int timeout);
 
 /* Routines which apply to the help screen. */
 extern int constructHelpScreen (void);
@@ -21,6 +21,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "log.h"
+#include "bitmask.h"
 #include "scr.h"
 #include "scr_base.h"
 
@@ -105,6 +107,25 @@ formatTitle_BaseScreen (char *buffer, size_t size) {
   return 0;
 }
 
+static int
+poll_BaseScreen (void) {
+  return 1;
+}
+
+static int
+beginSnapshot_BaseScreen (void) {
+  return 1;
+}
+
+static void
+endSnapshot_BaseScreen (void) {
+}
+
+static int
+markChangedRows_BaseScreen (unsigned char *rows, int count) {
+  return 0;
+}
+
 static void
 describe_BaseScreen (ScreenDescription *description) {
   description->rows = 1;
@@ -164,6 +185,10 @@ initializeBaseScreen (BaseScreen *base) {
   base->selectVirtualTerminal = selectVirtualTerminal_BaseScreen;
   base->switchVirtualTerminal = switchVirtualTerminal_BaseScreen;
   base->currentVirtualTerminal = currentVirtualTerminal_BaseScreen;
+  base->poll = poll_BaseScreen;
+  base->beginSnapshot = beginSnapshot_BaseScreen;
+  base->endSnapshot = endSnapshot_BaseScreen;
+  base->markChangedRows = markChangedRows_BaseScreen;
   base->describe = describe_BaseScreen;
   base->readCharacters = readCharacters_BaseScreen;
   base->insertKey = insertKey_BaseScreen;
@@ -190,3 +215,92 @@ describeBaseScreen (BaseScreen *base, ScreenDescription *description) {
     description->unreadable = "unreadable screen";
   }
 }
+
+static int
+allocateScreenDamage (ScreenDamage *damage, int rows) {
+  size_t size = BITMASK_ELEMENT_COUNT(rows, BITMASK_ELEMENT_SIZE(unsigned char));
+
+  if (size > damage->dirtyRowsSize) {
+    unsigned char *dirtyRows;
+
+    if (!(dirtyRows = realloc(damage->dirtyRows, size))) {
+      logMallocError();
+      return 0;
+    }
+
+    damage->dirtyRows = dirtyRows;
+    damage->dirtyRowsSize = size;
+  }
+
+  return 1;
+}
+
+void
+updateScreenDamage (BaseScreen *base, ScreenDamage *damage) {
+  ScreenDescription description;
+  describeBaseScreen(base, &description);
+
+  if (allocateScreenDamage(damage, description.rows)) {
+    memset(damage->dirtyRows, 0, damage->dirtyRowsSize);
+
+    /* Only the driver knows (from its own snapshots) what has changed
+     * since it was last asked. */
+    if (base->markChangedRows(damage->dirtyRows, description.rows)) {
+      int changed = !damage->screen ||
+                    (base != damage->screen) ||
+                    (description.number != damage->description.number) ||
+                    (description.rows != damage->description.rows) ||
+                    (description.cols != damage->description.cols);
+
+      if (changed) {
+        memset(damage->dirtyRows, 0XFF, damage->dirtyRowsSize);
+      } else {
+        const unsigned char *byte = damage->dirtyRows;
+        const unsigned char *end = byte + damage->dirtyRowsSize;
+
+        while (byte < end) {
+          if (*byte++) {
+            changed = 1;
+            break;
+          }
+        }
+      }
+
+      damage->screen = base;
+      damage->description = description;
+      if (changed) damage->generation += 1;
+      return;
+    }
+  }
+
+  /* we don't know what's changed so we can't keep a reference */
+  damage->screen = NULL;
+  damage->description.rows = 0;
+  damage->generation += 1;
+}
+
+int
+testScreenDamage (const ScreenDamage *damage, int row, unsigned int generation) {
+  if (generation == damage->generation) return 0;
+
+  if (damage->screen) {
+    if ((generation + 1) == damage->generation) {
+      if ((row >= 0) && (row < damage->description.rows)) {
+        return !!BITMASK_TEST(damage->dirtyRows, row);
+      }
+    }
+  }
+
+  return 1;
+}
+
+void
+deallocateScreenDamage (ScreenDamage *damage) {
+  if (damage->dirtyRows) {
+    free(damage->dirtyRows);
+    damage->dirtyRows = NULL;
+  }
+
+  damage->dirtyRowsSize = 0;
+  damage->screen = NULL;
+}
@@ -30,6 +30,10 @@ extern void setKeyModifiers (ScreenKey *key, ScreenKey which);
 
 typedef struct {
   size_t (*formatTitle) (char *buffer, size_t size);
+  int (*poll) (void);
+  int (*beginSnapshot) (void);
+  void (*endSnapshot) (void);
+  int (*markChangedRows) (unsigned char *rows, int count);
   void (*describe) (ScreenDescription *);
   int (*readCharacters) (const ScreenBox *box, ScreenCharacter *buffer);
   int (*insertKey) (ScreenKey key);
@@ -47,6 +51,19 @@ typedef struct {
 extern void initializeBaseScreen (BaseScreen *);
 extern void describeBaseScreen (BaseScreen *, ScreenDescription *);
 
+typedef struct {
+  const BaseScreen *screen;
+  ScreenDescription description;
+  unsigned int generation;
+
+  unsigned char *dirtyRows;
+  size_t dirtyRowsSize;
+} ScreenDamage;
+
+extern void updateScreenDamage (BaseScreen *base, ScreenDamage *damage);
+extern int testScreenDamage (const ScreenDamage *damage, int row, unsigned int generation);
+extern void deallocateScreenDamage (ScreenDamage *damage);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -55,6 +55,11 @@ destruct_FrozenScreen (void) {
   }
 }
 
+static int
+poll_FrozenScreen (void) {
+  return 0;
+}
+
 static void
 describe_FrozenScreen (ScreenDescription *description) {
   *description = screenDescription;
@@ -82,6 +87,7 @@ currentVirtualTerminal_FrozenScreen (void) {
 void
 initializeFrozenScreen (FrozenScreen *frozen) {
   initializeBaseScreen(&frozen->base);
+  frozen->base.poll = poll_FrozenScreen;
   frozen->base.describe = describe_FrozenScreen;
   frozen->base.readCharacters = readCharacters_FrozenScreen;
   frozen->base.currentVirtualTerminal = currentVirtualTerminal_FrozenScreen;
@@ -31,6 +31,7 @@
 #include "prefs.h"
 #include "charset.h"
 #include "spk.h"
+#include "spk_queue.h"
 
 void
 initializeSpeechSynthesizer (SpeechSynthesizer *spk) {
@@ -60,8 +61,7 @@ sayCharacters (SpeechSynthesizer *spk, const char *characters, size_t count, int
       *b = 0;
     }
 
-    if (mute) speech->mute(spk);
-    speech->say(spk, bytes, b-bytes, count, NULL);
+    sayUtf8Characters(spk, bytes, NULL, b-bytes, count, mute);
   }
 }
 
@@ -93,7 +93,7 @@ int
 setSpeechVolume (SpeechSynthesizer *spk, int setting, int say) {
   if (!speech->setVolume) return 0;
   logMessage(LOG_DEBUG, "setting speech volume: %d", setting);
-  speech->setVolume(spk, setting);
+  changeSpeechVolume(spk, setting);
   if (say) sayIntegerSetting(spk, gettext("volume"), setting);
   return 1;
 }
@@ -114,7 +114,7 @@ int
 setSpeechRate (SpeechSynthesizer *spk, int setting, int say) {
   if (!speech->setRate) return 0;
   logMessage(LOG_DEBUG, "setting speech rate: %d", setting);
-  speech->setRate(spk, setting);
+  changeSpeechRate(spk, setting);
   if (say) sayIntegerSetting(spk, gettext("rate"), setting);
   return 1;
 }
@@ -159,7 +159,7 @@ int
 setSpeechPitch (SpeechSynthesizer *spk, int setting, int say) {
   if (!speech->setPitch) return 0;
   logMessage(LOG_DEBUG, "setting speech pitch: %d", setting);
-  speech->setPitch(spk, setting);
+  changeSpeechPitch(spk, setting);
   if (say) sayIntegerSetting(spk, gettext("pitch"), setting);
   return 1;
 }
@@ -180,7 +180,7 @@ int
 setSpeechPunctuation (SpeechSynthesizer *spk, SpeechPunctuation setting, int say) {
   if (!speech->setPunctuation) return 0;
   logMessage(LOG_DEBUG, "setting speech punctuation: %d", setting);
-  speech->setPunctuation(spk, setting);
+  changeSpeechPunctuation(spk, setting);
   return 1;
 }
 
@@ -0,0 +1,380 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+
+#include "prologue.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "timing.h"
+#include "queue.h"
+#include "async_alarm.h"
+#include "spk_queue.h"
+
+#define SPEECH_QUEUE_LOG_INTERVAL 10 /* seconds */
+
+typedef enum {
+  SPK_REQ_MUTE,
+  SPK_REQ_SAY,
+  SPK_REQ_VOLUME,
+  SPK_REQ_RATE,
+  SPK_REQ_PITCH,
+  SPK_REQ_PUNCTUATION
+} SpeechRequestType;
+
+typedef struct {
+  SpeechRequestType type;
+  SpeechSynthesizer *spk;
+  TimeValue time;
+
+  union {
+    struct {
+      const unsigned char *text;
+      const unsigned char *attributes;
+      size_t length;
+      size_t count;
+    } say;
+
+    unsigned char setting;
+  } arguments;
+} SpeechRequest;
+
+static int speechQueueEnabled = 0;
+static AsyncHandle speechQueueAlarm = NULL;
+
+static struct {
+  unsigned long int requests;
+  unsigned long int coalesced;
+  unsigned long int dispatched;
+  unsigned int maximumDepth;
+
+  unsigned long long int totalLatency;
+  unsigned long int maximumLatency;
+
+  TimeValue logTime;
+} speechQueueMetrics;
+
+static void
+deallocateSpeechRequest (void *item, void *data) {
+  SpeechRequest *request = item;
+
+  free(request);
+}
+
+static int
+compareSpeechRequests (const void *item1, const void *item2, void *data) {
+  const SpeechRequest *newRequest = item1;
+  const SpeechRequest *oldRequest = item2;
+
+  /* a mute goes ahead of everything except another mute */
+  return (newRequest->type == SPK_REQ_MUTE) && (oldRequest->type != SPK_REQ_MUTE);
+}
+
+static Queue *
+createSpeechQueue (void *data) {
+  return newQueue(deallocateSpeechRequest, compareSpeechRequests);
+}
+
+static Queue *
+getSpeechQueue (int create) {
+  static Queue *requests = NULL;
+
+  return getProgramQueue(&requests, "speech-queue", create,
+                         createSpeechQueue, NULL);
+}
+
+static int
+testSpeechRequestType (const void *item, const void *data) {
+  const SpeechRequest *request = item;
+  const SpeechRequestType *type = data;
+
+  return request->type == *type;
+}
+
+static void
+logSpeechQueueMetrics (int level) {
+  unsigned long int dispatched = speechQueueMetrics.dispatched;
+
+  logMessage(level,
+             "%lu requests, %lu coalesced, %lu dispatched, max depth %u, latency avg %lums, max %lums",
+             speechQueueMetrics.requests, speechQueueMetrics.coalesced, dispatched,
+             speechQueueMetrics.maximumDepth,
+             dispatched? (unsigned long int)(speechQueueMetrics.totalLatency / dispatched): 0,
+             speechQueueMetrics.maximumLatency);
+}
+
+static void
+executeSpeechRequest (const SpeechRequest *request) {
+  SpeechSynthesizer *spk = request->spk;
+
+  switch (request->type) {
+    case SPK_REQ_MUTE:
+      speech->mute(spk);
+      break;
+
+    case SPK_REQ_SAY:
+      speech->say(spk, request->arguments.say.text, request->arguments.say.length,
+                  request->arguments.say.count, request->arguments.say.attributes);
+      break;
+
+    case SPK_REQ_VOLUME:
+      if (speech->setVolume) speech->setVolume(spk, request->arguments.setting);
+      break;
+
+    case SPK_REQ_RATE:
+      if (speech->setRate) speech->setRate(spk, request->arguments.setting);
+      break;
+
+    case SPK_REQ_PITCH:
+      if (speech->setPitch) speech->setPitch(spk, request->arguments.setting);
+      break;
+
+    case SPK_REQ_PUNCTUATION:
+      if (speech->setPunctuation) speech->setPunctuation(spk, request->arguments.setting);
+      break;
+
+    default:
+      logMessage(LOG_WARNING, "unimplemented speech request type: %u", request->type);
+      break;
+  }
+}
+
+static void
+handleSpeechQueueAlarm (const AsyncAlarmResult *result) {
+  Queue *queue = getSpeechQueue(0);
+
+  asyncDiscardHandle(speechQueueAlarm);
+  speechQueueAlarm = NULL;
+
+  if (queue) {
+    SpeechRequest *request = dequeueItem(queue);
+
+    if (request) {
+      unsigned long int latency = getMonotonicElapsed(&request->time);
+
+      speechQueueMetrics.dispatched += 1;
+      speechQueueMetrics.totalLatency += latency;
+      if (latency > speechQueueMetrics.maximumLatency) speechQueueMetrics.maximumLatency = latency;
+
+      executeSpeechRequest(request);
+      deallocateSpeechRequest(request, NULL);
+    }
+
+    if (getQueueSize(queue) > 0) {
+      asyncSetAlarmIn(&speechQueueAlarm, 0, handleSpeechQueueAlarm, NULL);
+    }
+  }
+
+  if (LOG_CATEGORY_FLAG(SPEECH_QUEUE)) {
+    TimeValue now;
+
+    getMonotonicTime(&now);
+
+    if ((now.seconds - speechQueueMetrics.logTime.seconds) >= SPEECH_QUEUE_LOG_INTERVAL) {
+      speechQueueMetrics.logTime = now;
+      logSpeechQueueMetrics(LOG_CATEGORY(SPEECH_QUEUE));
+    }
+  }
+}
+
+static SpeechRequest *
+newSpeechRequest (SpeechRequestType type, SpeechSynthesizer *spk, size_t extra) {
+  SpeechRequest *request;
+
+  if ((request = malloc(sizeof(*request) + extra))) {
+    memset(request, 0, sizeof(*request));
+    request->type = type;
+    request->spk = spk;
+  } else {
+    logMallocError();
+  }
+
+  return request;
+}
+
+static void
+submitSpeechRequest (SpeechRequest *request) {
+  Queue *queue = getSpeechQueue(1);
+
+  if (queue) {
+    getMonotonicTime(&request->time);
+
+    if (enqueueItem(queue, request)) {
+      unsigned int depth = getQueueSize(queue);
+
+      speechQueueMetrics.requests += 1;
+      if (depth > speechQueueMetrics.maximumDepth) speechQueueMetrics.maximumDepth = depth;
+
+      if (!speechQueueAlarm) {
+        asyncSetAlarmIn(&speechQueueAlarm, 0, handleSpeechQueueAlarm, NULL);
+      }
+
+      return;
+    }
+  }
+
+  executeSpeechRequest(request);
+  deallocateSpeechRequest(request, NULL);
+}
+
+void
+setSpeechQueueEnabled (int enabled) {
+  if (!(speechQueueEnabled = enabled)) discardSpeechRequests();
+}
+
+void
+discardSpeechRequests (void) {
+  Queue *queue = getSpeechQueue(0);
+
+  if (queue) deleteElements(queue);
+}
+
+int
+isSpeechQueued (void) {
+  Queue *queue = getSpeechQueue(0);
+
+  return queue && (getQueueSize(queue) > 0);
+}
+
+void
+muteSpeech (SpeechSynthesizer *spk) {
+  if (speechQueueEnabled) {
+    Queue *queue = getSpeechQueue(0);
+
+    if (queue) {
+      static const SpeechRequestType say = SPK_REQ_SAY;
+      static const SpeechRequestType mute = SPK_REQ_MUTE;
+      Element *element;
+
+      /* nothing which hasn't been spoken yet is wanted anymore */
+      while ((element = findElement(queue, testSpeechRequestType, &say))) {
+        deleteElement(element);
+        speechQueueMetrics.coalesced += 1;
+      }
+
+      if (findItem(queue, testSpeechRequestType, &mute)) {
+        speechQueueMetrics.coalesced += 1;
+        return;
+      }
+    }
+
+    {
+      SpeechRequest *request = newSpeechRequest(SPK_REQ_MUTE, spk, 0);
+
+      if (request) submitSpeechRequest(request);
+    }
+  } else {
+    speech->mute(spk);
+  }
+}
+
+void
+sayUtf8Characters (
+  SpeechSynthesizer *spk,
+  const unsigned char *text, const unsigned char *attributes,
+  size_t length, size_t count, int immediate
+) {
+  if (immediate) muteSpeech(spk);
+
+  if (speechQueueEnabled) {
+    size_t extra = length + 1;
+    SpeechRequest *request;
+
+    if (attributes) extra += count;
+
+    if ((request = newSpeechRequest(SPK_REQ_SAY, spk, extra))) {
+      unsigned char *buffer = (unsigned char *)(request + 1);
+
+      memcpy(buffer, text, length);
+      buffer[length] = 0;
+      request->arguments.say.text = buffer;
+      buffer += length + 1;
+
+      if (attributes) {
+        memcpy(buffer, attributes, count);
+        request->arguments.say.attributes = buffer;
+      }
+
+      request->arguments.say.length = length;
+      request->arguments.say.count = count;
+      submitSpeechRequest(request);
+    }
+  } else {
+    speech->say(spk, text, length, count, attributes);
+  }
+}
+
+static void
+changeSpeechSetting (SpeechRequestType type, SpeechSynthesizer *spk, unsigned char setting) {
+  if (speechQueueEnabled) {
+    Queue *queue = getSpeechQueue(0);
+
+    if (queue) {
+      Element *element = getQueueTail(queue);
+
+      if (element) {
+        SpeechRequest *request = getElementItem(element);
+
+        /* only the last of several consecutive changes matters */
+        if ((request->type == type) && (request->spk == spk)) {
+          request->arguments.setting = setting;
+          speechQueueMetrics.coalesced += 1;
+          return;
+        }
+      }
+    }
+
+    {
+      SpeechRequest *request = newSpeechRequest(type, spk, 0);
+
+      if (request) {
+        request->arguments.setting = setting;
+        submitSpeechRequest(request);
+      }
+    }
+  } else {
+    SpeechRequest request = {
+      .type = type,
+      .spk = spk,
+      .arguments.setting = setting
+    };
+
+    executeSpeechRequest(&request);
+  }
+}
+
+void
+changeSpeechVolume (SpeechSynthesizer *spk, unsigned char setting) {
+  changeSpeechSetting(SPK_REQ_VOLUME, spk, setting);
+}
+
+void
+changeSpeechRate (SpeechSynthesizer *spk, unsigned char setting) {
+  changeSpeechSetting(SPK_REQ_RATE, spk, setting);
+}
+
+void
+changeSpeechPitch (SpeechSynthesizer *spk, unsigned char setting) {
+  changeSpeechSetting(SPK_REQ_PITCH, spk, setting);
+}
+
+void
+changeSpeechPunctuation (SpeechSynthesizer *spk, SpeechPunctuation setting) {
+  changeSpeechSetting(SPK_REQ_PUNCTUATION, spk, setting);
+}
@@ -0,0 +1,50 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+
+#ifndef BRLTTY_INCLUDED_SPK_QUEUE
+#define BRLTTY_INCLUDED_SPK_QUEUE
+
+#include "spk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+extern void setSpeechQueueEnabled (int enabled);
+extern void discardSpeechRequests (void);
+extern int isSpeechQueued (void);
+
+extern void sayUtf8Characters (
+  SpeechSynthesizer *spk,
+  const unsigned char *text, const unsigned char *attributes,
+  size_t length, size_t count, int immediate
+);
+
+extern void muteSpeech (SpeechSynthesizer *spk);
+
+extern void changeSpeechVolume (SpeechSynthesizer *spk, unsigned char setting);
+extern void changeSpeechRate (SpeechSynthesizer *spk, unsigned char setting);
+extern void changeSpeechPitch (SpeechSynthesizer *spk, unsigned char setting);
+extern void changeSpeechPunctuation (SpeechSynthesizer *spk, SpeechPunctuation setting);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_SPK_QUEUE */
@@ -0,0 +1,633 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+#include "log.h"
+#include "timing.h"
+#include "file.h"
+#include "charset.h"
+#include "datafile.h"
+#include "tblcache.h"
+
+/* A table cache file holds the compiled (offset-based) image of a table
+ * along with what is needed to tell whether it's still current: the
+ * format of the image, the character set that was in effect, and the
+ * size, modification time and content hash of every file that was read
+ * while compiling it (the table itself first, then its includes). The
+ * image's own hash is checked too so that a damaged file isn't used.
+ */
+
+#define TABLE_CACHE_MAGIC "BRLTBLC"
+#define TABLE_CACHE_VERSION 3
+#define TABLE_CACHE_ALIGNMENT 16
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t format;
+  char type[8];
+  char package[16];
+  char charset[32];
+  uint32_t dependencyCount;
+  uint32_t reserved;
+  uint64_t imageOffset;
+  uint64_t imageSize;
+  uint64_t imageHash;
+} TableCacheHeader;
+
+typedef struct {
+  uint64_t size;
+  int64_t modified;
+  uint64_t hash;
+  uint32_t nameLength; /* the name follows, padded to a multiple of 8 */
+  uint32_t reserved;
+} TableCacheDependency;
+
+typedef struct {
+  char *name;
+  TableCacheDependency status;
+} DependencyEntry;
+
+static int tableCacheEnabled = 0;
+
+static struct {
+  DependencyEntry *table;
+  unsigned int size;
+  unsigned int count;
+
+  unsigned active:1;
+  unsigned failed:1;
+} dependencies = {
+  .table = NULL,
+  .size = 0,
+  .count = 0,
+
+  .active = 0,
+  .failed = 0
+};
+
+struct TableCacheStruct {
+  void *address;
+  size_t size;
+  int64_t modified;
+  unsigned mapped:1;
+
+  const void *image;
+  size_t imageSize;
+};
+
+void
+setTableCacheEnabled (int enabled) {
+  tableCacheEnabled = enabled;
+}
+
+#define HASH_SEED UINT64_C(0XCBF29CE484222325)
+
+static uint64_t
+hashBytes (uint64_t hash, const void *bytes, size_t count) {
+  const unsigned char *byte = bytes;
+  const unsigned char *end = byte + count;
+
+  while (byte < end) {
+    hash ^= *byte++;
+    hash *= UINT64_C(0X100000001B3);
+  }
+
+  return hash;
+}
+
+static char *
+makeTableCachePath (const char *path, const char *type, unsigned int format) {
+  uint64_t hash = HASH_SEED;
+  char name[0X40];
+
+  hash = hashBytes(hash, type, strlen(type) + 1);
+  hash = hashBytes(hash, path, strlen(path) + 1);
+  hash = hashBytes(hash, &format, sizeof(format));
+
+  snprintf(name, sizeof(name), "table-%016" PRIx64 ".cache", hash);
+  return makeWritablePath(name);
+}
+
+static char *
+getDependencyPath (const char *name) {
+  const char *overrideDirectory = getOverrideDirectory();
+
+  if (overrideDirectory) {
+    char *path = makePath(overrideDirectory, locatePathName(name));
+
+    if (path) {
+      if (testFilePath(path)) return path;
+      free(path);
+    }
+  }
+
+  {
+    char *path = strdup(name);
+
+    if (!path) logMallocError();
+    return path;
+  }
+}
+
+static int
+getDependencyHash (const char *path, uint64_t *hash) {
+  FILE *stream;
+
+  if ((stream = fopen(path, "rb"))) {
+    int ok = 1;
+    unsigned char buffer[0X1000];
+    size_t count;
+
+    *hash = HASH_SEED;
+    while ((count = fread(buffer, 1, sizeof(buffer), stream))) *hash = hashBytes(*hash, buffer, count);
+    if (ferror(stream)) ok = 0;
+
+    fclose(stream);
+    return ok;
+  }
+
+  return 0;
+}
+
+static int64_t
+getModificationTime (const struct stat *info) {
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+  return ((int64_t)info->st_mtim.tv_sec * NSECS_PER_SEC) + info->st_mtim.tv_nsec;
+#else /* HAVE_STRUCT_STAT_ST_MTIM */
+  return (int64_t)info->st_mtime * NSECS_PER_SEC;
+#endif /* HAVE_STRUCT_STAT_ST_MTIM */
+}
+
+static int
+getDependencyStatus (
+  const char *name, TableCacheDependency *status,
+  const TableCacheDependency *reference, int64_t written
+) {
+  int ok = 0;
+  char *path = getDependencyPath(name);
+
+  if (path) {
+    struct stat info;
+
+    if (stat(path, &info) != -1) {
+      memset(status, 0, sizeof(*status));
+      status->size = info.st_size;
+      status->modified = getModificationTime(&info);
+
+      if (reference) {
+        if (status->size == reference->size) {
+          /* A file modified within a second of when the cache was written
+           * may have changed again without its timestamp changing.
+           */
+          if ((status->modified == reference->modified) &&
+              ((written - status->modified) >= NSECS_PER_SEC)) {
+            ok = 1;
+          } else if (getDependencyHash(path, &status->hash)) {
+            if (status->hash == reference->hash) ok = 1;
+          }
+        }
+      } else if (getDependencyHash(path, &status->hash)) {
+        ok = 1;
+      }
+    }
+
+    free(path);
+  }
+
+  return ok;
+}
+
+static void
+addTableCacheDependency (const char *name) {
+  if (!dependencies.failed) {
+    if (dependencies.count == dependencies.size) {
+      unsigned int newSize = dependencies.size? dependencies.size<<1: 0X10;
+      DependencyEntry *newTable = realloc(dependencies.table, ARRAY_SIZE(newTable, newSize));
+
+      if (!newTable) {
+        logMallocError();
+        dependencies.failed = 1;
+        return;
+      }
+
+      dependencies.table = newTable;
+      dependencies.size = newSize;
+    }
+
+    {
+      DependencyEntry *dependency = &dependencies.table[dependencies.count];
+
+      if ((dependency->name = strdup(name))) {
+        if (getDependencyStatus(name, &dependency->status, NULL, 0)) {
+          dependency->status.nameLength = strlen(name);
+          dependencies.count += 1;
+          return;
+        }
+
+        free(dependency->name);
+      } else {
+        logMallocError();
+      }
+    }
+
+    dependencies.failed = 1;
+  }
+}
+
+void
+startTableCacheDependencies (void) {
+  stopTableCacheDependencies();
+
+  if (tableCacheEnabled) {
+    dependencies.active = 1;
+    setDataFileObserver(addTableCacheDependency);
+  }
+}
+
+void
+stopTableCacheDependencies (void) {
+  if (dependencies.active) {
+    setDataFileObserver(NULL);
+    dependencies.active = 0;
+  }
+
+  while (dependencies.count) free(dependencies.table[--dependencies.count].name);
+  dependencies.failed = 0;
+}
+
+static size_t
+getPaddedLength (size_t length, size_t alignment) {
+  return (length + (alignment - 1)) / alignment * alignment;
+}
+
+static void
+setHeaderString (char *field, size_t size, const char *string) {
+  size_t length = strlen(string);
+
+  memcpy(field, string, MIN(length, size));
+}
+
+static void
+setTableCacheHeader (TableCacheHeader *header, const char *type, unsigned int format) {
+  memset(header, 0, sizeof(*header));
+  setHeaderString(header->magic, sizeof(header->magic), TABLE_CACHE_MAGIC);
+  header->version = TABLE_CACHE_VERSION;
+  header->format = format;
+  setHeaderString(header->type, sizeof(header->type), type);
+  setHeaderString(header->package, sizeof(header->package), PACKAGE_VERSION);
+  setHeaderString(header->charset, sizeof(header->charset), getCharset());
+}
+
+static int
+writeTableCacheBytes (FILE *stream, const void *bytes, size_t count, size_t *offset) {
+  static const unsigned char padding[TABLE_CACHE_ALIGNMENT] = {0};
+
+  if (!bytes) {
+    bytes = padding;
+    count = getPaddedLength(*offset, count) - *offset;
+  }
+
+  if (fwrite(bytes, 1, count, stream) != count) {
+    logSystemError("fwrite");
+    return 0;
+  }
+
+  *offset += count;
+  return 1;
+}
+
+static int
+writeTableCache (FILE *stream, const char *type, unsigned int format, const void *image, size_t size) {
+  TableCacheHeader header;
+  size_t offset = 0;
+
+  setTableCacheHeader(&header, type, format);
+  header.dependencyCount = dependencies.count;
+  header.imageSize = size;
+  header.imageHash = hashBytes(HASH_SEED, image, size);
+
+  {
+    unsigned int index;
+
+    header.imageOffset = sizeof(header);
+
+    for (index=0; index<dependencies.count; index+=1) {
+      header.imageOffset += sizeof(TableCacheDependency);
+      header.imageOffset += getPaddedLength(dependencies.table[index].status.nameLength, 8);
+    }
+
+    header.imageOffset = getPaddedLength(header.imageOffset, TABLE_CACHE_ALIGNMENT);
+  }
+
+  if (!writeTableCacheBytes(stream, &header, sizeof(header), &offset)) return 0;
+
+  {
+    unsigned int index;
+
+    for (index=0; index<dependencies.count; index+=1) {
+      const DependencyEntry *dependency = &dependencies.table[index];
+
+      if (!writeTableCacheBytes(stream, &dependency->status, sizeof(dependency->status), &offset)) return 0;
+      if (!writeTableCacheBytes(stream, dependency->name, dependency->status.nameLength, &offset)) return 0;
+      if (!writeTableCacheBytes(stream, NULL, 8, &offset)) return 0;
+    }
+  }
+
+  if (!writeTableCacheBytes(stream, NULL, TABLE_CACHE_ALIGNMENT, &offset)) return 0;
+  if (!writeTableCacheBytes(stream, image, size, &offset)) return 0;
+  return 1;
+}
+
+static FILE *
+createTableCacheFile (const char *cachePath, char **newPath) {
+  char extension[0X20];
+
+  /* each process writes its own file so that concurrent saves don't mix */
+  snprintf(extension, sizeof(extension), ".%ld.new", (long int)getpid());
+
+  if ((*newPath = ensureFileExtension(cachePath, extension))) {
+    int descriptor;
+    int removed = 0;
+
+    while ((descriptor = open(*newPath, O_WRONLY | O_CREAT | O_EXCL,
+                              S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) == -1) {
+      /* left behind by an earlier process which had the same pid */
+      if ((errno == EEXIST) && !removed && (unlink(*newPath) != -1)) {
+        removed = 1;
+        continue;
+      }
+
+      logMessage(LOG_WARNING, "cannot create table cache: %s: %s", *newPath, strerror(errno));
+      goto failed;
+    }
+
+    {
+      FILE *stream = fdopen(descriptor, "wb");
+
+      if (stream) return stream;
+      logSystemError("fdopen");
+    }
+
+    close(descriptor);
+    unlink(*newPath);
+
+  failed:
+    free(*newPath);
+    *newPath = NULL;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+void
+saveTableCache (const char *path, const char *type, unsigned int format, const void *image, size_t size) {
+  if (dependencies.active && !dependencies.failed && dependencies.count) {
+    char *cachePath = makeTableCachePath(path, type, format);
+
+    if (cachePath) {
+      char *newPath;
+      FILE *stream = createTableCacheFile(cachePath, &newPath);
+
+      if (stream) {
+        int ok = writeTableCache(stream, type, format, image, size);
+
+        if (ok && (fflush(stream) == EOF)) {
+          logSystemError("fflush");
+          ok = 0;
+        }
+
+#ifdef HAVE_FSYNC
+        if (ok && (fsync(fileno(stream)) == -1)) {
+          logSystemError("fsync");
+          ok = 0;
+        }
+#endif /* HAVE_FSYNC */
+
+        if (fclose(stream) == EOF) {
+          logSystemError("fclose");
+          ok = 0;
+        }
+
+        if (ok) {
+          if (rename(newPath, cachePath) != -1) {
+            logMessage(LOG_DEBUG, "table cache saved: %s -> %s", path, cachePath);
+          } else {
+            logSystemError("rename");
+            ok = 0;
+          }
+        }
+
+        if (!ok) unlink(newPath);
+        free(newPath);
+      }
+
+      free(cachePath);
+    }
+  }
+
+  stopTableCacheDependencies();
+}
+
+static int
+mapTableCache (TableCache *cache, const char *path) {
+  int ok = 0;
+  int descriptor;
+
+  if ((descriptor = open(path, O_RDONLY)) != -1) {
+    struct stat info;
+
+    if (fstat(descriptor, &info) != -1) {
+      cache->size = info.st_size;
+      cache->modified = getModificationTime(&info);
+
+      if (cache->size >= sizeof(TableCacheHeader)) {
+#ifdef HAVE_SYS_MMAN_H
+        void *address = mmap(NULL, cache->size, PROT_READ, MAP_SHARED, descriptor, 0);
+
+        if (address != MAP_FAILED) {
+          cache->address = address;
+          cache->mapped = 1;
+          ok = 1;
+        } else {
+          logSystemError("mmap");
+        }
+#else /* HAVE_SYS_MMAN_H */
+        if ((cache->address = malloc(cache->size))) {
+          ssize_t count = read(descriptor, cache->address, cache->size);
+
+          if (count == cache->size) {
+            cache->mapped = 0;
+            ok = 1;
+          } else {
+            if (count == -1) logSystemError("read");
+            free(cache->address);
+          }
+        } else {
+          logMallocError();
+        }
+#endif /* HAVE_SYS_MMAN_H */
+      }
+    } else {
+      logSystemError("fstat");
+    }
+
+    close(descriptor);
+  } else if (errno != ENOENT) {
+    logSystemError("open");
+  }
+
+  return ok;
+}
+
+static void
+unmapTableCache (TableCache *cache) {
+#ifdef HAVE_SYS_MMAN_H
+  if (cache->mapped) {
+    munmap(cache->address, cache->size);
+    return;
+  }
+#endif /* HAVE_SYS_MMAN_H */
+
+  free(cache->address);
+}
+
+static int
+verifyTableCache (const TableCache *cache, const char *path, const char *type, unsigned int format) {
+  const unsigned char *bytes = cache->address;
+  const TableCacheHeader *header = cache->address;
+  size_t offset = sizeof(*header);
+
+  {
+    TableCacheHeader expected;
+
+    setTableCacheHeader(&expected, type, format);
+    if (memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0) return 0;
+    if (header->version != expected.version) return 0;
+    if (header->format != expected.format) return 0;
+    if (memcmp(header->type, expected.type, sizeof(expected.type)) != 0) return 0;
+    if (memcmp(header->package, expected.package, sizeof(expected.package)) != 0) return 0;
+    if (memcmp(header->charset, expected.charset, sizeof(expected.charset)) != 0) return 0;
+  }
+
+  if (header->imageOffset > cache->size) return 0;
+  if (header->imageSize > (cache->size - header->imageOffset)) return 0;
+  if (header->imageOffset % TABLE_CACHE_ALIGNMENT) return 0;
+
+  if (hashBytes(HASH_SEED, &bytes[header->imageOffset], header->imageSize) != header->imageHash) {
+    logMessage(LOG_WARNING, "table cache damaged: %s", path);
+    return 0;
+  }
+
+  {
+    unsigned int index;
+
+    for (index=0; index<header->dependencyCount; index+=1) {
+      const TableCacheDependency *reference = (const void *)&bytes[offset];
+      TableCacheDependency status;
+
+      if ((offset += sizeof(*reference)) > header->imageOffset) return 0;
+      if (reference->nameLength > (header->imageOffset - offset)) return 0;
+
+      {
+        const char *characters = (const char *)&bytes[offset];
+        size_t length = reference->nameLength;
+        char name[length + 1];
+
+        memcpy(name, characters, length);
+        name[length] = 0;
+
+        if (!index && (strcmp(name, path) != 0)) return 0;
+
+        if (!getDependencyStatus(name, &status, reference, cache->modified)) {
+          logMessage(LOG_DEBUG, "table cache stale: %s: %s", path, name);
+          return 0;
+        }
+      }
+
+      offset += getPaddedLength(reference->nameLength, 8);
+    }
+
+    if (!index) return 0;
+  }
+
+  return 1;
+}
+
+TableCache *
+openTableCache (const char *path, const char *type, unsigned int format) {
+  if (tableCacheEnabled) {
+    char *cachePath = makeTableCachePath(path, type, format);
+
+    if (cachePath) {
+      TableCache *cache;
+
+      if ((cache = malloc(sizeof(*cache)))) {
+        memset(cache, 0, sizeof(*cache));
+
+        if (mapTableCache(cache, cachePath)) {
+          if (verifyTableCache(cache, path, type, format)) {
+            const TableCacheHeader *header = cache->address;
+
+            cache->image = (const unsigned char *)cache->address + header->imageOffset;
+            cache->imageSize = header->imageSize;
+
+            logMessage(LOG_DEBUG, "table cache loaded: %s <- %s", path, cachePath);
+            free(cachePath);
+            return cache;
+          }
+
+          unmapTableCache(cache);
+        }
+
+        free(cache);
+      } else {
+        logMallocError();
+      }
+
+      free(cachePath);
+    }
+  }
+
+  return NULL;
+}
+
+const void *
+getTableCacheImage (const TableCache *cache, size_t *size) {
+  *size = cache->imageSize;
+  return cache->image;
+}
+
+void
+closeTableCache (TableCache *cache) {
+  unmapTableCache(cache);
+  free(cache);
+}
@@ -0,0 +1,41 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_TBLCACHE
+#define BRLTTY_INCLUDED_TBLCACHE
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+extern void setTableCacheEnabled (int enabled);
+
+typedef struct TableCacheStruct TableCache;
+extern TableCache *openTableCache (const char *path, const char *type, unsigned int format);
+extern const void *getTableCacheImage (const TableCache *cache, size_t *size);
+extern void closeTableCache (TableCache *cache);
+
+extern void startTableCacheDependencies (void);
+extern void stopTableCacheDependencies (void);
+extern void saveTableCache (const char *path, const char *type, unsigned int format, const void *image, size_t size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_TBLCACHE */
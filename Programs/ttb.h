@@ -29,12 +29,14 @@ extern TextTable *textTable;
 
 extern TextTable *compileTextTable (const char *name);
 extern void destroyTextTable (TextTable *table);
+extern void cacheTextTable (TextTable *table);
 
 extern char *ensureTextTableExtension (const char *path);
 extern char *makeTextTablePath (const char *directory, const char *name);
 extern char *selectTextTable (const char *directory);
 
 extern unsigned char convertCharacterToDots (TextTable *table, wchar_t character);
+extern void convertCharactersToDots (TextTable *table, const wchar_t *characters, size_t count, unsigned char *dots);
 extern wchar_t convertDotsToCharacter (TextTable *table, unsigned char dots);
 
 extern int replaceTextTable (const char *directory, const char *name);
@@ -258,16 +258,50 @@ makeTextTable (TextTableData *ttd) {
   if (table) {
     table->header.fields = getTextTableHeader(ttd);
     table->size = getDataSize(ttd->area);
+    table->cache = NULL;
+    table->bmp = NULL;
     resetDataArea(ttd->area);
   }
 
   return table;
 }
 
+TextTable *
+openCachedTextTable (const char *name) {
+  TableCache *cache = openTableCache(name, TEXT_TABLE_EXTENSION, TEXT_TABLE_CACHE_FORMAT);
+
+  if (cache) {
+    TextTable *table = malloc(sizeof(*table));
+
+    if (table) {
+      table->header.bytes = getTableCacheImage(cache, &table->size);
+      table->cache = cache;
+      table->bmp = NULL;
+      return table;
+    } else {
+      logMallocError();
+    }
+
+    closeTableCache(cache);
+  }
+
+  return NULL;
+}
+
 void
 destroyTextTable (TextTable *table) {
+  if (table->bmp) {
+    free(table->bmp);
+    table->bmp = NULL;
+  }
+
   if (table->size) {
-    free(table->header.fields);
+    if (table->cache) {
+      closeTableCache(table->cache);
+    } else {
+      free(table->header.fields);
+    }
+
     free(table);
   }
 }
@@ -33,6 +33,7 @@ extern void destroyTextTableData (TextTableData *ttd);
 
 extern TextTableData *processTextTableLines (FILE *stream, const char *name, DataProcessor processor);
 extern TextTable *makeTextTable (TextTableData *ttd);
+extern TextTable *openCachedTextTable (const char *name);
 
 typedef TextTableData *TextTableProcessor (FILE *stream, const char *name);
 extern TextTableProcessor processTextTableStream;
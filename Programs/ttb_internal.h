@@ -25,9 +25,13 @@ extern "C" {
 
 #include "bitmask.h"
 #include "unicode.h"
+#include "tblcache.h"
 
 typedef uint32_t TextTableOffset;
 
+/* change this whenever the layout of the compiled table changes */
+#define TEXT_TABLE_CACHE_FORMAT 1
+
 #define CHARSET_BYTE_BITS 8
 #define CHARSET_BYTE_COUNT (1 << CHARSET_BYTE_BITS)
 #define CHARSET_BYTE_MAXIMUM (CHARSET_BYTE_COUNT - 1)
@@ -51,6 +55,12 @@ typedef struct {
   BITMASK(dotsCharacterDefined, 0X100, char);
 } TextTableHeader;
 
+#define TEXT_TABLE_BMP_CHARACTERS 0X10000
+
+typedef struct {
+  unsigned char dots[TEXT_TABLE_BMP_CHARACTERS];
+} TextTableBmpCache;
+
 struct TextTableStruct {
   union {
     TextTableHeader *fields;
@@ -58,6 +68,8 @@ struct TextTableStruct {
   } header;
 
   size_t size;
+  TableCache *cache;
+  TextTableBmpCache *bmp; /*resolved dots for the basic multilingual plane*/
 };
 
 #ifdef __cplusplus
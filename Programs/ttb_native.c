@@ -197,11 +197,17 @@ compileTextTable (const char *name) {
   TextTable *table = NULL;
   FILE *stream;
 
+  if ((table = openCachedTextTable(name))) return table;
+  startTableCacheDependencies();
+
   if ((stream = openDataFile(name, "r", 0))) {
     TextTableData *ttd;
 
     if ((ttd = processTextTableStream(stream, name))) {
-      table = makeTextTable(ttd);
+      if ((table = makeTextTable(ttd))) {
+        saveTableCache(name, TEXT_TABLE_EXTENSION, TEXT_TABLE_CACHE_FORMAT,
+                       table->header.bytes, table->size);
+      }
 
       destroyTextTableData(ttd);
     }
@@ -209,5 +215,6 @@ compileTextTable (const char *name) {
     fclose(stream);
   }
 
+  stopTableCacheDependencies();
   return table;
 }
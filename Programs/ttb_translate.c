@@ -33,7 +33,9 @@ static const unsigned char internalTextTableBytes[] = {
 
 static TextTable internalTextTable = {
   .header.bytes = internalTextTableBytes,
-  .size = 0
+  .size = 0,
+  .cache = NULL,
+  .bmp = NULL
 };
 
 TextTable *textTable = &internalTextTable;
@@ -104,8 +106,8 @@ setBrailleRepresentation (wchar_t character, void *data) {
   return 0;
 }
 
-unsigned char
-convertCharacterToDots (TextTable *table, wchar_t character) {
+static unsigned char
+translateCharacterToDots (TextTable *table, wchar_t character) {
   switch (character & ~UNICODE_CELL_MASK) {
     case UNICODE_BRAILLE_ROW:
       return character & UNICODE_CELL_MASK;
@@ -141,6 +143,57 @@ convertCharacterToDots (TextTable *table, wchar_t character) {
   }
 }
 
+static inline int
+isCachedCharacter (wchar_t character) {
+  if (character & ~(TEXT_TABLE_BMP_CHARACTERS - 1)) return 0;
+
+  /* This row depends on the current character set rather than on the table. */
+  if ((character & ~UNICODE_CELL_MASK) == 0XF000) return 0;
+
+  return 1;
+}
+
+unsigned char
+convertCharacterToDots (TextTable *table, wchar_t character) {
+  if (table->bmp && isCachedCharacter(character)) return table->bmp->dots[character];
+  return translateCharacterToDots(table, character);
+}
+
+void
+convertCharactersToDots (TextTable *table, const wchar_t *characters, size_t count, unsigned char *dots) {
+  const wchar_t *end = characters + count;
+
+  if (table->bmp) {
+    const unsigned char *bmp = table->bmp->dots;
+
+    while (characters < end) {
+      wchar_t character = *characters++;
+      *dots++ = isCachedCharacter(character)? bmp[character]: translateCharacterToDots(table, character);
+    }
+  } else {
+    while (characters < end) *dots++ = translateCharacterToDots(table, *characters++);
+  }
+}
+
+void
+cacheTextTable (TextTable *table) {
+  if (!table->bmp) {
+    TextTableBmpCache *bmp;
+
+    if ((bmp = malloc(sizeof(*bmp)))) {
+      wchar_t character;
+
+      for (character=0; character<TEXT_TABLE_BMP_CHARACTERS; character+=1) {
+        bmp->dots[character] = isCachedCharacter(character)? translateCharacterToDots(table, character): 0;
+      }
+
+      table->bmp = bmp;
+    } else {
+      logMallocError();
+    }
+  }
+}
+
 wchar_t
 convertDotsToCharacter (TextTable *table, unsigned char dots) {
   const TextTableHeader *header = table->header.fields;
@@ -171,8 +224,10 @@ replaceTextTable (const char *directory, const char *name) {
   if (newTable) {
     TextTable *oldTable = textTable;
 
+    cacheTextTable(newTable);
+
     textTable = newTable;
-    destroyTextTable(oldTable);
+    if (oldTable != newTable) destroyTextTable(oldTable);
     return 1;
   }
 
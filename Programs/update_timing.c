@@ -0,0 +1,238 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "timing.h"
+#include "message.h"
+#include "update_timing.h"
+
+#ifdef ENABLE_UPDATE_TIMING
+#define UPDATE_TIMING_BUCKETS 24 /* powers of two from 1us to 8s */
+#define UPDATE_TIMING_LOG_INTERVAL 10 /* seconds */
+
+typedef struct {
+  unsigned long int count;
+  unsigned long long int total;
+  unsigned long int maximum;
+  unsigned long int buckets[UPDATE_TIMING_BUCKETS];
+} UpdateHistogram;
+
+typedef struct {
+  const char *name;
+  TimeValue start;
+  unsigned long int elapsed;
+  unsigned active:1;
+  unsigned used:1;
+  UpdateHistogram histogram;
+} UpdateStageEntry;
+
+static UpdateStageEntry updateStageTable[] = {
+  [UPDATE_STAGE_SCREEN] = {.name = "screen"},
+  [UPDATE_STAGE_TRANSLATE] = {.name = "translate"},
+  [UPDATE_STAGE_WRITE] = {.name = "write"},
+  [UPDATE_STAGE_SPEECH] = {.name = "speech"},
+  [UPDATE_STAGE_CYCLE] = {.name = "cycle"}
+};
+
+static TimeValue updateTimingLogTime = {.seconds = 0};
+
+static unsigned long int
+getMicrosecondsSince (const TimeValue *start) {
+  TimeValue now;
+  long int microseconds;
+
+  getMonotonicTime(&now);
+  microseconds = (now.seconds - start->seconds) * USECS_PER_SEC;
+  microseconds += (now.nanoseconds - start->nanoseconds) / NSECS_PER_USEC;
+  return (microseconds > 0)? microseconds: 0;
+}
+
+static unsigned int
+getBucketIndex (unsigned long int microseconds) {
+  unsigned int index = 0;
+
+  while ((microseconds >>= 1)) {
+    if (++index == (UPDATE_TIMING_BUCKETS - 1)) break;
+  }
+
+  return index;
+}
+
+static void
+addHistogramSample (UpdateHistogram *histogram, unsigned long int microseconds) {
+  histogram->count += 1;
+  histogram->total += microseconds;
+  if (microseconds > histogram->maximum) histogram->maximum = microseconds;
+  histogram->buckets[getBucketIndex(microseconds)] += 1;
+}
+
+static unsigned long int
+getHistogramPercentile (const UpdateHistogram *histogram, unsigned int percent) {
+  unsigned long int threshold = ((histogram->count * percent) + 99) / 100;
+  unsigned long int count = 0;
+  unsigned int index;
+
+  for (index=0; index<UPDATE_TIMING_BUCKETS; index+=1) {
+    if ((count += histogram->buckets[index]) >= threshold) break;
+  }
+
+  return 1UL << (index + 1);
+}
+
+static void
+logUpdateStage (int level, const UpdateStageEntry *stage) {
+  const UpdateHistogram *histogram = &stage->histogram;
+
+  if (histogram->count) {
+    char buckets[0X200];
+    size_t length = 0;
+    unsigned int index;
+
+    for (index=0; index<UPDATE_TIMING_BUCKETS; index+=1) {
+      unsigned long int count = histogram->buckets[index];
+
+      if (count) {
+        int result = snprintf(&buckets[length], sizeof(buckets)-length,
+                              " <%luus:%lu", 1UL<<(index+1), count);
+
+        if ((result < 0) || (result >= (sizeof(buckets) - length))) break;
+        length += result;
+      }
+    }
+
+    buckets[length] = 0;
+    logMessage(level,
+               "%s: %lu samples, avg %luus, max %luus, p50 <%luus, p90 <%luus, p99 <%luus;%s",
+               stage->name, histogram->count,
+               (unsigned long int)(histogram->total / histogram->count),
+               histogram->maximum,
+               getHistogramPercentile(histogram, 50),
+               getHistogramPercentile(histogram, 90),
+               getHistogramPercentile(histogram, 99),
+               buckets);
+  }
+}
+
+static void
+logUpdateTimings (int level) {
+  const UpdateStageEntry *stage = updateStageTable;
+  const UpdateStageEntry *end = stage + ARRAY_COUNT(updateStageTable);
+
+  while (stage < end) logUpdateStage(level, stage++);
+}
+
+void
+startUpdateStage (UpdateStage stage) {
+  UpdateStageEntry *entry = &updateStageTable[stage];
+
+  getMonotonicTime(&entry->start);
+  entry->active = 1;
+}
+
+void
+stopUpdateStage (UpdateStage stage) {
+  UpdateStageEntry *entry = &updateStageTable[stage];
+
+  if (entry->active) {
+    entry->elapsed += getMicrosecondsSince(&entry->start);
+    entry->active = 0;
+    entry->used = 1;
+  }
+}
+
+void
+beginUpdateCycle (void) {
+  startUpdateStage(UPDATE_STAGE_CYCLE);
+}
+
+void
+endUpdateCycle (void) {
+  UpdateStageEntry *stage = updateStageTable;
+  UpdateStageEntry *end = stage + ARRAY_COUNT(updateStageTable);
+
+  stopUpdateStage(UPDATE_STAGE_CYCLE);
+
+  while (stage < end) {
+    stopUpdateStage(stage - updateStageTable);
+
+    if (stage->used) {
+      addHistogramSample(&stage->histogram, stage->elapsed);
+      stage->elapsed = 0;
+      stage->used = 0;
+    }
+
+    stage += 1;
+  }
+
+  if (LOG_CATEGORY_FLAG(UPDATE_TIMING)) {
+    TimeValue now;
+
+    getMonotonicTime(&now);
+
+    if ((now.seconds - updateTimingLogTime.seconds) >= UPDATE_TIMING_LOG_INTERVAL) {
+      updateTimingLogTime = now;
+      logUpdateTimings(LOG_CATEGORY(UPDATE_TIMING));
+    }
+  }
+}
+
+int
+showUpdateTimings (void) {
+  const UpdateStageEntry *cycle = &updateStageTable[UPDATE_STAGE_CYCLE];
+  char text[0X100];
+  size_t length = 0;
+
+  logUpdateTimings(LOG_INFO);
+  if (!cycle->histogram.count) return 0;
+
+  {
+    const UpdateStageEntry *stage = updateStageTable;
+    const UpdateStageEntry *end = stage + ARRAY_COUNT(updateStageTable);
+
+    while (stage < end) {
+      const UpdateHistogram *histogram = &stage->histogram;
+
+      if (histogram->count) {
+        int result = snprintf(&text[length], sizeof(text)-length, "%s%s %lu/%lu",
+                              (length? " ": ""), stage->name,
+                              (unsigned long int)(histogram->total / histogram->count),
+                              histogram->maximum);
+
+        if ((result < 0) || (result >= (sizeof(text) - length))) break;
+        length += result;
+      }
+
+      stage += 1;
+    }
+  }
+
+  text[length] = 0;
+  message(NULL, text, 0);
+  return 1;
+}
+#else /* ENABLE_UPDATE_TIMING */
+int
+showUpdateTimings (void) {
+  return 0;
+}
+#endif /* ENABLE_UPDATE_TIMING */
@@ -0,0 +1,54 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_UPDATE_TIMING
+#define BRLTTY_INCLUDED_UPDATE_TIMING
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef enum {
+  UPDATE_STAGE_SCREEN,
+  UPDATE_STAGE_TRANSLATE,
+  UPDATE_STAGE_WRITE,
+  UPDATE_STAGE_SPEECH,
+  UPDATE_STAGE_CYCLE,
+
+  UPDATE_STAGE_COUNT /* must be last */
+} UpdateStage;
+
+#ifdef ENABLE_UPDATE_TIMING
+extern void beginUpdateCycle (void);
+extern void endUpdateCycle (void);
+extern void startUpdateStage (UpdateStage stage);
+extern void stopUpdateStage (UpdateStage stage);
+#else /* ENABLE_UPDATE_TIMING */
+#define beginUpdateCycle()
+#define endUpdateCycle()
+#define startUpdateStage(stage)
+#define stopUpdateStage(stage)
+#endif /* ENABLE_UPDATE_TIMING */
+
+extern int showUpdateTimings (void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_UPDATE_TIMING */
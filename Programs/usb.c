@@ -169,6 +169,66 @@ usbGetSerialNumber (UsbDevice *device, int timeout) {
   return usbGetString(device, device->descriptor.iSerialNumber, timeout);
 }
 
+static size_t
+usbFormatIdentifiers (char *buffer, size_t size, const UsbDeviceDescriptor *descriptor) {
+  return snprintf(buffer, size, "%04X:%04X",
+                  getLittleEndian16(descriptor->idVendor),
+                  getLittleEndian16(descriptor->idProduct));
+}
+
+char *
+usbMakeDeviceFingerprint (UsbDevice *device) {
+  const UsbDeviceDescriptor *descriptor = usbDeviceDescriptor(device);
+  char *serialNumber = NULL;
+  char *fingerprint;
+
+  if (descriptor->iSerialNumber) serialNumber = usbGetSerialNumber(device, 1000);
+
+  {
+    char buffer[0X100];
+    size_t length = usbFormatIdentifiers(buffer, sizeof(buffer), descriptor);
+
+    if (serialNumber) {
+      snprintf(&buffer[length], sizeof(buffer)-length, ":%s", serialNumber);
+      free(serialNumber);
+    }
+
+    if (!(fingerprint = strdup(buffer))) logMallocError();
+  }
+
+  return fingerprint;
+}
+
+static int
+usbChooseFingerprint (UsbDevice *device, void *data) {
+  const char *fingerprint = data;
+  char identifiers[0X10];
+  size_t length = usbFormatIdentifiers(identifiers, sizeof(identifiers),
+                                       usbDeviceDescriptor(device));
+
+  if (strncmp(fingerprint, identifiers, length) == 0) {
+    char *actual = usbMakeDeviceFingerprint(device);
+
+    if (actual) {
+      int matches = strcmp(fingerprint, actual) == 0;
+
+      free(actual);
+      return matches;
+    }
+  }
+
+  return 0;
+}
+
+int
+usbHaveDeviceFingerprint (const char *fingerprint) {
+  UsbDevice *device = usbFindDevice(usbChooseFingerprint, (void *)fingerprint);
+
+  if (!device) return 0;
+  usbCloseDevice(device);
+  return 1;
+}
+
 void
 usbLogString (
   UsbDevice *device,
@@ -796,6 +856,26 @@ usbBeginInput (
   return actual;
 }
 
+typedef struct {
+  UsbDevice *device;
+  unsigned char endpointAddress;
+  UsbResponse *response;
+  void *request;
+  int error;
+} UsbPendingInputTest;
+
+static int
+usbTestPendingInput (void *data) {
+  UsbPendingInputTest *test = data;
+
+  if ((test->request = usbReapResponse(test->device, test->endpointAddress,
+                                       test->response, 0))) {
+    return 1;
+  }
+
+  return (test->error = errno) != EAGAIN;
+}
+
 int
 usbAwaitInput (
   UsbDevice *device,
@@ -857,6 +937,7 @@ usbAwaitInput (
   }
 
   {
+    int monitored = usbMonitorRequests(device);
     TimePeriod period;
 
     if (timeout) startTimePeriod(&period, timeout);
@@ -865,13 +946,41 @@ usbAwaitInput (
       UsbResponse response;
       void *request;
 
-      while (!(request = usbReapResponse(device,
-                                         endpointNumber | UsbEndpointDirection_Input,
-                                         &response, 0))) {
-        if (errno != EAGAIN) return 0;
-        if (!timeout) return 0;
-        if (afterTimePeriod(&period, NULL)) return 0;
-        asyncWait(interval);
+      if (monitored) {
+        UsbPendingInputTest test = {
+          .device = device,
+          .endpointAddress = endpointNumber | UsbEndpointDirection_Input,
+          .response = &response,
+          .request = NULL
+        };
+        long int elapsed;
+
+        if (afterTimePeriod(&period, &elapsed)) elapsed = timeout;
+
+        /* The monitor reaps every completed URB at once, after which usbfs
+         * is no longer writable, so a response which has already been
+         * reaped wouldn't wake the wait up.
+         */
+        if (!usbTestPendingInput(&test)) {
+          if (!asyncAwaitCondition(timeout - elapsed, usbTestPendingInput, &test)) {
+            errno = EAGAIN;
+            return 0;
+          }
+        }
+
+        if (!(request = test.request)) {
+          errno = test.error;
+          return 0;
+        }
+      } else {
+        while (!(request = usbReapResponse(device,
+                                           endpointNumber | UsbEndpointDirection_Input,
+                                           &response, 0))) {
+          if (errno != EAGAIN) return 0;
+          if (!timeout) return 0;
+          if (afterTimePeriod(&period, NULL)) return 0;
+          asyncWait(interval);
+        }
       }
 
       usbAddPendingInputRequest(endpoint);
@@ -1073,6 +1182,8 @@ usbGetChannelParameters (const char *identifier) {
   return getDeviceParameters(names, identifier);
 }
 
+static UsbChannel *usbLatestChannel = NULL;
+
 UsbChannel *
 usbOpenChannel (const UsbChannelDefinition *definitions, const char *identifier) {
   UsbChannel *channel = NULL;
@@ -1090,7 +1201,9 @@ usbOpenChannel (const UsbChannelDefinition *definitions, const char *identifier)
     if (!usbParseProductIdentifier(&choose.productIdentifier, parameters[USB_CHAN_PRODUCT_IDENTIFIER])) ok = 0;
 
     if (ok) {
-      if (!(channel = usbNewChannel(&choose))) {
+      if ((channel = usbNewChannel(&choose))) {
+        usbLatestChannel = channel;
+      } else {
         logMessage(LOG_DEBUG, "USB device not found%s%s",
                    (*identifier? ": ": ""), identifier);
       }
@@ -1104,10 +1217,17 @@ usbOpenChannel (const UsbChannelDefinition *definitions, const char *identifier)
 
 void
 usbCloseChannel (UsbChannel *channel) {
+  if (channel == usbLatestChannel) usbLatestChannel = NULL;
   usbCloseDevice(channel->device);
   free(channel);
 }
 
+char *
+usbGetChannelFingerprint (void) {
+  if (!usbLatestChannel) return NULL;
+  return usbMakeDeviceFingerprint(usbLatestChannel->device);
+}
+
 int
 isUsbDevice (const char **identifier) {
   return isQualifiedDevice(identifier, "usb");
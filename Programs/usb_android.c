@@ -691,6 +691,11 @@ usbReadDeviceDescriptor (UsbDevice *device) {
   return 1;
 }
 
+int
+usbMonitorRequests (UsbDevice *device) {
+  return 0;
+}
+
 int
 usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   UsbDevice *device = endpoint->device;
@@ -242,6 +242,11 @@ usbReadDeviceDescriptor (UsbDevice *device) {
   return 0;
 }
 
+int
+usbMonitorRequests (UsbDevice *device) {
+  return 0;
+}
+
 int
 usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   UsbDeviceExtension *devx = endpoint->device->extension;
@@ -678,6 +678,11 @@ error:
   return 0;
 }
 
+int
+usbMonitorRequests (UsbDevice *device) {
+  return 0;
+}
+
 int
 usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   UsbDeviceExtension *devx = endpoint->device->extension;
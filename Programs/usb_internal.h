@@ -114,6 +114,7 @@ extern ssize_t usbControlTransfer (
 );
 
 extern int usbReadDeviceDescriptor (UsbDevice *device);
+extern int usbMonitorRequests (UsbDevice *device);
 extern int usbAllocateEndpointExtension (UsbEndpoint *endpoint);
 extern void usbDeallocateEndpointExtension (UsbEndpointExtension *eptx);
 extern void usbDeallocateDeviceExtension (UsbDeviceExtension *devx);
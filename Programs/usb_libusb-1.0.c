@@ -374,6 +374,11 @@ usbReadDeviceDescriptor (UsbDevice *device) {
   return 0;
 }
 
+int
+usbMonitorRequests (UsbDevice *device) {
+  return 0;
+}
+
 int
 usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   return 1;
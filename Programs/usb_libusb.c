@@ -277,6 +277,11 @@ usbReadDeviceDescriptor (UsbDevice *device) {
   return 1;
 }
 
+int
+usbMonitorRequests (UsbDevice *device) {
+  return 0;
+}
+
 int
 usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   return 1;
@@ -41,6 +41,7 @@
 #include "file.h"
 #include "parse.h"
 #include "timing.h"
+#include "async_io.h"
 #include "async_wait.h"
 #include "mntpt.h"
 #include "io_usb.h"
@@ -57,6 +58,7 @@ static Queue *usbHostDevices = NULL;
 struct UsbDeviceExtensionStruct {
   const UsbHostDevice *host;
   int usbfsFile;
+  AsyncHandle usbfsMonitor;
 };
 
 struct UsbEndpointExtensionStruct {
@@ -78,6 +80,11 @@ usbOpenUsbfsFile (UsbDeviceExtension *devx) {
 
 static void
 usbCloseUsbfsFile (UsbDeviceExtension *devx) {
+  if (devx->usbfsMonitor) {
+    asyncCancelRequest(devx->usbfsMonitor);
+    devx->usbfsMonitor = NULL;
+  }
+
   if (devx->usbfsFile != -1) {
     close(devx->usbfsFile);
     devx->usbfsFile = -1;
@@ -382,9 +389,15 @@ usbReapUrb (
           UsbEndpointExtension *eptx = endpoint->extension;
 
           if (enqueueItem(eptx->completedRequests, urb)) return 1;
+          errno = ENOMEM;
           logSystemError("USB completed request enqueue");
-          free(urb);
+        } else {
+          logMessage(LOG_ERR, "USB completed request for unknown endpoint: urb=%p ept=%02X",
+                     urb, urb->endpoint);
+          errno = EIO;
         }
+
+        free(urb);
       } else {
         errno = EAGAIN;
       }
@@ -396,6 +409,36 @@ usbReapUrb (
   return 0;
 }
 
+static int
+usbHandleCompletedUrbs (const AsyncMonitorResult *result) {
+  UsbDevice *device = result->data;
+  UsbDeviceExtension *devx = device->extension;
+
+  while (usbReapUrb(device, 0));
+  if (errno == EAGAIN) return 1;
+
+  asyncDiscardHandle(devx->usbfsMonitor);
+  devx->usbfsMonitor = NULL;
+  return 0;
+}
+
+int
+usbMonitorRequests (UsbDevice *device) {
+  UsbDeviceExtension *devx = device->extension;
+
+  if (devx->usbfsMonitor) return 1;
+
+  if (usbOpenUsbfsFile(devx)) {
+    /* usbfs reports the descriptor as writable when a URB can be reaped */
+    if (asyncMonitorFileOutput(&devx->usbfsMonitor, devx->usbfsFile,
+                               usbHandleCompletedUrbs, device)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
 void *
 usbSubmitRequest (
   UsbDevice *device,
@@ -591,6 +634,23 @@ usbBulkTransfer (
   return -1;
 }
 
+typedef struct {
+  Queue *completedRequests;
+  struct usbdevfs_urb *urb;
+} UsbCompletedUrbTest;
+
+static int
+usbTestUrb (const void *item, const void *data) {
+  return item == data;
+}
+
+static int
+usbTestCompletedUrb (void *data) {
+  UsbCompletedUrbTest *test = data;
+
+  return !!findItem(test->completedRequests, usbTestUrb, test->urb);
+}
+
 static struct usbdevfs_urb *
 usbInterruptTransfer (
   UsbEndpoint *endpoint,
@@ -605,28 +665,42 @@ usbInterruptTransfer (
 
   if (urb) {
     UsbEndpointExtension *eptx = endpoint->extension;
-    int interval = endpoint->descriptor->bInterval + 1;
-    TimePeriod period;
-
-    if (timeout) startTimePeriod(&period, timeout);
+    UsbCompletedUrbTest test = {
+      .completedRequests = eptx->completedRequests,
+      .urb = urb
+    };
 
-    do {
-      if (usbReapUrb(device, 0) &&
-          deleteItem(eptx->completedRequests, urb)) {
+    if (usbMonitorRequests(device)) {
+      if (usbTestCompletedUrb(&test) ||
+          asyncAwaitCondition(timeout, usbTestCompletedUrb, &test)) {
+        deleteItem(eptx->completedRequests, urb);
         if (!urb->status) return urb;
         if ((errno = urb->status) < 0) errno = -errno;
         free(urb);
-        break;
+        return NULL;
       }
+    } else {
+      int interval = endpoint->descriptor->bInterval + 1;
+      TimePeriod period;
 
-      if (!timeout || afterTimePeriod(&period, NULL)) {
-        usbCancelRequest(device, urb);
-        errno = ETIMEDOUT;
-        break;
-      }
+      if (timeout) startTimePeriod(&period, timeout);
+
+      do {
+        if (usbReapUrb(device, 0) &&
+            deleteItem(eptx->completedRequests, urb)) {
+          if (!urb->status) return urb;
+          if ((errno = urb->status) < 0) errno = -errno;
+          free(urb);
+          return NULL;
+        }
+
+        if (!timeout || afterTimePeriod(&period, NULL)) break;
+        asyncWait(interval);
+      } while (1);
+    }
 
-      asyncWait(interval);
-    } while (1);
+    usbCancelRequest(device, urb);
+    errno = ETIMEDOUT;
   }
 
   return NULL;
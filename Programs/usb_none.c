@@ -162,6 +162,11 @@ usbReadDeviceDescriptor (UsbDevice *device) {
   return 0;
 }
 
+int
+usbMonitorRequests (UsbDevice *device) {
+  return 0;
+}
+
 int
 usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   return 1;
@@ -446,6 +446,11 @@ usbReadDeviceDescriptor (UsbDevice *device) {
   return 0;
 }
 
+int
+usbMonitorRequests (UsbDevice *device) {
+  return 0;
+}
+
 int
 usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   UsbDevice *device = endpoint->device;
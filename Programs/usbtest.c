@@ -0,0 +1,424 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2013 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://mielke.cc/brltty/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+/* usbtest.c - Test program for the USB input path
+ *
+ * The platform layer is replaced by a simulated device whose completed
+ * requests are signalled through a pipe, the way usbfs signals them by
+ * becoming writable, so the generic input code in usb.c can be checked
+ * without any hardware.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "program.h"
+#include "options.h"
+#include "log.h"
+#include "timing.h"
+#include "async_io.h"
+#include "async_alarm.h"
+#include "async_wait.h"
+#include "io_usb.h"
+#include "usb_internal.h"
+
+BEGIN_OPTION_TABLE(programOptions)
+END_OPTION_TABLE
+
+#define TEST_ENDPOINT 1
+#define TEST_PACKET_SIZE 8
+
+static const unsigned char testConfiguration[] = {
+  /* configuration */ 9, UsbDescriptorType_Configuration, 25, 0, 1, 1, 0, 0X80, 50,
+  /* interface */ 9, UsbDescriptorType_Interface, 0, 0, 1, 0XFF, 0, 0, 0,
+  /* endpoint */ 7, UsbDescriptorType_Endpoint,
+                 TEST_ENDPOINT | UsbEndpointDirection_Input,
+                 UsbEndpointTransfer_Interrupt, TEST_PACKET_SIZE, 0, 10
+};
+
+typedef struct {
+  void *context;
+  size_t size;
+  ssize_t count;
+  unsigned char buffer[];
+} TestRequest;
+
+struct UsbDeviceExtensionStruct {
+  int completionPipe[2];
+  AsyncHandle completionMonitor;
+
+  Queue *submittedRequests;
+  Queue *finishedRequests;
+  Queue *completedRequests;
+};
+
+static void
+deallocateTestRequest (void *item, void *data) {
+  free(item);
+}
+
+static int
+handleCompletedRequests (const AsyncMonitorResult *result) {
+  UsbDeviceExtension *devx = result->data;
+  unsigned char bytes[0X10];
+  TestRequest *request;
+
+  while (read(devx->completionPipe[0], bytes, sizeof(bytes)) > 0);
+
+  /* like the usbfs monitor, reap every finished request at once */
+  while ((request = dequeueItem(devx->finishedRequests))) {
+    enqueueItem(devx->completedRequests, request);
+  }
+
+  return 1;
+}
+
+static int
+finishTestRequest (UsbDeviceExtension *devx, const unsigned char *data, size_t length) {
+  TestRequest *request = dequeueItem(devx->submittedRequests);
+
+  if (request) {
+    if (length > request->size) length = request->size;
+    memcpy(request->buffer, data, (request->count = length));
+    enqueueItem(devx->finishedRequests, request);
+    if (write(devx->completionPipe[1], "", 1) == 1) return 1;
+  }
+
+  return 0;
+}
+
+int
+usbResetDevice (UsbDevice *device) {
+  errno = ENOSYS;
+  return 0;
+}
+
+int
+usbDisableAutosuspend (UsbDevice *device) {
+  errno = ENOSYS;
+  return 0;
+}
+
+int
+usbSetConfiguration (UsbDevice *device, unsigned char configuration) {
+  return 1;
+}
+
+int
+usbClaimInterface (UsbDevice *device, unsigned char interface) {
+  return 1;
+}
+
+int
+usbReleaseInterface (UsbDevice *device, unsigned char interface) {
+  return 1;
+}
+
+int
+usbSetAlternative (UsbDevice *device, unsigned char interface, unsigned char alternative) {
+  return 1;
+}
+
+ssize_t
+usbControlTransfer (
+  UsbDevice *device,
+  uint8_t direction,
+  uint8_t recipient,
+  uint8_t type,
+  uint8_t request,
+  uint16_t value,
+  uint16_t index,
+  void *buffer,
+  uint16_t length,
+  int timeout
+) {
+  if ((request == UsbStandardRequest_GetDescriptor) &&
+      ((value >> 8) == UsbDescriptorType_Configuration)) {
+    if (length > sizeof(testConfiguration)) length = sizeof(testConfiguration);
+    memcpy(buffer, testConfiguration, length);
+    return length;
+  }
+
+  errno = ENOSYS;
+  return -1;
+}
+
+void *
+usbSubmitRequest (
+  UsbDevice *device,
+  unsigned char endpointAddress,
+  void *buffer,
+  size_t length,
+  void *context
+) {
+  TestRequest *request;
+
+  if ((request = malloc(sizeof(*request) + length))) {
+    request->context = context;
+    request->size = length;
+    request->count = 0;
+    if (buffer) memcpy(request->buffer, buffer, length);
+    if (enqueueItem(device->extension->submittedRequests, request)) return request;
+    free(request);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+int
+usbCancelRequest (UsbDevice *device, void *request) {
+  UsbDeviceExtension *devx = device->extension;
+
+  if (deleteItem(devx->submittedRequests, request) ||
+      deleteItem(devx->finishedRequests, request) ||
+      deleteItem(devx->completedRequests, request)) {
+    free(request);
+    return 1;
+  }
+
+  return 0;
+}
+
+void *
+usbReapResponse (
+  UsbDevice *device,
+  unsigned char endpointAddress,
+  UsbResponse *response,
+  int wait
+) {
+  TestRequest *request = dequeueItem(device->extension->completedRequests);
+
+  if (request) {
+    response->context = request->context;
+    response->buffer = request->buffer;
+    response->size = request->size;
+    response->count = request->count;
+    response->error = 0;
+    return request;
+  }
+
+  errno = EAGAIN;
+  return NULL;
+}
+
+ssize_t
+usbReadEndpoint (
+  UsbDevice *device,
+  unsigned char endpointNumber,
+  void *buffer,
+  size_t length,
+  int timeout
+) {
+  errno = EAGAIN;
+  return -1;
+}
+
+ssize_t
+usbWriteEndpoint (
+  UsbDevice *device,
+  unsigned char endpointNumber,
+  const void *buffer,
+  size_t length,
+  int timeout
+) {
+  errno = ENOSYS;
+  return -1;
+}
+
+int
+usbReadDeviceDescriptor (UsbDevice *device) {
+  memset(&device->descriptor, 0, sizeof(device->descriptor));
+  device->descriptor.bLength = UsbDescriptorSize_Device;
+  device->descriptor.bDescriptorType = UsbDescriptorType_Device;
+  device->descriptor.bNumConfigurations = 1;
+  return 1;
+}
+
+int
+usbMonitorRequests (UsbDevice *device) {
+  UsbDeviceExtension *devx = device->extension;
+
+  if (devx->completionMonitor) return 1;
+  return asyncMonitorFileInput(&devx->completionMonitor, devx->completionPipe[0],
+                               handleCompletedRequests, devx);
+}
+
+int
+usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
+  return 1;
+}
+
+void
+usbDeallocateEndpointExtension (UsbEndpointExtension *eptx) {
+}
+
+void
+usbDeallocateDeviceExtension (UsbDeviceExtension *devx) {
+  if (devx->completionMonitor) asyncCancelRequest(devx->completionMonitor);
+  deallocateQueue(devx->completedRequests);
+  deallocateQueue(devx->finishedRequests);
+  deallocateQueue(devx->submittedRequests);
+  close(devx->completionPipe[0]);
+  close(devx->completionPipe[1]);
+  free(devx);
+}
+
+UsbDevice *
+usbFindDevice (UsbDeviceChooser chooser, void *data) {
+  UsbDeviceExtension *devx;
+
+  if ((devx = malloc(sizeof(*devx)))) {
+    memset(devx, 0, sizeof(*devx));
+
+    if (pipe(devx->completionPipe) != -1) {
+      fcntl(devx->completionPipe[0], F_SETFL, O_NONBLOCK);
+
+      if ((devx->submittedRequests = newQueue(deallocateTestRequest, NULL))) {
+        if ((devx->finishedRequests = newQueue(deallocateTestRequest, NULL))) {
+          if ((devx->completedRequests = newQueue(deallocateTestRequest, NULL))) {
+            UsbDevice *device = usbTestDevice(devx, chooser, data);
+
+            if (device) return device;
+            deallocateQueue(devx->completedRequests);
+          }
+
+          deallocateQueue(devx->finishedRequests);
+        }
+
+        deallocateQueue(devx->submittedRequests);
+      }
+
+      close(devx->completionPipe[0]);
+      close(devx->completionPipe[1]);
+    } else {
+      logSystemError("pipe");
+    }
+
+    free(devx);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+void
+usbForgetDevices (void) {
+}
+
+int
+usbSetSerialOperations (UsbDevice *device) {
+  return 1;
+}
+
+int
+usbSetSerialParameters (UsbDevice *device, const SerialParameters *parameters) {
+  errno = ENOSYS;
+  return 0;
+}
+
+static int
+chooseTestDevice (UsbDevice *device, void *data) {
+  return 1;
+}
+
+static void
+finishTestRequestLater (const AsyncAlarmResult *result) {
+  finishTestRequest(result->data, (const unsigned char *)"later", 5);
+}
+
+static int
+checkInput (
+  UsbDevice *device, const char *name,
+  int timeout, int expectInput, long int minimum, long int maximum
+) {
+  TimePeriod period;
+  long int elapsed;
+  int received;
+  int ok = 1;
+
+  startTimePeriod(&period, 0);
+  received = usbAwaitInput(device, TEST_ENDPOINT, timeout);
+  afterTimePeriod(&period, &elapsed);
+
+  if (received != expectInput) {
+    logMessage(LOG_ERR, "%s: input %s", name, (received? "unexpected": "not received"));
+    ok = 0;
+  } else if (!received && (errno != EAGAIN)) {
+    logSystemError(name);
+    ok = 0;
+  }
+
+  if ((elapsed < minimum) || (elapsed > maximum)) {
+    logMessage(LOG_ERR, "%s: took %ldms - expected %ld-%ldms", name, elapsed, minimum, maximum);
+    ok = 0;
+  }
+
+  if (received) {
+    unsigned char buffer[TEST_PACKET_SIZE];
+    usbReadData(device, TEST_ENDPOINT, buffer, sizeof(buffer), 0, 0);
+  }
+
+  logMessage(LOG_NOTICE, "%s: %s (%ldms)", name, (ok? "passed": "failed"), elapsed);
+  return ok;
+}
+
+int
+main (int argc, char *argv[]) {
+  UsbDevice *device;
+  int ok = 1;
+
+  {
+    static const OptionsDescriptor descriptor = {
+      OPTION_TABLE(programOptions),
+      .applicationName = "usbtest"
+    };
+    PROCESS_OPTIONS(descriptor, argc, argv);
+  }
+
+  if (!(device = usbFindDevice(chooseTestDevice, NULL))) {
+    logMessage(LOG_ERR, "simulated USB device not available");
+    return PROG_EXIT_FATAL;
+  }
+
+  if (usbBeginInput(device, TEST_ENDPOINT, 2) != 2) {
+    logMessage(LOG_ERR, "USB input requests not submitted");
+    ok = 0;
+  } else {
+    /* no response at all - this also starts the completion monitor */
+    if (!checkInput(device, "timed out", 200, 0, 190, 400)) ok = 0;
+
+    /* a response which the monitor reaps before anyone waits for it */
+    finishTestRequest(device->extension, (const unsigned char *)"early", 5);
+    asyncWait(10);
+    if (!checkInput(device, "already reaped", 1000, 1, 0, 50)) ok = 0;
+
+    /* a response which completes while waiting */
+    asyncSetAlarmIn(NULL, 100, finishTestRequestLater, device->extension);
+    if (!checkInput(device, "completed while waiting", 1000, 1, 90, 300)) ok = 0;
+  }
+
+  usbCloseDevice(device);
+  return ok? PROG_EXIT_SUCCESS: PROG_EXIT_FATAL;
+}